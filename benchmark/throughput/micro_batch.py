@@ -0,0 +1,42 @@
+import sys
+import time
+
+from thread_scaling import load_lines
+
+def run_batch(kiwi, lines, repeat):
+    elapsed = time.perf_counter()
+    for _ in range(repeat):
+        for _ in kiwi.tokenize(lines):
+            pass
+    return time.perf_counter() - elapsed
+
+def main(args):
+    import kiwipiepy
+    from kiwipiepy import Kiwi
+    print("Initialize kiwipiepy ({})".format(kiwipiepy.__version__), file=sys.stderr)
+    kiwi = Kiwi(num_workers=args.num_workers, model_type=args.model_type)
+    kiwi.tokenize('')
+
+    lines = load_lines(args.datasets)
+    total_lines = len(lines) * args.repeat
+    total_chrs = sum(map(len, lines)) * args.repeat
+    print(f'{len(lines)} lines, {total_chrs / total_lines:.1f} chrs/line, {kiwi.num_workers} workers', file=sys.stderr)
+
+    print('micro_batch_chars', 'elapsed(s)', 'lines/s', 'chrs/s', 'speedup', sep='\t')
+    base = None
+    for budget in args.budgets:
+        kiwi.micro_batch_chars = budget
+        elapsed = run_batch(kiwi, lines, args.repeat)
+        if base is None: base = elapsed
+        print(budget, f'{elapsed:.3f}', f'{total_lines / elapsed:.1f}', f'{total_chrs / elapsed:.1f}', f'{base / elapsed:.2f}x', sep='\t')
+
+if __name__ == '__main__':
+    import argparse
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument('datasets', nargs='*', default=['../sentence_split/testset/tweets.txt'])
+    parser.add_argument('--budgets', default=[0, 64, 256, 1024], type=int, nargs='+')
+    parser.add_argument('--num_workers', default=0, type=int)
+    parser.add_argument('--repeat', default=5, type=int)
+    parser.add_argument('--model_type', default='knlm', choices=['knlm', 'sbg'])
+    main(parser.parse_args())
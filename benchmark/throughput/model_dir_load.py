@@ -0,0 +1,42 @@
+import sys
+import tempfile
+import time
+
+def timed(fn):
+    elapsed = time.perf_counter()
+    ret = fn()
+    return ret, time.perf_counter() - elapsed
+
+def load_from_dicts(args):
+    from kiwipiepy import Kiwi
+    kiwi = Kiwi(num_workers=args.num_workers, model_type=args.model_type)
+    for path in args.user_dicts:
+        kiwi.load_user_dictionary(path)
+    return kiwi
+
+def main(args):
+    import kiwipiepy
+    from kiwipiepy import Kiwi
+    print("Initialize kiwipiepy ({})".format(kiwipiepy.__version__), file=sys.stderr)
+
+    with tempfile.TemporaryDirectory() as path:
+        load_from_dicts(args).save_model_dir(path)
+        print('source', 'load(s)', 'prepare(s)', 'total(s)', sep='\t')
+        for _ in range(args.repeat):
+            for name, fn in [
+                ('dictionaries', lambda: load_from_dicts(args)),
+                ('model_dir', lambda: Kiwi.load_model_dir(path, num_workers=args.num_workers)),
+            ]:
+                kiwi, load_time = timed(fn)
+                _, prepare_time = timed(kiwi.prepare)
+                print(name, f'{load_time:.3f}', f'{prepare_time:.3f}', f'{load_time + prepare_time:.3f}', sep='\t')
+
+if __name__ == '__main__':
+    import argparse
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument('user_dicts', nargs='*')
+    parser.add_argument('--num_workers', default=0, type=int)
+    parser.add_argument('--model_type', default='knlm', choices=['knlm', 'sbg'])
+    parser.add_argument('--repeat', default=3, type=int)
+    main(parser.parse_args())
@@ -0,0 +1,60 @@
+import sys
+import time
+
+from thread_scaling import load_lines
+
+PATTERNS = [
+    (r'https?://\S+', 'SL'),
+    (r'[\w.+-]+@[\w-]+\.[\w.]+', 'SL'),
+    (r'#[^\s#]+', 'NNP'),
+    (r'@[A-Za-z0-9_]+', 'NNP'),
+    (r'\d{2,4}-\d{3,4}-\d{4}', 'SN'),
+    (r'[0-9]+(?:원|달러|개|명)', 'NNG'),
+    (r'(?i)sku-\d+', 'NNP'),
+    (r'\{[^}]+\}', 'NNP'),
+]
+
+def run_batch(kiwi, lines, repeat):
+    elapsed = time.perf_counter()
+    for _ in range(repeat):
+        for _ in kiwi.tokenize(lines):
+            pass
+    return time.perf_counter() - elapsed
+
+def main(args):
+    import kiwipiepy
+    from kiwipiepy import Kiwi
+    print("Initialize kiwipiepy ({})".format(kiwipiepy.__version__), file=sys.stderr)
+    kiwi = Kiwi(num_workers=args.num_workers, model_type=args.model_type)
+    kiwi.tokenize('')
+
+    lines = load_lines(args.datasets)
+    total_chrs = sum(map(len, lines)) * args.repeat
+    patterns = PATTERNS[:args.num_patterns]
+    print(f'{len(lines)} lines, {len(patterns)} patterns, {kiwi.num_workers} workers', file=sys.stderr)
+
+    print('matcher', 'elapsed(s)', 'chrs/s', 'speedup', sep='\t')
+    base = None
+    for name in ['none', 'python', 'native']:
+        kiwi.clear_re_words()
+        for pat, tag in patterns:
+            if name == 'python':
+                # a callable keeps the pattern in Python
+                kiwi.add_re_word(pat, lambda m, tag=tag: tag)
+            elif name == 'native':
+                kiwi.add_re_word(pat, tag)
+        elapsed = run_batch(kiwi, lines, args.repeat)
+        if name == 'python': base = elapsed
+        speedup = f'{base / elapsed:.2f}x' if base else '-'
+        print(name, f'{elapsed:.3f}', f'{total_chrs / elapsed:.1f}', speedup, sep='\t')
+
+if __name__ == '__main__':
+    import argparse
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument('datasets', nargs='*', default=['../sentence_split/testset/tweets.txt'])
+    parser.add_argument('--num_patterns', default=len(PATTERNS), type=int)
+    parser.add_argument('--num_workers', default=0, type=int)
+    parser.add_argument('--repeat', default=5, type=int)
+    parser.add_argument('--model_type', default='knlm', choices=['knlm', 'sbg'])
+    main(parser.parse_args())
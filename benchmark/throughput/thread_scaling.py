@@ -0,0 +1,55 @@
+import sys
+import time
+import threading
+
+def load_lines(pathes):
+    lines = []
+    for path in pathes:
+        for line in open(path, encoding='utf-8'):
+            line = line.strip()
+            if line: lines.append(line)
+    return lines
+
+def run_threads(kiwi, lines, num_threads, repeat):
+    barrier = threading.Barrier(num_threads + 1)
+    def _worker():
+        barrier.wait()
+        for _ in range(repeat):
+            for line in lines:
+                kiwi.tokenize(line)
+
+    threads = [threading.Thread(target=_worker) for _ in range(num_threads)]
+    for t in threads: t.start()
+    barrier.wait()
+    elapsed = time.perf_counter()
+    for t in threads: t.join()
+    elapsed = time.perf_counter() - elapsed
+    return elapsed
+
+def main(args):
+    import kiwipiepy
+    from kiwipiepy import Kiwi
+    print("Initialize kiwipiepy ({})".format(kiwipiepy.__version__), file=sys.stderr)
+    kiwi = Kiwi(model_type=args.model_type)
+    kiwi.tokenize('')
+
+    lines = load_lines(args.datasets)
+    total_chrs = sum(map(len, lines)) * args.repeat
+
+    print('threads', 'elapsed(s)', 'chrs/s', 'speedup', sep='\t')
+    base = None
+    for n in args.threads:
+        elapsed = run_threads(kiwi, lines, n, args.repeat)
+        throughput = total_chrs * n / elapsed
+        if base is None: base = throughput
+        print(n, f'{elapsed:.3f}', f'{throughput:.1f}', f'{throughput / base:.2f}x', sep='\t')
+
+if __name__ == '__main__':
+    import argparse
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument('datasets', nargs='+')
+    parser.add_argument('--threads', default=[1, 2, 4, 8], type=int, nargs='+')
+    parser.add_argument('--repeat', default=1, type=int)
+    parser.add_argument('--model_type', default='knlm', choices=['knlm', 'sbg'])
+    main(parser.parse_args())
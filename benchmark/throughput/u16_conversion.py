@@ -0,0 +1,31 @@
+import sys
+
+KINDS = {
+    # PyUnicode_1BYTE_KIND
+    'ucs1': 'Kiwi is a Korean morphological analyzer. ',
+    # PyUnicode_2BYTE_KIND
+    'ucs2': '키위는 한국어 형태소 분석기입니다. ',
+    # PyUnicode_4BYTE_KIND, which requires at least one code point outside the BMP
+    'ucs4': '키위는 한국어 형태소 분석기입니다😀 ',
+}
+
+def main(args):
+    import kiwipiepy
+    import _kiwipiepy
+    print("Initialize kiwipiepy ({})".format(kiwipiepy.__version__), file=sys.stderr)
+
+    print('kind', 'length', 'ns/call', 'ns/char', sep='\t')
+    for kind, unit in KINDS.items():
+        for length in args.lengths:
+            text = (unit * (length // len(unit) + 1))[:length]
+            repeat = max(args.total_chars // max(length, 1), 1)
+            elapsed = _kiwipiepy._u16_conversion_time(text, repeat)
+            print(kind, length, f'{elapsed * 1e9:.1f}', f'{elapsed * 1e9 / length:.3f}', sep='\t')
+
+if __name__ == '__main__':
+    import argparse
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--lengths', default=[16, 256, 4096, 65536], type=int, nargs='+')
+    parser.add_argument('--total_chars', default=100000000, type=int)
+    main(parser.parse_args())
@@ -3,7 +3,7 @@
 """
 from kiwipiepy._c_api import Token
 from kiwipiepy._version import __version__
-from kiwipiepy._wrap import Kiwi, Sentence, TypoTransformer, TypoDefinition, HSDataset, MorphemeSet, PretokenizedToken, extract_substrings, NgramExtractor
+from kiwipiepy._wrap import Kiwi, Sentence, TypoTransformer, TypoDefinition, HSDataset, StreamingHSDataset, HSDataConversionCallback, MorphemeSet, PretokenizedToken, TokenArrays, extract_substrings, NgramExtractor
 import kiwipiepy.sw_tokenizer as sw_tokenizer
 import kiwipiepy.utils as utils
 from kiwipiepy.const import Match
@@ -14,5 +14,8 @@ TypoTransformer.__module__ = 'kiwipiepy'
 TypoDefinition.__module__ = 'kiwipiepy'
 Sentence.__module__ = 'kiwipiepy'
 PretokenizedToken.__module__ = 'kiwipiepy'
+TokenArrays.__module__ = 'kiwipiepy'
 HSDataset.__module__ = 'kiwipiepy'
+StreamingHSDataset.__module__ = 'kiwipiepy'
+HSDataConversionCallback.__module__ = 'kiwipiepy'
 MorphemeSet.__module__ = 'kiwipiepy'
@@ -0,0 +1,255 @@
+'''
+`Kiwi.add_re_word`로 추가된 정규표현식을 C++ 측의 `std::wregex`(ECMAScript 문법)로 옮기기 위한 내부 모듈입니다.
+
+Python `re`와 동일하게 동작함이 보장되는 패턴만 변환하며, 그렇지 않은 패턴(후방탐색, 범위가 지정된 인라인 플래그,
+`re.MULTILINE`에서의 `^`/`$`, 단어 경계 등)은 `None`을 반환하여 기존처럼 Python에서 처리되도록 합니다.
+'''
+
+import sys
+from functools import lru_cache
+from typing import List, NamedTuple, Optional, Tuple
+
+try:
+    from re import _parser as _sre_parse, _constants as _sre_constants
+except ImportError:
+    import sre_parse as _sre_parse
+    import sre_constants as _sre_constants
+
+import re
+
+_c = _sre_constants
+_MAX_CHAR = 0x10FFFF
+# `wchar_t` is UTF-16 on Windows, where a class must not match half of a surrogate pair
+_NARROW_WCHAR = sys.platform == 'win32'
+# a prefilter covering more characters than this is not worth checking
+_MAX_FIRST_CHARS = 0x8000
+# ranges of characters folded one by one under `re.IGNORECASE`
+_MAX_FOLDED_CHARS = 4096
+
+Ranges = List[Tuple[int, int]]
+
+class NativePattern(NamedTuple):
+    pattern: str
+    first_chars: Optional[Ranges]
+    prefix: str
+
+class _Untranslatable(Exception):
+    pass
+
+def _normalize(ranges:Ranges) -> Ranges:
+    ranges = sorted(ranges)
+    ret = []
+    for b, e in ranges:
+        if ret and b <= ret[-1][1] + 1:
+            if e > ret[-1][1]: ret[-1] = (ret[-1][0], e)
+        else:
+            ret.append((b, e))
+    return ret
+
+def _complement(ranges:Ranges) -> Ranges:
+    ret = []
+    cursor = 0
+    for b, e in ranges:
+        if cursor < b: ret.append((cursor, b - 1))
+        cursor = e + 1
+    if cursor <= _MAX_CHAR: ret.append((cursor, _MAX_CHAR))
+    return ret
+
+def _size(ranges:Ranges) -> int:
+    return sum(e - b + 1 for b, e in ranges)
+
+@lru_cache(maxsize=None)
+def _all_chars() -> str:
+    return ''.join(map(chr, range(_MAX_CHAR + 1)))
+
+@lru_cache(maxsize=None)
+def _category_ranges(category, ascii:bool) -> Tuple[Tuple[int, int], ...]:
+    positive = {
+        _c.CATEGORY_DIGIT: r'\d', _c.CATEGORY_NOT_DIGIT: r'\d',
+        _c.CATEGORY_SPACE: r'\s', _c.CATEGORY_NOT_SPACE: r'\s',
+        _c.CATEGORY_WORD: r'\w', _c.CATEGORY_NOT_WORD: r'\w',
+    }.get(category)
+    if positive is None: raise _Untranslatable
+    # the sets are taken from `re` itself, so they agree with it on every version of Unicode
+    ranges = [(m.start(), m.end() - 1) for m in re.finditer(positive + '+', _all_chars(), re.ASCII if ascii else 0)]
+    if category in (_c.CATEGORY_NOT_DIGIT, _c.CATEGORY_NOT_SPACE, _c.CATEGORY_NOT_WORD):
+        ranges = _complement(ranges)
+    return tuple(ranges)
+
+@lru_cache(maxsize=None)
+def _case_variants() -> dict:
+    variants = {}
+    for ch in _all_chars():
+        for key in (ch.lower(), ch.upper()):
+            if len(key) == 1: variants.setdefault(key, set()).add(ch)
+    return variants
+
+def _fold(ranges:Ranges, ascii:bool) -> Ranges:
+    if _size(ranges) > _MAX_FOLDED_CHARS: raise _Untranslatable
+    flags = re.IGNORECASE | (re.ASCII if ascii else 0)
+    variants = _case_variants()
+    ret = list(ranges)
+    for b, e in ranges:
+        for c in range(b, e + 1):
+            ch = chr(c)
+            pat = re.compile(re.escape(ch), flags)
+            candidates = set()
+            for key in (ch.lower(), ch.upper()):
+                candidates |= variants.get(key, set())
+            ret.extend((ord(v), ord(v)) for v in candidates if v != ch and pat.fullmatch(v))
+    return _normalize(ret)
+
+class _Translator:
+    def __init__(self, flags:int):
+        self.flags = flags
+        self.ascii = bool(flags & re.ASCII)
+        self.icase = bool(flags & re.IGNORECASE)
+        self.multiline = bool(flags & re.MULTILINE)
+        self.dotall = bool(flags & re.DOTALL)
+
+    def char_set(self, op, av) -> Optional[Ranges]:
+        '''returns the set of characters a node of a single character matches, or None if it is not such a node'''
+        if op is _c.LITERAL:
+            ranges = [(av, av)]
+            return _fold(ranges, self.ascii) if self.icase else ranges
+        if op is _c.NOT_LITERAL:
+            ranges = [(av, av)]
+            return _complement(_fold(ranges, self.ascii) if self.icase else ranges)
+        if op is _c.ANY:
+            return [(0, _MAX_CHAR)] if self.dotall else _complement([(0x0A, 0x0A)])
+        if op is _c.IN:
+            negate = False
+            ranges = []
+            for iop, iav in av:
+                if iop is _c.NEGATE:
+                    negate = True
+                elif iop is _c.LITERAL or iop is _c.RANGE:
+                    r = [(iav, iav)] if iop is _c.LITERAL else [tuple(iav)]
+                    ranges.extend(_fold(r, self.ascii) if self.icase else r)
+                elif iop is _c.CATEGORY:
+                    # categories are closed under case folding
+                    ranges.extend(_category_ranges(iav, self.ascii))
+                else:
+                    raise _Untranslatable
+            ranges = _normalize(ranges)
+            return _complement(ranges) if negate else ranges
+        return None
+
+    @staticmethod
+    def _char(c:int) -> str:
+        if c <= 0xFFFF: return '\\u{:04X}'.format(c)
+        return chr(c)
+
+    def emit_set(self, ranges:Ranges) -> str:
+        if not ranges: raise _Untranslatable
+        if _NARROW_WCHAR and any(e >= 0xD800 for _, e in ranges): raise _Untranslatable
+        if ranges == [(0, _MAX_CHAR)]: return '[\\s\\S]'
+        parts = []
+        for b, e in ranges:
+            if b == e: parts.append(self._char(b))
+            else: parts.append(self._char(b) + '-' + self._char(e))
+        return '[' + ''.join(parts) + ']'
+
+    def emit(self, nodes) -> str:
+        return ''.join(self.emit_node(op, av) for op, av in nodes)
+
+    def emit_node(self, op, av) -> str:
+        if op is _c.LITERAL and not self.icase:
+            if _NARROW_WCHAR and 0xD800 <= av <= 0xDFFF: raise _Untranslatable
+            return self._char(av) if av <= 0xFFFF else '(?:' + chr(av) + ')'
+        ranges = self.char_set(op, av)
+        if ranges is not None: return self.emit_set(ranges)
+        if op is _c.BRANCH:
+            return '(?:' + '|'.join(self.emit(alt) for alt in av[1]) + ')'
+        if op is _c.SUBPATTERN:
+            if len(av) == 4:
+                group, add_flags, del_flags, sub = av
+                if add_flags or del_flags: raise _Untranslatable
+            else:
+                group, sub = av
+            return ('(' if group is not None else '(?:') + self.emit(sub) + ')'
+        if op is _c.MAX_REPEAT or op is _c.MIN_REPEAT:
+            lo, hi, sub = av
+            if lo == 0 and hi == _c.MAXREPEAT: q = '*'
+            elif lo == 1 and hi == _c.MAXREPEAT: q = '+'
+            elif lo == 0 and hi == 1: q = '?'
+            elif hi == _c.MAXREPEAT: q = '{%d,}' % lo
+            else: q = '{%d,%d}' % (lo, hi)
+            return '(?:' + self.emit(sub) + ')' + q + ('?' if op is _c.MIN_REPEAT else '')
+        if op is _c.AT:
+            if av is _c.AT_BEGINNING_STRING: return '^'
+            if av is _c.AT_END_STRING: return '$'
+            if av is _c.AT_BEGINNING and not self.multiline: return '^'
+            # Python's `$` also matches before a newline at the end
+            if av is _c.AT_END and not self.multiline: return '(?=\\u000A?$)'
+            raise _Untranslatable
+        if op is _c.ASSERT or op is _c.ASSERT_NOT:
+            direction, sub = av
+            if direction != 1: raise _Untranslatable
+            return ('(?=' if op is _c.ASSERT else '(?!') + self.emit(sub) + ')'
+        if op is _c.GROUPREF:
+            if self.icase: raise _Untranslatable
+            return '(?:\\%d)' % av
+        raise _Untranslatable
+
+    def min_len(self, nodes) -> int:
+        n = 0
+        for op, av in nodes:
+            if op in (_c.LITERAL, _c.NOT_LITERAL, _c.ANY, _c.IN): n += 1
+            elif op is _c.SUBPATTERN: n += self.min_len(av[-1])
+            elif op is _c.MAX_REPEAT or op is _c.MIN_REPEAT: n += av[0] * self.min_len(av[2])
+            elif op is _c.BRANCH: n += min(self.min_len(alt) for alt in av[1])
+        return n
+
+    def prefix(self, nodes) -> str:
+        '''returns the literal text every match starts with'''
+        ret = []
+        for op, av in nodes:
+            if op is _c.LITERAL and not self.icase:
+                ret.append(chr(av))
+            elif op is _c.SUBPATTERN and len(av) == 4 and not av[1] and not av[2]:
+                sub = self.prefix(av[-1])
+                ret.append(sub)
+                if len(sub) != len(av[-1]): break
+            else:
+                break
+        return ''.join(ret)
+
+    def first_chars(self, nodes) -> Optional[Ranges]:
+        for op, av in nodes:
+            ranges = self.char_set(op, av)
+            if ranges is not None: return ranges
+            if op is _c.AT or op is _c.ASSERT or op is _c.ASSERT_NOT:
+                continue
+            if op is _c.SUBPATTERN:
+                if not self.min_len(av[-1]): return None
+                return self.first_chars(av[-1])
+            if op is _c.MAX_REPEAT or op is _c.MIN_REPEAT:
+                if not av[0] or not self.min_len(av[2]): return None
+                return self.first_chars(av[2])
+            if op is _c.BRANCH:
+                ret = []
+                for alt in av[1]:
+                    if not self.min_len(alt): return None
+                    r = self.first_chars(alt)
+                    if r is None: return None
+                    ret.extend(r)
+                return _normalize(ret)
+            return None
+        return None
+
+def translate(pattern:'re.Pattern') -> Optional[NativePattern]:
+    '''`pattern`을 동일하게 동작하는 ECMAScript 패턴으로 변환합니다. 변환할 수 없으면 None을 반환합니다.'''
+    if not isinstance(pattern.pattern, str): return None
+    try:
+        parsed = _sre_parse.parse(pattern.pattern, pattern.flags)
+        # `pattern.flags` includes the global inline flags
+        translator = _Translator(pattern.flags)
+        ecma = translator.emit(parsed.data)
+        first_chars = translator.first_chars(parsed.data) if translator.min_len(parsed.data) else None
+        prefix = translator.prefix(parsed.data)
+    except (_Untranslatable, RecursionError):
+        return None
+    if first_chars is not None and _size(first_chars) > _MAX_FIRST_CHARS:
+        first_chars = None
+    return NativePattern(ecma, first_chars, prefix)
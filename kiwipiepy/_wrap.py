@@ -1,9 +1,16 @@
 import re
+import atexit
+import weakref
 from functools import partial
-from typing import Callable, List, Dict, Optional, Tuple, Union, Iterable, NamedTuple, NewType, Any
+from typing import Callable, List, Dict, Optional, Tuple, Union, Iterable, Iterator, NamedTuple, NewType, Any
 from dataclasses import dataclass
 import itertools
+import json
+import os
+import random
+import time
 import warnings
+from concurrent.futures import ThreadPoolExecutor
 
 import _kiwipiepy
 from _kiwipiepy import _Kiwi, _TypoTransformer, _HSDataset, _MorphemeSet, _NgramExtractor
@@ -12,6 +19,7 @@ from kiwipiepy._version import __version__
 from kiwipiepy.utils import Stopwords
 from kiwipiepy.const import Match
 from kiwipiepy.template import Template
+from kiwipiepy import _re_native
 
 Sentence = NamedTuple('Sentence', [('text', str), ('start', int), ('end', int), ('tokens', Optional[List[Token]]), ('subs', Optional[List['Sentence']])])
 Sentence.__doc__ = '문장 분할 결과를 담기 위한 `namedtuple`입니다.'
@@ -33,6 +41,24 @@ PretokenizedToken.start.__doc__ = '주어진 구간에서 형태소가 시작하
 PretokenizedToken.end.__doc__ = '주어진 구간에서 형태소가 끝나는 시작 위치 (문자 단위)'
 PretokenizedTokenList = List[Union[Tuple[int, int], Tuple[int, int, POSTag], Tuple[int, int, PretokenizedToken], Tuple[int, int, List[PretokenizedToken]]]]
 
+TokenArrays = NamedTuple('TokenArrays', [('id', 'np.ndarray'), ('tag', 'np.ndarray'), ('start', 'np.ndarray'), ('len', 'np.ndarray'), ('word_position', 'np.ndarray'), ('sent_position', 'np.ndarray'), ('sub_sent_position', 'np.ndarray'), ('score', 'np.ndarray'), ('typo_cost', 'np.ndarray'), ('form', str), ('form_offsets', 'np.ndarray')])
+TokenArrays.__doc__ = '''.. versionadded:: 0.21.0
+
+`Kiwi.analyze`에 `output='arrays'`를 지정했을 때 반환되는 분석 결과를 담는 `namedtuple`입니다. 
+`Token` 객체를 생성하는 대신 각 필드를 형태소 개수만큼의 길이를 가지는 numpy 배열로 제공합니다.'''
+TokenArrays.id.__doc__ = '형태소의 내부 고유 ID (int64). 사전에 없는 형태소는 -1'
+TokenArrays.tag.__doc__ = '형태소의 품사 태그 ID (uint8). `TokenArrays.tag_names`로 문자열로 변환할 수 있습니다.'
+TokenArrays.start.__doc__ = '형태소의 입력 텍스트 내 시작 위치 (uint32, 문자 단위)'
+TokenArrays.len.__doc__ = '형태소의 입력 텍스트 내 차지 길이 (uint32, 문자 단위)'
+TokenArrays.word_position.__doc__ = '형태소의 입력 텍스트 내 어절 위치 (uint32)'
+TokenArrays.sent_position.__doc__ = '형태소의 입력 텍스트 내 문장 번호 (uint32)'
+TokenArrays.sub_sent_position.__doc__ = '형태소의 안긴 문장 번호 (uint32)'
+TokenArrays.score.__doc__ = '형태소의 언어 모델 점수 (float32)'
+TokenArrays.typo_cost.__doc__ = '형태소의 오타 교정 비용 (float32)'
+TokenArrays.form.__doc__ = '모든 형태소의 형태를 이어붙인 문자열'
+TokenArrays.form_offsets.__doc__ = '`form` 내에서 각 형태소의 형태가 시작하는 위치 (uint32, 길이는 형태소 개수 + 1)'
+TokenArrays.tag_names = _kiwipiepy._tag_names()
+
 NgramCandidate = NamedTuple('NgramCandidate', [('text', str), ('tokens', List[Tuple[str, str]]), ('token_scores', List[float]), ('cnt', int), ('df', int), ('score', float), ('npmi', float), ('lb_entropy', float), ('rb_entropy', float), ('lm_score', float)])
 
 class NgramExtractor(_NgramExtractor):
@@ -262,7 +288,334 @@ errors: List[Tuple[str, float]]
         return "TypoTransformer([{}], continual_typo_cost={!r}, lengthening_typo_cost={!r})".format(defs_str, self._continual_typo_cost, self._lengthening_typo_cost)
 
 class HSDataset(_HSDataset):
-    pass
+
+    def prefetch(self, num_buffers:int = 2) -> Iterator[Tuple['np.ndarray', 'np.ndarray', 'np.ndarray', 'np.ndarray', float, int]]:
+        '''.. versionadded:: 0.21.0
+
+배치를 백그라운드 스레드에서 미리 생성하는 iterator를 반환합니다. 반환되는 배치는 `iter(dataset)`과 동일합니다.
+
+Parameters
+----------
+num_buffers: int
+    미리 생성해 둘 배치의 개수입니다. 기본값은 2로, 현재 배치를 사용하는 동안 다음 배치를 생성합니다.
+
+Notes
+-----
+각 배치의 배열은 미리 할당된 버퍼를 재사용합니다. 버퍼는 이전에 반환된 배치의 배열과 그로부터 만들어진 view, 
+buffer protocol이나 DLPack(`torch.from_dlpack` 등)으로 내보내진 객체가 모두 해제된 뒤에만 재사용되므로, 
+배치를 보관해 두어도 내용이 바뀌지 않습니다. 이 경우 새 버퍼가 할당됩니다.
+단, 배열의 메모리 주소만을 보관하는 경우(`ndarray.ctypes.data` 등)에는 이를 알 수 없으므로 배치를 복사해 두어야 합니다.
+배치를 생성하는 동안에는 GIL이 해제됩니다.
+
+같은 데이터셋에 대해 새로운 iterator를 만들면 데이터셋이 처음으로 되돌아가며, 이전의 `prefetch` iterator는 종료됩니다.
+
+```python
+for in_data, out_data, lm_lprobs, ngram_nodes, rest_lm, rest_lm_cnt in dataset.prefetch():
+    ...
+```
+        '''
+        if num_buffers < 1:
+            raise ValueError("`num_buffers` must be a positive integer.")
+        return super()._prefetch(num_buffers)
+
+    def set_epoch(self, epoch:int) -> None:
+        '''.. versionadded:: 0.21.0
+
+데이터셋을 섞는 데에 사용할 에폭 번호를 설정합니다. 설정된 값은 다음에 생성되는 iterator부터 적용됩니다.
+
+Parameters
+----------
+epoch: int
+    에폭 번호입니다. 섞는 순서는 `make_hsdataset`에 지정한 `seed`, 이 데이터셋의 shard 번호, `epoch`에 의해서만 결정되므로,
+    모든 rank에서 매 에폭마다 같은 값으로 호출하면 결과가 rank 간에 일관되게 재현됩니다.
+
+```python
+for epoch in range(num_epochs):
+    dataset.set_epoch(epoch)
+    for batch in dataset:
+        ...
+```
+        '''
+        if epoch < 0:
+            raise ValueError("`epoch` must be a non-negative integer.")
+        super()._set_epoch(epoch)
+
+    def set_num_batches(self, num_batches:Optional[int]) -> None:
+        '''.. versionadded:: 0.21.0
+
+매 iteration이 반환할 배치의 개수를 고정합니다. 설정된 값은 다음에 생성되는 iterator부터 적용됩니다.
+
+Parameters
+----------
+num_batches: Optional[int]
+    iteration마다 반환할 배치의 개수입니다. 데이터셋의 배치가 이보다 많으면 나머지는 버리고, 
+    이보다 적으면 데이터셋의 처음부터 다시 읽어 개수를 채웁니다. None이면 데이터셋의 모든 배치를 한번씩 반환합니다.
+    설정된 경우 `len(dataset)`도 이 값을 반환합니다.
+
+Notes
+-----
+분산 학습에서 각 rank는 서로 다른 파일을 읽으므로 rank마다 배치의 개수가 다를 수 있으며, 
+이 경우 배치를 먼저 다 소진한 rank가 다른 rank의 collective 연산을 기다리지 못해 학습이 멈추게 됩니다. 
+모든 rank에 같은 값을 설정하여 이를 방지할 수 있습니다.
+`len(dataset)`은 추정치이므로, 모든 rank의 최솟값을 사용하는 것을 권장합니다.
+
+```python
+n = torch.tensor(len(dataset), device=device)
+torch.distributed.all_reduce(n, op=torch.distributed.ReduceOp.MIN)
+dataset.set_num_batches(int(n))
+```
+        '''
+        if num_batches is not None and num_batches < 1:
+            raise ValueError("`num_batches` must be a positive integer or None.")
+        super()._set_num_batches(num_batches or 0)
+
+class HSDataConversionCallback:
+    '''.. versionadded:: 0.21.0
+
+    `Kiwi.convert_hsdata`의 진행상황을 보고받기 위한 콜백 클래스입니다.
+    이 클래스를 상속 받아서 필요한 기능을 구현한 뒤 `Kiwi.convert_hsdata` 함수의 `callback` 인자로 넘겨 사용할 수 있습니다.
+    '''
+    def begin(self, num_files:int, total_bytes:int):
+        '''
+이 메소드는 변환 작업이 시작됐을 때 호출됩니다.
+
+Parameters
+----------
+num_files: int
+    변환할 입력 파일의 수
+total_bytes: int
+    변환할 입력 파일 크기의 합(바이트)
+        '''
+
+    def proc(self, num_converted_files:int, converted_bytes:int, elapsed:float, bytes_per_sec:float):
+        '''
+이 메소드는 입력 파일의 묶음 하나가 변환될 때마다 호출됩니다.
+
+Parameters
+----------
+num_converted_files: int
+    변환이 완료된 입력 파일의 수
+converted_bytes: int
+    변환이 완료된 입력 파일 크기의 합(바이트)
+elapsed: float
+    변환 시작 후 경과한 시간(초)
+bytes_per_sec: float
+    초당 변환한 입력의 크기(바이트)
+        '''
+
+    def end(self, num_converted_files:int, converted_bytes:int, elapsed:float, bytes_per_sec:float):
+        '''
+이 메소드는 변환 작업이 완료되었을 때 호출됩니다.
+인자는 `proc`과 동일합니다.
+        '''
+
+class StreamingHSDataset:
+    '''.. versionadded:: 0.21.0
+
+`Kiwi.convert_hsdata`에 `max_shard_bytes`를 지정하여 만든 shard 목록으로부터 배치를 읽어들이는 데이터셋입니다. 
+`Kiwi.make_streaming_hsdataset`으로 생성합니다.
+
+전체 코퍼스를 한번에 메모리에 올리는 `HSDataset`과 달리, 한번에 최대 `buffer_shards`개의 shard만 읽어들이고 
+다 사용한 shard는 해제하므로 시작 시간과 메모리 사용량이 코퍼스 전체의 크기와 무관합니다.
+다만 각 shard는 통째로 읽어들이므로, 메모리 사용량은 블록 단위로 제한되는 것이 아니라 대략 `buffer_shards` × (가장 큰 shard의 크기)로 정해집니다. 
+메모리를 더 줄이려면 `Kiwi.convert_hsdata`의 `max_shard_bytes`를 작게 하여 shard를 잘게 나누십시오.
+
+Notes
+-----
+매 에폭마다 shard의 순서를 섞은 뒤, 읽어들인 shard들 중 하나를 무작위로 골라 배치를 가져옵니다. 
+각 shard 내의 문장은 `HSDataset`과 동일하게 섞입니다. 
+다음 shard는 배치를 가져오는 동안 백그라운드 스레드에서 미리 읽어두며, 이 shard도 `buffer_shards`에 포함됩니다. 
+따라서 섞이는 범위는 `buffer_shards - 1`개의 shard로 제한됩니다(`buffer_shards`가 1이면 1개의 shard를 사용하고, 다음 shard를 읽는 동안에는 2개가 메모리에 올라갑니다).
+섞는 순서는 `seed`와 `set_epoch`로 지정한 에폭 번호에 의해서만 결정되며, shard를 읽는 속도와는 무관합니다.
+
+모든 shard는 어휘 집합이 같아야 합니다. 다른 shard와 어휘 집합이 다른 shard를 읽으면 `ValueError`가 발생합니다.
+`vocab_size` 등의 속성은 `Kiwi.convert_hsdata`가 shard 목록에 함께 기록해둔 어휘 집합으로부터 구하므로 shard를 읽지 않습니다. 
+단 `morpheme_def_path`, `morpheme_def_min_cnt`, `separate_default_morpheme`이 변환할 때와 다르거나 `token_filter`를 지정한 경우, 
+또는 이전 버전이 기록한 shard 목록인 경우에는 처음 읽은 shard로부터 구하며, 이 shard는 속성값만 남기고 바로 해제됩니다.
+
+```python
+dataset = kiwi.make_streaming_hsdataset('corpus.hsdata', batch_size=128)
+for epoch in range(num_epochs):
+    dataset.set_epoch(epoch)
+    for in_data, out_data, lm_lprobs, ngram_nodes, rest_lm, rest_lm_cnt in dataset:
+        ...
+```
+    '''
+
+    _MANIFEST_FORMAT = 'kiwipiepy.hsdata_shards'
+
+    def __init__(self, kiwi:'Kiwi', shards:List[str], buffer_shards:int, seed:int, dataset_args:Dict[str, Any], vocab:Optional[Dict[str, Any]] = None):
+        self._kiwi = kiwi
+        self._shards = shards
+        self._buffer_shards = buffer_shards
+        self._seed = seed
+        self._dataset_args = dataset_args
+        self._epoch = 0
+        self._num_batches = None
+        # the vocabulary and the sizes shared by every shard, 
+        # taken from the manifest if it was recorded with the same settings, otherwise from the first shard read
+        self._meta = None
+        if vocab is not None and dataset_args.get('token_filter') is None and vocab['settings'] == StreamingHSDataset._vocab_settings(dataset_args):
+            self._meta = {k:v for k, v in vocab.items() if k != 'settings'}
+            self._meta['vocab'] = [tuple(v) for v in self._meta['vocab']]
+
+    @staticmethod
+    def _load_manifest(path:str) -> Dict[str, Any]:
+        with open(path, encoding='utf-8') as f:
+            manifest = json.load(f)
+        if not isinstance(manifest, dict) or manifest.get('format') != StreamingHSDataset._MANIFEST_FORMAT:
+            raise ValueError("`{}` is not a manifest written by `Kiwi.convert_hsdata`.".format(path))
+        return manifest
+
+    @staticmethod
+    def _read_manifest(path:str) -> List[str]:
+        base = os.path.dirname(os.path.abspath(path))
+        return [os.path.join(base, s) for s in StreamingHSDataset._load_manifest(path)['shards']]
+
+    @staticmethod
+    def _read_manifest_vocab(path:str) -> Optional[Dict[str, Any]]:
+        return StreamingHSDataset._load_manifest(path).get('vocab')
+
+    @staticmethod
+    def _vocab_settings(dataset_args:Dict[str, Any]) -> Dict[str, Any]:
+        '''the arguments of `Kiwi.make_hsdataset` that decide the vocabulary'''
+        return dict(
+            morpheme_def_path=dataset_args.get('morpheme_def_path'),
+            morpheme_def_min_cnt=dataset_args.get('morpheme_def_min_cnt', 0),
+            separate_default_morpheme=dataset_args.get('separate_default_morpheme', False),
+        )
+
+    @staticmethod
+    def _is_manifest(path:str) -> bool:
+        with open(path, 'rb') as f:
+            head = f.read(64)
+        return head.startswith(b'{') and StreamingHSDataset._MANIFEST_FORMAT.encode() in head
+
+    @staticmethod
+    def _write_manifest(path:str, shards:List[str], vocab:Optional[Dict[str, Any]] = None):
+        base = os.path.dirname(os.path.abspath(path))
+        manifest = {
+            'format': StreamingHSDataset._MANIFEST_FORMAT, 
+            'shards': [os.path.relpath(os.path.abspath(s), base) for s in shards],
+        }
+        if vocab is not None:
+            manifest['vocab'] = vocab
+        with open(path, 'w', encoding='utf-8') as f:
+            json.dump(manifest, f, ensure_ascii=False, indent=1)
+
+    def _load(self, shard_id:int) -> HSDataset:
+        dataset = self._kiwi.make_hsdataset([self._shards[shard_id]], seed=self._seed + shard_id, **self._dataset_args)
+        meta = StreamingHSDataset._meta_of(dataset)
+        if self._meta is None:
+            self._meta = meta
+        elif meta != self._meta:
+            raise ValueError("The vocabulary of `{}` differs from that of the other shards. "
+                "Every shard must be read with the same dictionary and `morpheme_def_path`.".format(self._shards[shard_id]))
+        return dataset
+
+    def _load_for_epoch(self, shard_id:int) -> HSDataset:
+        dataset = self._load(shard_id)
+        dataset.set_epoch(self._epoch)
+        return dataset
+
+    @staticmethod
+    def _meta_of(dataset:HSDataset) -> Dict[str, Any]:
+        return dict(
+            vocab_size=dataset.vocab_size,
+            knlm_vocab_size=dataset.knlm_vocab_size,
+            ngram_node_size=dataset.ngram_node_size,
+            vocab=[dataset.get_vocab_info(i) for i in range(dataset.vocab_size)],
+        )
+
+    @property
+    def shards(self) -> List[str]:
+        '''이 데이터셋이 읽어들이는 shard 파일의 목록입니다.'''
+        return list(self._shards)
+
+    def set_epoch(self, epoch:int) -> None:
+        '''다음 iteration에서 사용할 에폭 번호를 설정합니다. 자세한 내용은 `HSDataset.set_epoch`를 참조하세요.'''
+        if epoch < 0:
+            raise ValueError("`epoch` must be a non-negative integer.")
+        self._epoch = epoch
+
+    def set_num_batches(self, num_batches:Optional[int]) -> None:
+        '''매 iteration이 반환할 배치의 개수를 고정합니다. 자세한 내용은 `HSDataset.set_num_batches`를 참조하세요.'''
+        if num_batches is not None and num_batches < 1:
+            raise ValueError("`num_batches` must be a positive integer or None.")
+        self._num_batches = num_batches
+
+    def _first(self) -> Dict[str, Any]:
+        if self._meta is None:
+            # only the metadata of the shard is kept, the shard itself is released right away
+            self._load(0)
+        return self._meta
+
+    @property
+    def vocab_size(self) -> int:
+        return self._first()['vocab_size']
+
+    @property
+    def knlm_vocab_size(self) -> int:
+        return self._first()['knlm_vocab_size']
+
+    @property
+    def ngram_node_size(self) -> int:
+        return self._first()['ngram_node_size']
+
+    @property
+    def batch_size(self) -> int:
+        return self._dataset_args['batch_size']
+
+    @property
+    def window_size(self) -> int:
+        return self._dataset_args['window_size']
+
+    def get_vocab_info(self, index:int) -> Tuple[str, str]:
+        vocab = self._first()['vocab']
+        if not (0 <= index < len(vocab)):
+            raise ValueError(str(index))
+        return vocab[index]
+
+    def __iter__(self) -> Iterator[Tuple['np.ndarray', 'np.ndarray', 'np.ndarray', 'np.ndarray', float, int]]:
+        num_batches = self._num_batches
+        produced = 0
+        while True:
+            start = produced
+            for batch in self._iter_epoch():
+                yield batch
+                produced += 1
+                if num_batches is not None and produced >= num_batches: return
+            # runs over the shards again only to fill up `num_batches`
+            if num_batches is None or produced == start: return
+
+    def _iter_epoch(self) -> Iterator[Tuple['np.ndarray', 'np.ndarray', 'np.ndarray', 'np.ndarray', float, int]]:
+        rng = random.Random(self._seed * 1000003 + self._epoch)
+        order = list(range(len(self._shards)))
+        rng.shuffle(order)
+        pending = iter(order)
+        # the shard read ahead counts toward `buffer_shards`
+        max_active = max(self._buffer_shards - 1, 1)
+        with ThreadPoolExecutor(max_workers=1) as loader:
+            def _read_ahead():
+                shard_id = next(pending, None)
+                return None if shard_id is None else loader.submit(self._load_for_epoch, shard_id)
+
+            loading = _read_ahead()
+            active = []
+            while True:
+                # a shard joins only when there is room for it, so the order does not depend on how fast the shards are read
+                while loading is not None and len(active) < max_active:
+                    active.append(iter(loading.result()))
+                    loading = _read_ahead()
+                if not active: break
+                i = rng.randrange(len(active))
+                batch = next(active[i], None)
+                if batch is None:
+                    # the exhausted shard is released here
+                    active[i] = active[-1]
+                    active.pop()
+                    continue
+                yield batch
 
 class MorphemeSet(_MorphemeSet):
     '''.. versionadded:: 0.15.0
@@ -320,6 +673,14 @@ morphset = MorphemeSet([
         super()._update(self.set)
         self._updated = True
 
+# `Kiwi`s which have started a background rebuild. Their build threads are joined before the interpreter shuts down.
+_background_rebuilds = weakref.WeakSet()
+
+@atexit.register
+def _wait_background_rebuilds():
+    for kiwi in list(_background_rebuilds):
+        kiwi._wait_rebuild()
+
 class Kiwi(_Kiwi):
     '''Kiwi 클래스는 실제 형태소 분석을 수행하는 kiwipiepy 모듈의 핵심 클래스입니다.
 이 클래스는 지연 초기화(Lazy initialization)를 사용합니다. 즉 `Kiwi` 인스턴스를 생성할 때에는 최소한의 초기화만 수행하고, 
@@ -438,6 +799,9 @@ typo_cost_threshold: float
         self._load_typo_dict = load_typo_dict
         self._typos = typos
         self._pretokenized_pats : List[Tuple['re.Pattern', str, Any]] = []
+        # patterns of `_pretokenized_pats` which are not matched natively
+        self._py_pretokenized_pats : List[Tuple['re.Pattern', str, Any]] = []
+        self._re_words_dirty = False
         self._user_values : Dict[int, Any] = {}
         self._template_cache : Dict[str, Template] = {}
 
@@ -510,6 +874,45 @@ False
         mid, inserted = super().add_user_word(word, tag, score, orig_word)
         self._user_values[mid] = user_value
         return inserted
+
+    def add_user_words_bulk(self,
+        forms:Iterable[str],
+        tags:Union[POSTag, Iterable[POSTag]] = 'NNP',
+        scores:Union[float, Iterable[float]] = 0.,
+    ) -> Tuple['np.ndarray', 'np.ndarray']:
+        '''.. versionadded:: 0.21.0
+
+여러 개의 사용자 정의 형태소를 한 번에 추가합니다. 
+`add_user_word`를 반복해서 호출하는 것과 결과는 같지만, 단어마다 Python 함수를 호출하고 품사 태그를 해석하는 비용이 없으므로
+수십만 개 이상의 단어로 구성된 사전을 메모리에서 바로 불러올 때 훨씬 빠릅니다.
+
+Parameters
+----------
+forms: Iterable[str]
+    추가할 형태소의 목록. `list`, `numpy.ndarray`, `pyarrow.Array` 등을 사용할 수 있습니다.
+tags: Union[str, Iterable[str]]
+    추가할 형태소의 품사 태그. 하나의 문자열이면 모든 형태소에 같은 태그가 적용되고, 
+    목록이면 `forms`와 길이가 같아야 합니다. 서로 다른 태그 문자열은 한 번씩만 해석됩니다.
+scores: Union[float, Iterable[float]]
+    추가할 형태소의 가중치 점수. 하나의 실수이면 모든 형태소에 같은 점수가 적용되고, 
+    목록이면 `forms`와 길이가 같아야 합니다.
+
+Returns
+-------
+ids: numpy.ndarray
+    각 형태소의 id를 담은 `uint32` 배열
+inserted: numpy.ndarray
+    각 형태소가 새로 삽입되었는지를 담은 `bool` 배열. 이미 동일한 형태소가 존재하여 삽입되지 않은 경우 False입니다.
+
+```python
+>>> ids, inserted = kiwi.add_user_words_bulk(['상품A', '상품B', '상품C'], 'NNP', [0., 1., 2.])
+```
+        '''
+        def _as_list(v):
+            if hasattr(v, 'to_pylist'): return v.to_pylist()
+            if hasattr(v, 'tolist'): return v.tolist()
+            return v
+        return super()._add_user_words_bulk(_as_list(forms), _as_list(tags), _as_list(scores))
     
     def add_pre_analyzed_word(self,
         form:str,
@@ -592,6 +995,14 @@ Notes
 -----
 이 메소드는 분석할 텍스트 내에 분할되면 안되는 텍스트 영역이 있거나, 이미 분석된 결과가 포함된 텍스트를 분석하는 데에 유용합니다.
 
+.. versionchanged:: 0.21.0
+    `pretokenized`가 콜백 함수가 아닌 패턴은 C++로 변환되어 GIL 없이 작업 스레드에서 매칭됩니다. 
+    후방탐색(lookbehind), `re.MULTILINE`에서의 `^`/`$`, 단어 경계(`\\b`) 등 Python `re`와 동일하게 동작함을 보장할 수 없는 패턴과 
+    콜백 함수를 사용하는 패턴은 이전처럼 Python에서 매칭됩니다. 
+    두 방식으로 매칭된 구간이 서로 겹치는 경우 Python에서 매칭된 구간이 우선권을 가지며, 같은 방식 내에서는 나중에 추가된 패턴이 우선권을 가집니다.
+    정규표현식 엔진의 재귀 깊이를 제한하기 위해 C++에서 매칭되는 구간의 길이는 1024자(코드포인트) 내외로 제한되며, 이보다 길게 이어지는 구간은 앞부분만 일치합니다.
+    `Kiwi.space`는 이전처럼 이 메소드로 추가한 패턴을 사용하지 않습니다.
+
 참고로 이 메소드는 형태소 분석에 앞서 전처리 단계에서 패턴 매칭을 수행하므로, 이를 통해 지정한 규칙들은 형태소 분석 모델보다 먼저 우선권을 갖습니다.
 따라서 이 규칙으로 지정한 조건을 만족하는 문자열 패턴은 항상 이 규칙에 기반하여 처리되므로 맥락에 따라 다른 처리를 해야하는 경우 이 메소드를 사용하는 것을 권장하지 않습니다.
 
@@ -678,6 +1089,7 @@ import kiwipiepy\\n```
             pattern = re.compile(pattern)
             
         self._pretokenized_pats.append((pattern, pretokenized, user_value))
+        self._re_words_dirty = True
 
     def clear_re_words(self):
         '''.. versionadded:: 0.16.0
@@ -685,6 +1097,7 @@ import kiwipiepy\\n```
 `add_re_word`로 추가했던 정규표현식 패턴 기반 처리 규칙을 모두 삭제합니다.
         '''
         self._pretokenized_pats.clear()
+        self._re_words_dirty = True
 
     def add_rule(self,
         tag:POSTag,
@@ -796,6 +1209,295 @@ Notes
 
         return super().load_user_dictionary(dict_path)
 
+    def add_overlay_words(self,
+        words:Iterable[Union[str, Tuple[str, str]]],
+    ) -> int:
+        '''.. versionadded:: 0.21.0
+
+이미 구축된 모델을 다시 구축하지 않고 단어를 추가합니다. 
+`add_user_word`는 추가 후 첫 분석 시 전체 모델을 다시 구축하지만, 이 메소드는 추가하는 단어의 개수에 비례하는 시간만 소요되므로
+서비스 중에 신조어나 상품명 등을 수시로 추가해야 하는 경우에 적합합니다.
+
+Parameters
+----------
+words: Iterable[Union[str, Tuple[str, str]]]
+    추가할 단어의 목록. 각 항목은 형태 문자열이거나 (형태, 품사태그) 튜플입니다. 품사태그를 생략하면 `NNP`로 추가됩니다.
+
+Returns
+-------
+added_cnt: int
+    새로 추가된 단어의 개수. 이미 추가된 단어는 품사태그만 갱신되며 개수에 포함되지 않습니다.
+
+Notes
+-----
+이렇게 추가된 단어(오버레이 단어)는 분석할 텍스트에서 가장 왼쪽부터 가장 긴 형태로 일치하는 부분을 찾아 
+`pretokenized`로 지정한 것처럼 하나의 형태소로 분석되도록 고정합니다. 
+따라서 `add_user_word`와 달리 점수를 통해 다른 후보와 경쟁하지 않습니다.
+단, 단어의 중간에서 일치하는 것을 막기 위해 바로 앞 글자가 한글 음절, 영문자, 숫자인 위치에서는 일치하지 않습니다. 
+뒤에는 조사나 어미가 붙을 수 있으므로 한글이 이어져도 일치하지만, 연속된 영문자와 숫자의 중간에서 끝나는 경우에는 일치하지 않습니다.
+`pretokenized` 인자로 직접 지정한 구간과 겹치는 오버레이 단어는 무시됩니다.
+
+단어 추가는 분석 중인 작업에 영향을 주지 않습니다. 
+여러 텍스트를 입력으로 하는 `analyze`, `tokenize`는 호출 시점의 단어 목록으로 모든 텍스트를 분석합니다.
+오버레이 단어는 `save_model_dir`로 저장되지 않습니다.
+
+```python
+kiwi = Kiwi()
+kiwi.add_overlay_words(['갤럭시S24', ('아이폰16', 'NNP')])
+kiwi.tokenize('갤럭시S24와 아이폰16을 비교했다')
+```
+        '''
+        return super()._add_overlay_words(words)
+
+    def clear_overlay(self) -> None:
+        '''.. versionadded:: 0.21.0
+
+`add_overlay_words`로 추가한 모든 단어를 제거합니다.
+        '''
+        super()._clear_overlay()
+
+    @property
+    def overlay_size(self) -> int:
+        '''.. versionadded:: 0.21.0
+
+`add_overlay_words`로 추가된 단어의 개수 (읽기 전용)
+        '''
+        return self._overlay_size
+
+    def prepare(self) -> None:
+        '''.. versionadded:: 0.21.0
+
+형태소 분석에 필요한 언어 모델과 형태소 테이블을 미리 구축합니다.
+이 메소드를 호출하지 않아도 첫 분석 시 자동으로 구축되므로, 일반적인 경우에는 호출할 필요가 없습니다.
+
+Notes
+-----
+gunicorn(`preload_app = True`)이나 `multiprocessing`의 fork 방식처럼 여러 worker 프로세스를 `fork()`로 생성하는 경우,
+부모 프로세스에서 `Kiwi`를 생성한 뒤 이 메소드를 호출해두면 구축된 모델 데이터가 읽기 전용으로 남아 있어 
+운영체제의 copy-on-write에 의해 모든 worker가 같은 메모리 페이지를 공유하게 됩니다.
+각 worker에서 `Kiwi()`를 새로 생성하면 worker 수만큼 모델이 중복으로 메모리에 올라가는 것과 비교해 메모리 사용량을 크게 줄일 수 있습니다.
+
+`fork()`로 상속된 `Kiwi`는 자식 프로세스에서 처음 사용될 때 자신의 worker 스레드를 새로 생성하므로 
+`num_workers`를 2 이상으로 설정한 경우에도 자식 프로세스에서 안전하게 사용할 수 있습니다.
+
+```python
+kiwi = Kiwi(num_workers=4)
+kiwi.prepare()
+
+# 이후 fork()로 생성된 worker 프로세스들은 kiwi의 모델 데이터를 공유합니다.
+```
+        '''
+        super()._prepare()
+
+    def rebuild(self,
+        background:bool = False,
+    ) -> None:
+        '''.. versionadded:: 0.21.0
+
+`add_user_word`, `load_user_dictionary` 등으로 변경된 사전을 반영하여 모델을 새로 구축합니다.
+변경 사항이 없으면 아무 작업도 하지 않습니다.
+
+Parameters
+----------
+background: bool
+    True일 경우 모델을 별도의 스레드에서 구축하고 즉시 반환합니다. 
+    구축이 진행되는 동안 모든 분석은 중단 없이 기존 모델로 수행되며, 구축이 끝나면 새 모델로 교체됩니다.
+    False일 경우 구축이 끝날 때까지 기다립니다.
+
+Notes
+-----
+모델이 교체되어도 이미 시작된 분석(여러 텍스트를 분석 중인 `analyze`, `tokenize`의 반복자 포함)은 
+시작 시점의 모델로 끝까지 수행되며, 교체된 이전 모델은 이를 사용하는 마지막 분석 결과가 해제될 때 메모리에서 해제됩니다.
+교체 현황은 `Kiwi.generation_stats`로 확인할 수 있습니다.
+진행 중인 백그라운드 구축은 인터프리터가 종료되기 전에, 혹은 `Kiwi` 객체가 해제될 때 끝날 때까지 기다립니다.
+
+```python
+kiwi.add_user_word('신상품', 'NNP')
+kiwi.rebuild(background=True)
+# 구축이 끝날 때까지 tokenize는 '신상품'이 추가되기 전의 모델로 수행됩니다.
+```
+        '''
+        if background:
+            _background_rebuilds.add(self)
+            super()._rebuild_in_background()
+        else:
+            super()._prepare()
+
+    @property
+    def generation_stats(self) -> Dict[str, Any]:
+        '''.. versionadded:: 0.21.0
+
+모델 교체에 관한 통계를 담은 dict (읽기 전용)
+
+* `generation`: 지금까지 구축되어 교체된 모델의 수
+* `alive_generations`: 메모리에 남아 있는 모델의 수. 이전 모델을 사용 중인 분석이 남아 있으면 1보다 큽니다.
+* `last_build_time`: 가장 최근 모델 구축에 걸린 시간(초)
+* `last_swap_latency`: 가장 최근 구축이 끝난 뒤 새 모델이 분석에 사용되기 시작하기까지 걸린 시간(초)
+* `rebuilding`: 백그라운드 구축이 진행 중인지 여부
+        '''
+        return dict(
+            generation=self._generation,
+            alive_generations=self._alive_generations,
+            last_build_time=self._last_build_time,
+            last_swap_latency=self._last_swap_latency,
+            rebuilding=self._rebuilding,
+        )
+
+    _MODEL_DIR_META = 'kiwipiepy_model_dir.json'
+
+    # built directly by `_Kiwi.analyze` when results are split into sentences
+    _sentence_type = Sentence
+    # flags of the `output` argument of `_Kiwi.analyze`
+    _OUTPUT_ARRAYS = 1
+    _OUTPUT_SENTENCES = 2
+    _OUTPUT_SENTENCE_TOKENS = 4
+    _OUTPUT_SUB_SENTENCES = 8
+    _OUTPUT_SENTENCE_SPANS = 16
+    _OUTPUT_SPACED = 32
+    _OUTPUT_RESET_WHITESPACE = 64
+    # applies the native patterns of `add_re_word`, which only callers of `_prepare_analyze_args` have synced
+    _OUTPUT_RE_WORDS = 128
+
+    def save_model_dir(self,
+        path:str,
+    ) -> None:
+        '''.. versionadded:: 0.21.0
+
+구축된 모델이 아니라 사전만을 저장하므로, 불러온 `Kiwi`도 첫 분석(혹은 `Kiwi.prepare`) 시점에 모델 구축을 다시 수행합니다.
+이 함수가 줄여주는 것은 사전 파일을 읽고 해석하는 시간뿐이며, 모델 구축 시간은 줄어들지 않습니다.
+
+현재 Kiwi에 등록된 모든 형태소와 사용자 사전, 설정값을 `path` 디렉토리에 모델 디렉토리 형태로 저장합니다.
+저장된 디렉토리는 `Kiwi.load_model_dir`로 다시 불러올 수 있습니다.
+
+Parameters
+----------
+path: str
+    저장할 디렉토리 경로. 디렉토리가 없으면 새로 생성합니다.
+
+Notes
+-----
+기본 사전, 오타 사전, 다어절 사전과 `add_user_word`, `add_pre_analyzed_word`, `load_user_dictionary` 등으로 추가한 단어가 
+모두 하나의 형태소 테이블로 합쳐져 저장되므로, 불러올 때에는 사전 파일을 다시 읽고 해석하는 과정이 생략됩니다.
+결과물은 원본 모델의 파일들을 복사한 디렉토리이며, 단일 파일로 저장되거나 메모리 매핑되지는 않습니다.
+
+`add_re_word`로 추가한 패턴과 `user_value`, 분석 관련 설정값은 JSON 파일로 함께 저장됩니다. 
+따라서 호출 가능한 객체를 지정한 `add_re_word` 패턴이나 JSON으로 표현할 수 없는 `user_value`가 있으면 `ValueError`가 발생합니다.
+`typos`로 지정한 오타 교정 규칙은 저장되지 않으므로 `Kiwi.load_model_dir` 호출 시 다시 지정해야 합니다.
+
+```python
+kiwi = Kiwi()
+kiwi.load_user_dictionary('user_dict.txt')
+kiwi.save_model_dir('kiwi_model')
+
+# 다른 프로세스에서
+kiwi = Kiwi.load_model_dir('kiwi_model')
+```
+        '''
+        import os
+        import shutil
+        import json
+
+        re_words = []
+        for pattern, pretokenized, user_value in self._pretokenized_pats:
+            if callable(pretokenized):
+                raise ValueError(f"A pattern of `add_re_word` with a callable cannot be saved into a model directory: {pattern.pattern!r}")
+            re_words.append(dict(pattern=pattern.pattern, flags=int(pattern.flags), tag=pretokenized, user_value=user_value))
+
+        meta = dict(
+            version=__version__,
+            model_type=self.model_type,
+            integrate_allomorph=self._ns_integrate_allomorph,
+            settings=dict(
+                cutoff_threshold=self._ns_cutoff_threshold,
+                unk_form_score_scale=self._ns_unk_form_score_scale,
+                unk_form_score_bias=self._ns_unk_form_score_bias,
+                space_penalty=self._ns_space_penalty,
+                max_unk_form_size=self._ns_max_unk_form_size,
+                space_tolerance=self._ns_space_tolerance,
+                typo_cost_weight=self._ns_typo_cost_weight,
+            ),
+            re_words=re_words,
+            user_values=[[morph_id, value] for morph_id, value in self._user_values.items()],
+        )
+        # serialized before anything is written, so that an unsavable value leaves no partial directory behind
+        try:
+            meta = json.dumps(meta, ensure_ascii=False)
+        except (TypeError, ValueError) as e:
+            raise ValueError("Every `user_value` must be representable in JSON to be saved into a model directory.") from e
+
+        src_path = self._model_path
+        if src_path is None:
+            import kiwipiepy_model
+            src_path = kiwipiepy_model.get_model_path()
+        
+        os.makedirs(path, exist_ok=True)
+        # rule and auxiliary files are not rewritten by the builder, so take them from the source model as they are
+        if os.path.abspath(src_path) != os.path.abspath(path):
+            for name in os.listdir(src_path):
+                if os.path.isfile(os.path.join(src_path, name)):
+                    shutil.copyfile(os.path.join(src_path, name), os.path.join(path, name))
+        super()._save_model(path)
+        with open(os.path.join(path, Kiwi._MODEL_DIR_META), 'w', encoding='utf-8') as f:
+            f.write(meta)
+
+    @classmethod
+    def load_model_dir(cls,
+        path:str,
+        num_workers:Optional[int] = None,
+        typos:Optional[Union[str, TypoTransformer]] = None,
+        typo_cost_threshold:float = 2.5,
+    ) -> 'Kiwi':
+        '''.. versionadded:: 0.21.0
+
+`Kiwi.save_model_dir`로 저장한 디렉토리로부터 `Kiwi`를 생성합니다. 
+사전 파일을 해석하는 과정만 생략되며, 모델 구축은 첫 분석(혹은 `Kiwi.prepare`) 시점에 다시 수행됩니다.
+
+Parameters
+----------
+path: str
+    `Kiwi.save_model_dir`로 저장한 디렉토리 경로
+num_workers: int
+    `Kiwi` 생성자의 `num_workers`와 동일합니다.
+typos: Union[str, TypoTransformer]
+    `Kiwi` 생성자의 `typos`와 동일합니다.
+typo_cost_threshold: float
+    `Kiwi` 생성자의 `typo_cost_threshold`와 동일합니다.
+
+Notes
+-----
+메타데이터는 JSON으로만 저장되므로, 신뢰할 수 없는 디렉토리를 불러와도 임의의 코드가 실행되지 않습니다.
+        '''
+        import os
+        import json
+
+        with open(os.path.join(path, Kiwi._MODEL_DIR_META), encoding='utf-8') as f:
+            meta = json.load(f)
+
+        inst = cls(
+            num_workers=num_workers,
+            model_path=path,
+            integrate_allomorph=meta['integrate_allomorph'],
+            load_default_dict=False,
+            load_typo_dict=False,
+            load_multi_dict=False,
+            model_type=meta['model_type'],
+            typos=typos,
+            typo_cost_threshold=typo_cost_threshold,
+        )
+        # applied by `_on_build` once the model is built
+        for k, v in meta['settings'].items():
+            setattr(inst, '_ns_' + k, v)
+        def _restore_tag(tag):
+            # `PretokenizedToken`s come back from JSON as plain lists
+            if isinstance(tag, str): return tag
+            if tag and isinstance(tag[0], str): return PretokenizedToken(*tag)
+            return [PretokenizedToken(*t) for t in tag]
+
+        inst._pretokenized_pats = [(re.compile(w['pattern'], w['flags']), _restore_tag(w['tag']), w['user_value']) for w in meta['re_words']]
+        inst._re_words_dirty = True
+        inst._user_values = {morph_id:value for morph_id, value in meta['user_values']}
+        return inst
+
     def extract_words(self,
         texts,
         min_cnt:int = 10,
@@ -892,9 +1594,28 @@ result: List[Tuple[str, float, int, float]]
             lm_filter,
         )
     
+    def _sync_re_words(self):
+        native = []
+        for pat in self._pretokenized_pats:
+            pattern, s, user_value = pat
+            translated = None if callable(s) else _re_native.translate(pattern)
+            if translated is None: continue
+            if isinstance(s, str):
+                tokenization = s
+            elif isinstance(s, tuple) and len(s) == 4 and isinstance(s[0], str):
+                tokenization = [tuple(s)]
+            else:
+                tokenization = [tuple(t) for t in s]
+            native.append((pat, (*translated, tokenization, user_value)))
+        
+        rejected = super()._set_native_re_words([n for _, n in native])
+        native_ids = set(id(pat) for pat, _ in native) - set(id(native[i][0]) for i in rejected)
+        self._py_pretokenized_pats = [pat for pat in self._pretokenized_pats if id(pat) not in native_ids]
+        self._re_words_dirty = False
+
     def _make_pretokenized_spans(self, override_pretokenized, text:str):
         span_groups = []
-        for pattern, s, user_value in self._pretokenized_pats:
+        for pattern, s, user_value in self._py_pretokenized_pats:
             spans = []
             if callable(s):
                 for m in pattern.finditer(text):
@@ -921,6 +1642,45 @@ result: List[Tuple[str, float, int, float]]
         
         return span_groups
 
+    def _prepare_analyze_args(self,
+        text,
+        match_options:int,
+        normalize_coda:bool,
+        z_coda:bool,
+        split_complex:bool,
+        compatible_jamo:bool,
+        saisiot:Optional[bool],
+        blocklist,
+        pretokenized,
+    ):
+        if normalize_coda:
+            match_options |= Match.NORMALIZING_CODA
+        if z_coda:
+            match_options |= Match.Z_CODA
+        if split_complex:
+            match_options |= Match.SPLIT_COMPLEX
+        if compatible_jamo:
+            match_options |= Match.COMPATIBLE_JAMO
+        if saisiot is True:
+            match_options = (match_options & ~Match.MERGE_SAISIOT) | Match.SPLIT_SAISIOT
+        elif saisiot is False:
+            match_options = (match_options & ~Match.SPLIT_SAISIOT) | Match.MERGE_SAISIOT
+
+        if isinstance(blocklist, MorphemeSet):
+            if blocklist.kiwi != self: 
+                warnings.warn("This `MorphemeSet` isn't based on current Kiwi object.")
+                blocklist = MorphemeSet(self, blocklist.set)
+        elif blocklist is not None:
+            blocklist = MorphemeSet(self, blocklist)
+        
+        if blocklist: blocklist._update_self()
+
+        if not isinstance(text, str) and pretokenized and not callable(pretokenized):
+            raise ValueError("`pretokenized` must be a callable if `text` is an iterable of str.")
+        if self._re_words_dirty: self._sync_re_words()
+        pretokenized = partial(self._make_pretokenized_spans, pretokenized) if self._py_pretokenized_pats or pretokenized else None
+        return match_options, blocklist, pretokenized
+
     def analyze(self,
         text:Union[str, Iterable[str]],
         top_n:int = 1,
@@ -932,7 +1692,9 @@ result: List[Tuple[str, float, int, float]]
         saisiot:Optional[bool] = None,
         blocklist:Optional[Union[MorphemeSet, Iterable[str]]] = None,
         pretokenized:Optional[Union[Callable[[str], PretokenizedTokenList], PretokenizedTokenList]] = None,
-    ) -> List[Tuple[List[Token], float]]:
+        output:str = 'tokens',
+        ordered:bool = True,
+    ) -> List[Tuple[Union[List[Token], TokenArrays], float]]:
         '''형태소 분석을 실시합니다.
 
 .. versionchanged:: 0.10.0
@@ -962,6 +1724,19 @@ blocklist: Union[Iterable[str], MorphemeSet]
     이 인자는 `Kiwi.tokenize`에서와 동일한 역할을 수행합니다.
 pretokenized: Union[Callable[[str], PretokenizedTokenList], PretokenizedTokenList]
     이 인자는 `Kiwi.tokenize`에서와 동일한 역할을 수행합니다.
+output: str
+    .. versionadded:: 0.21.0
+
+    분석 결과의 형태를 지정합니다. 기본값인 `'tokens'`는 `Token`의 리스트를 반환하고,
+    `'arrays'`로 지정하면 `Token` 객체를 생성하지 않고 각 속성을 numpy 배열로 모은 `TokenArrays`를 반환합니다.
+    대량의 텍스트를 일괄 처리할 때 `'arrays'`를 사용하면 결과 객체 생성 비용을 크게 줄일 수 있습니다.
+    `'arrays'`에서는 `user_value` 및 이에 따른 태그 덮어쓰기가 적용되지 않습니다.
+ordered: bool
+    .. versionadded:: 0.21.0
+
+    `text`를 Iterable[str]으로 준 경우에만 유효합니다. 기본값인 True일 경우 입력 순서대로 결과를 반환합니다.
+    False일 경우 분석이 먼저 끝난 입력의 결과부터 즉시 반환하며, 각 결과는 `(입력 순번, 분석 결과)` 형태의 튜플로 주어집니다.
+    아주 긴 텍스트 하나 때문에 뒤따르는 결과들이 모두 지연되는 것을 막을 수 있습니다.
 
 Returns
 -------
@@ -999,34 +1774,89 @@ with open('result.txt', 'w', encoding='utf-8') as output:
         print(' '.join(map(lambda x:x[0]+'/'+x[1], res[0][0])), file=output)
 ```
         '''
-        if normalize_coda:
-            match_options |= Match.NORMALIZING_CODA
-        if z_coda:
-            match_options |= Match.Z_CODA
-        if split_complex:
-            match_options |= Match.SPLIT_COMPLEX
-        if compatible_jamo:
-            match_options |= Match.COMPATIBLE_JAMO
-        if saisiot is True:
-            match_options = (match_options & ~Match.MERGE_SAISIOT) | Match.SPLIT_SAISIOT
-        elif saisiot is False:
-            match_options = (match_options & ~Match.SPLIT_SAISIOT) | Match.MERGE_SAISIOT
+        match_options, blocklist, pretokenized = self._prepare_analyze_args(
+            text, match_options, normalize_coda, z_coda, split_complex, compatible_jamo, saisiot, blocklist, pretokenized
+        )
 
-        if isinstance(blocklist, MorphemeSet):
-            if blocklist.kiwi != self: 
-                warnings.warn("This `MorphemeSet` isn't based on current Kiwi object.")
-                blocklist = MorphemeSet(self, blocklist.set)
-        elif blocklist is not None:
-            blocklist = MorphemeSet(self, blocklist)
+        if output not in ('tokens', 'arrays'):
+            raise ValueError("`output` should be one of ('tokens', 'arrays'), but {}".format(output))
         
-        if blocklist: blocklist._update_self()
-
-        if not isinstance(text, str) and pretokenized and not callable(pretokenized):
-            raise ValueError("`pretokenized` must be a callable if `text` is an iterable of str.")
-        pretokenized = partial(self._make_pretokenized_spans, pretokenized) if self._pretokenized_pats or pretokenized else None
+        if output == 'arrays':
+            def _make_arrays(results):
+                return [(TokenArrays(*arrays), score) for arrays, score in results]
+            
+            if isinstance(text, str):
+                return _make_arrays(super().analyze(text, top_n, match_options, False, blocklist, pretokenized, self._OUTPUT_ARRAYS | self._OUTPUT_RE_WORDS, True))
+            if not ordered:
+                return ((idx, _make_arrays(results)) for idx, results in super().analyze(text, top_n, match_options, False, blocklist, pretokenized, self._OUTPUT_ARRAYS | self._OUTPUT_RE_WORDS, False))
+            return map(_make_arrays, super().analyze(text, top_n, match_options, False, blocklist, pretokenized, self._OUTPUT_ARRAYS | self._OUTPUT_RE_WORDS, True))
 
-        return super().analyze(text, top_n, match_options, False, blocklist, pretokenized)
+        return super().analyze(text, top_n, match_options, False, blocklist, pretokenized, self._OUTPUT_RE_WORDS, ordered)
     
+    async def analyze_async(self,
+        text:str,
+        top_n:int = 1,
+        match_options:int = Match.ALL,
+        normalize_coda:bool = False,
+        z_coda:bool = True,
+        split_complex:bool = False,
+        compatible_jamo:bool = False,
+        saisiot:Optional[bool] = None,
+        blocklist:Optional[Union[MorphemeSet, Iterable[str]]] = None,
+        pretokenized:Optional[Union[Callable[[str], PretokenizedTokenList], PretokenizedTokenList]] = None,
+    ) -> List[Tuple[List[Token], float]]:
+        '''.. versionadded:: 0.21.0
+
+`Kiwi.analyze`의 asyncio 버전입니다. 단일 텍스트를 `Kiwi`의 작업 스레드에서 분석하고, 분석이 끝나면 이벤트 루프로 결과를 전달하는 awaitable을 반환합니다.
+분석이 진행되는 동안 Python 스레드나 별도의 executor를 점유하지 않으므로 이벤트 루프를 막지 않습니다.
+
+인자는 `text`가 단일 `str`만 가능하다는 점을 제외하고는 `Kiwi.analyze`와 동일합니다.
+
+Notes
+-----
+```python
+import asyncio
+kiwi = Kiwi(num_workers=4)
+
+async def main(texts):
+    return await asyncio.gather(*(kiwi.analyze_async(text) for text in texts))
+
+asyncio.run(main(['형태소 분석 결과입니다', '비동기로 분석합니다']))
+```
+        '''
+        import asyncio
+
+        if not isinstance(text, str):
+            raise ValueError("`analyze_async` requires an instance of `str`.")
+
+        match_options, blocklist, pretokenized = self._prepare_analyze_args(
+            text, match_options, normalize_coda, z_coda, split_complex, compatible_jamo, saisiot, blocklist, pretokenized
+        )
+
+        loop = asyncio.get_running_loop()
+        future = loop.create_future()
+
+        def _resolve(handle):
+            # the tokens are built here, on the thread of the event loop
+            if future.cancelled(): return
+            try:
+                result = handle._build()
+            except Exception as e:
+                future.set_exception(e)
+            else:
+                future.set_result(result)
+
+        def _on_complete(handle):
+            # called from a worker thread of Kiwi, which holds the GIL only during this call
+            try:
+                loop.call_soon_threadsafe(_resolve, handle)
+            except RuntimeError:
+                # the event loop has been closed already
+                pass
+
+        super()._analyze_async(text, top_n, match_options, blocklist, pretokenized, _on_complete)
+        return await future
+
     def morpheme(self,
         idx:int,
     ):
@@ -1156,6 +1986,61 @@ True일 경우 음운론적 이형태를 통합하여 출력합니다. /아/와
         if v <= 0: raise ValueError("`typo_cost_threshold` must greater than 0")
         self._typo_cost_threshold = float(v)
 
+    @property
+    def prefetch_items(self):
+        '''.. versionadded:: 0.21.0
+
+여러 텍스트를 한 번에 분석할 때 미리 분석을 요청해둘 최대 텍스트 개수입니다. 
+실제 선행 처리 개수는 `num_workers`와 이 값 사이에서 결과를 소비하는 속도에 맞춰 자동으로 조절됩니다.
+0일 경우 `num_workers * 16`을 사용합니다. 기본값은 0입니다.
+
+`Kiwi.analyze`가 반환하는 반복자의 `window_size`, `stall_count`, `pending_chars` 속성으로 현재 선행 처리 개수, 
+결과를 기다리느라 멈춘 횟수, 분석 대기 중인 전체 글자 수를 확인할 수 있습니다.
+        '''
+        return self._prefetch_items
+
+    @prefetch_items.setter
+    def prefetch_items(self, v:int):
+        if v < 0: raise ValueError("`prefetch_items` must be a zero or positive integer.")
+        self._prefetch_items = int(v)
+
+    @property
+    def prefetch_chars(self):
+        '''.. versionadded:: 0.21.0
+
+여러 텍스트를 한 번에 분석할 때 동시에 분석 대기 중일 수 있는 입력 텍스트의 최대 글자 수입니다. 
+긴 문서를 분석할 때 메모리 사용량을 제한하는 데에 사용할 수 있습니다. 0일 경우 제한하지 않습니다. 기본값은 0입니다.
+        '''
+        return self._prefetch_chars
+
+    @prefetch_chars.setter
+    def prefetch_chars(self, v:int):
+        if v < 0: raise ValueError("`prefetch_chars` must be a zero or positive integer.")
+        self._prefetch_chars = int(v)
+
+    @property
+    def micro_batch_chars(self):
+        '''.. versionadded:: 0.21.0
+
+여러 텍스트를 한 번에 분석할 때, 연속된 짧은 텍스트들을 글자 수 합이 이 값에 이를 때까지 모아 하나의 작업으로 처리합니다.
+트윗이나 검색어처럼 짧은 텍스트가 많은 경우 작업 분배에 드는 부가 비용을 줄여 처리 속도를 높입니다.
+모든 스레드가 작업 중일 때에만 텍스트를 모으므로 스레드가 놀고 있는 상황은 발생하지 않습니다.
+0일 경우 텍스트를 모으지 않고 하나씩 처리합니다. 기본값은 256입니다.
+        '''
+        return self._micro_batch_chars
+
+    @micro_batch_chars.setter
+    def micro_batch_chars(self, v:int):
+        if v < 0: raise ValueError("`micro_batch_chars` must be a zero or positive integer.")
+        self._micro_batch_chars = int(v)
+
+    @staticmethod
+    def _refine_tokens(results, split_sents, stopwords):
+        tokens, _ = results[0]
+        if not split_sents:
+            return tokens if stopwords is None else stopwords.filter(tokens)
+        return [list(g) if stopwords is None else stopwords.filter(g) for k, g in itertools.groupby(tokens, key=lambda x:x.sent_position)]
+
     def _tokenize(self, 
         text:Union[str, Iterable[str]], 
         match_options:int = Match.ALL,
@@ -1169,52 +2054,27 @@ True일 경우 음운론적 이형태를 통합하여 출력합니다. /아/와
         echo:bool = False,
         blocklist:Optional[Union[Iterable[str], MorphemeSet]] = None,
         pretokenized:Optional[Union[Callable[[str], PretokenizedTokenList], PretokenizedTokenList]] = None,
+        ordered:bool = True,
     ):
         def _refine_result(results):
-            if not split_sents:
-                return results[0][0] if stopwords is None else stopwords.filter(results[0][0])
-            
-            tokens, _ = results[0]
-            ret = [list(g) if stopwords is None else stopwords.filter(g) for k, g in itertools.groupby(tokens, key=lambda x:x.sent_position)]
-            return ret
+            return self._refine_tokens(results, split_sents, stopwords)
         
         def _refine_result_with_echo(arg):
             results, raw_input = arg
             return _refine_result(results), raw_input
 
-        if normalize_coda:
-            match_options |= Match.NORMALIZING_CODA
-        if z_coda:
-            match_options |= Match.Z_CODA
-        if split_complex:
-            match_options |= Match.SPLIT_COMPLEX
-        if compatible_jamo:
-            match_options |= Match.COMPATIBLE_JAMO
-        
-        if saisiot is True:
-            match_options = (match_options & ~Match.MERGE_SAISIOT) | Match.SPLIT_SAISIOT
-        elif saisiot is False:
-            match_options = (match_options & ~Match.SPLIT_SAISIOT) | Match.MERGE_SAISIOT
-
-        if isinstance(blocklist, MorphemeSet):
-            if blocklist.kiwi != self: 
-                warnings.warn("This `MorphemeSet` isn't based on current Kiwi object.")
-                blocklist = MorphemeSet(self, blocklist.set)
-        elif blocklist is not None:
-            blocklist = MorphemeSet(self, blocklist)
-        
-        if blocklist: blocklist._update_self()
-
-        if not isinstance(text, str) and pretokenized and not callable(pretokenized):
-            raise ValueError("`pretokenized` must be a callable if `text` is an iterable of str.")
-
-        pretokenized = partial(self._make_pretokenized_spans, pretokenized) if self._pretokenized_pats or pretokenized else None
+        match_options, blocklist, pretokenized = self._prepare_analyze_args(
+            text, match_options, normalize_coda, z_coda, split_complex, compatible_jamo, saisiot, blocklist, pretokenized
+        )
 
         if isinstance(text, str):
             echo = False
-            return _refine_result(super().analyze(text, 1, match_options, False, blocklist, pretokenized))
+            return _refine_result(super().analyze(text, 1, match_options, False, blocklist, pretokenized, self._OUTPUT_RE_WORDS, True))
         
-        return map(_refine_result_with_echo if echo else _refine_result, super().analyze(text, 1, match_options, echo, blocklist, pretokenized))
+        refine = _refine_result_with_echo if echo else _refine_result
+        if not ordered:
+            return ((idx, refine(results)) for idx, results in super().analyze(text, 1, match_options, echo, blocklist, pretokenized, self._OUTPUT_RE_WORDS, False))
+        return map(refine, super().analyze(text, 1, match_options, echo, blocklist, pretokenized, self._OUTPUT_RE_WORDS, True))
 
     def tokenize(self, 
         text:Union[str, Iterable[str]], 
@@ -1229,6 +2089,7 @@ True일 경우 음운론적 이형태를 통합하여 출력합니다. /아/와
         echo:bool = False,
         blocklist:Optional[Union[Iterable[str], MorphemeSet]] = None,
         pretokenized:Optional[Union[Callable[[str], PretokenizedTokenList], PretokenizedTokenList]] = None,
+        ordered:bool = True,
     ) -> Union[List[Token], Iterable[List[Token]], List[List[Token]], Iterable[List[List[Token]]]]:
         '''.. versionadded:: 0.10.2
 
@@ -1299,6 +2160,11 @@ pretokenized: Union[Callable[[str], PretokenizedTokenList], PretokenizedTokenLis
     형태소 분석에 앞서 텍스트 내 특정 구간의 형태소 분석 결과를 미리 정의합니다. 이 값에 의해 정의된 텍스트 구간은 항상 해당 방법으로만 토큰화됩니다.
     이 값은 str을 입력 받아 `PretokenizedTokenList`를 반환하는 `Callable`로 주어지거나, `PretokenizedTokenList` 값 단독으로 주어질 수 있습니다.
     `text`가 `Iterable[str]`인 경우 `pretokenized`는 None 혹은 `Callable`로 주어져야 합니다. 자세한 것은 아래 Notes의 예시를 참조하십시오.
+ordered: bool
+
+    .. versionadded:: 0.21.0
+
+    이 인자는 `Kiwi.analyze`에서와 동일한 역할을 수행합니다. False일 경우 각 결과는 `(입력 순번, 결과)` 형태의 튜플로 주어집니다.
 Returns
 -------
 result: List[Token]
@@ -1432,9 +2298,35 @@ Notes
                               z_coda, split_complex, compatible_jamo, saisiot,
                               split_sents, stopwords, echo, 
                               blocklist=blocklist, 
-                              pretokenized=pretokenized
+                              pretokenized=pretokenized,
+                              ordered=ordered,
         )
 
+    async def tokenize_async(self,
+        text:str,
+        match_options:int = Match.ALL,
+        normalize_coda:bool = False,
+        z_coda:bool = True,
+        split_complex:bool = False,
+        compatible_jamo:bool = False,
+        saisiot:Optional[bool] = None,
+        split_sents:bool = False,
+        stopwords:Optional[Stopwords] = None,
+        blocklist:Optional[Union[Iterable[str], MorphemeSet]] = None,
+        pretokenized:Optional[Union[Callable[[str], PretokenizedTokenList], PretokenizedTokenList]] = None,
+    ) -> Union[List[Token], List[List[Token]]]:
+        '''.. versionadded:: 0.21.0
+
+`Kiwi.tokenize`의 asyncio 버전입니다. 동작 방식은 `Kiwi.analyze_async`와 동일하며, 
+인자는 `text`가 단일 `str`만 가능하고 `echo`를 지원하지 않는다는 점을 제외하고는 `Kiwi.tokenize`와 동일합니다.
+
+```python
+tokens = await kiwi.tokenize_async("안녕하세요 형태소 분석기 키위입니다.")
+```
+        '''
+        results = await self.analyze_async(text, 1, match_options, normalize_coda, z_coda, split_complex, compatible_jamo, saisiot, blocklist, pretokenized)
+        return self._refine_tokens(results, split_sents, stopwords)
+
     def split_into_sents(self, 
         text:Union[str, Iterable[str]], 
         match_options:int = Match.ALL, 
@@ -1447,6 +2339,8 @@ Notes
         blocklist:Optional[Union[Iterable[str], MorphemeSet]] = None,
         return_tokens:bool = False,
         return_sub_sents:bool = True,
+        ordered:bool = True,
+        output:str = 'sentences',
     ) -> Union[List[Sentence], Iterable[List[Sentence]]]:
         '''..versionadded:: 0.10.3
 
@@ -1485,6 +2379,19 @@ return_sub_sents: bool
     ..versionadded:: 0.14.0
 
     True인 경우 문장 내 안긴 문장의 목록도 함께 반환합니다.
+ordered: bool
+
+    .. versionadded:: 0.21.0
+
+    이 인자는 `Kiwi.analyze`에서와 동일한 역할을 수행합니다. False일 경우 각 결과는 `(입력 순번, 문장 목록)` 형태의 튜플로 주어집니다.
+output: str
+
+    .. versionadded:: 0.21.0
+
+    결과의 형태를 지정합니다. 기본값인 'sentences'는 `kiwipiepy.Sentence`의 리스트를 반환합니다.
+    'spans'는 각 문장의 시작 및 끝 위치를 담은 `(문장 개수, 2)` 크기의 `numpy.ndarray`만을 반환하며, `Token`이나 문장 문자열을 전혀 생성하지 않으므로 가장 빠릅니다.
+    'arrays'는 'spans'의 결과와 함께 문장 전체의 형태소 분석 결과를 `TokenArrays`로 묶은 튜플 `(spans, TokenArrays)`를 반환합니다. 
+    'spans'와 'arrays'에서는 `return_tokens`, `return_sub_sents`, `stopwords`가 무시됩니다.
 
 Returns
 -------
@@ -1542,60 +2449,84 @@ Notes
 ])]
 ```
         '''
-        def _filter_tokens(tokens):
-            return tokens if stopwords is None else stopwords.filter(tokens)
+        if output == 'sentences':
+            output_flags = Kiwi._OUTPUT_SENTENCES
+            if return_tokens: output_flags |= Kiwi._OUTPUT_SENTENCE_TOKENS
+            if return_sub_sents: output_flags |= Kiwi._OUTPUT_SUB_SENTENCES
+        elif output == 'spans':
+            output_flags = Kiwi._OUTPUT_SENTENCES | Kiwi._OUTPUT_SENTENCE_SPANS
+        elif output == 'arrays':
+            output_flags = Kiwi._OUTPUT_SENTENCES | Kiwi._OUTPUT_SENTENCE_SPANS | Kiwi._OUTPUT_ARRAYS
+        else:
+            raise ValueError("`output` should be one of ('sentences', 'spans', 'arrays'), but {}".format(output))
+
+        # the sentences are built by `_Kiwi.analyze`, and only stopwords are left to Python
+        def _filter_sent(sent):
+            return sent._replace(
+                tokens=stopwords.filter(sent.tokens), 
+                subs=None if sent.subs is None else [_filter_sent(sub) for sub in sent.subs],
+            )
+
+        if output == 'arrays':
+            def _make_result(result):
+                spans, arrays = result
+                return spans, TokenArrays(*arrays)
+        elif output == 'sentences' and stopwords is not None and return_tokens:
+            def _make_result(result):
+                return [_filter_sent(sent) for sent in result]
+        else:
+            _make_result = None
 
-        def _make_result(arg):
-            sents, raw_input = arg
-            ret = []
-            for sent in sents:
-                start = sent[0].start
-                end = sent[-1].end
-                tokens = _filter_tokens(sent) if return_tokens else None
-                subs = None
-                if return_sub_sents:
-                    subs = []
-                    sub_toks = []
-                    last = 0
-                    for tok in sent:
-                        if tok.sub_sent_position != last:
-                            if last:
-                                subs.append(Sentence(raw_input[sub_start:last_end], sub_start, last_end, _filter_tokens(sub_toks) if return_tokens else None, None))
-                                sub_toks = []
-                            sub_start = tok.start
-                        if tok.sub_sent_position:
-                            sub_toks.append(tok)
-                        last = tok.sub_sent_position
-                        last_end = tok.end
-                ret.append(Sentence(raw_input[start:end], start, end, tokens, subs))
-            return ret
+        match_options, blocklist, pretokenized = self._prepare_analyze_args(
+            text, match_options, normalize_coda, z_coda, split_complex, compatible_jamo, saisiot, blocklist, None
+        )
 
         if isinstance(text, str):
-            return _make_result((self._tokenize(text, 
-                                                match_options=match_options, 
-                                                normalize_coda=normalize_coda, 
-                                                z_coda=z_coda, 
-                                                split_complex=split_complex, 
-                                                compatible_jamo=compatible_jamo,
-                                                saisiot=saisiot,
-                                                blocklist=blocklist, 
-                                                split_sents=True), text))
-
-        return map(_make_result, self._tokenize(text, 
-                                                match_options=match_options, 
-                                                normalize_coda=normalize_coda, 
-                                                z_coda=z_coda, 
-                                                split_complex=split_complex, 
-                                                compatible_jamo=compatible_jamo,
-                                                saisiot=saisiot,
-                                                blocklist=blocklist, 
-                                                split_sents=True, 
-                                                echo=True))
+            result = super().analyze(text, 1, match_options, False, blocklist, pretokenized, output_flags | self._OUTPUT_RE_WORDS, True)
+            return _make_result(result) if _make_result else result
+
+        results = super().analyze(text, 1, match_options, False, blocklist, pretokenized, output_flags | self._OUTPUT_RE_WORDS, ordered)
+        if _make_result is None:
+            return results
+        if not ordered:
+            return ((idx, _make_result(result)) for idx, result in results)
+        return map(_make_result, results)
+
+    def space_insertions(self,
+        text_chunks:Iterable[str],
+        window:int = 32,
+    ) -> 'np.ndarray':
+        '''.. versionadded:: 0.21.0
+
+각 텍스트 조각의 경계마다 공백을 삽입해야 하는지 여부를 판단합니다. `Kiwi.glue`가 내부적으로 사용하는 기능입니다.
+
+Parameters
+----------
+text_chunks: Iterable[str]
+    텍스트 조각들의 목록입니다. 각 조각의 앞뒤 공백은 무시됩니다.
+window: int
+    각 경계에서 분석할 앞뒤 문맥의 최대 길이(문자 수)입니다. 문맥은 가능한 한 공백 위치에서 잘리므로 실제로는 이보다 짧을 수 있습니다.
+    0인 경우 두 조각 전체를 분석합니다. 기본값은 32입니다.
+
+Returns
+-------
+space_insertions: np.ndarray
+    길이가 `len(text_chunks) - 1`인 bool 배열입니다. i번째 값은 i번째 조각과 i+1번째 조각 사이에 공백을 넣어야 하는지 여부입니다.
+
+Notes
+-----
+각 경계마다 경계 주변의 문맥만을 공백을 넣은 경우와 넣지 않은 경우로 한 번씩 분석하여 점수를 비교하므로, 
+조각이 길어도 경계 하나를 판단하는 비용은 `window`에 의해 제한됩니다. 각 경계는 스레드 풀에서 병렬로 처리됩니다.
+        '''
+        if window < 0:
+            raise ValueError("`window` must be a non-negative integer.")
+        return super()._glue([c.strip() for c in text_chunks], window)
 
     def glue(self,
         text_chunks:Iterable[str],
         insert_new_lines:Optional[Iterable[bool]] = None,
         return_space_insertions:bool = False,
+        window:int = 0,
     ) -> Union[str, Tuple[str, List[bool]]]:
         '''..versionadded:: 0.11.1
 
@@ -1614,6 +2545,13 @@ insert_new_lines: Iterable[bool]
 return_space_insertions: bool
     True인 경우, 각 조각별 공백 삽입 유무를 `List[bool]`로 반환합니다.
     기본값은 False입니다.
+window: int
+
+    .. versionadded:: 0.21.0
+
+    공백 삽입 여부를 판단할 때 각 경계의 앞뒤로 분석할 문맥의 최대 길이(문자 수)입니다.
+    기본값인 0은 이전 버전과 마찬가지로 두 조각 전체를 분석하므로 결과가 이전 버전과 동일합니다. 
+    조각이 긴 경우 32 정도의 값을 주면 경계 하나를 판단하는 비용이 조각의 길이와 무관해집니다. 자세한 내용은 `Kiwi.space_insertions`를 참조하십시오.
 
 Returns
 -------
@@ -1643,50 +2581,24 @@ Notes
 ```
         '''
 
-        all_chunks = []
-        def _zip_consequences(it):
-            try:
-                prev = next(it).strip()
-            except StopIteration:
-                return
-
-            all_chunks.append(prev)
-            for s in it:
-                s = s.strip()
-                yield prev + ' ' + s
-                yield prev + s
-                prev = s
-                all_chunks.append(prev)
-        
-        def _repeat_false():
-            while 1:
-                yield False
+        all_chunks = [c.strip() for c in text_chunks]
+        if not all_chunks:
+            return ('', []) if return_space_insertions else ''
 
-        riter = super().analyze(_zip_consequences(iter(text_chunks)), 1, Match.ALL, False, None, None)
-            
-        if insert_new_lines is None: 
-            insert_new_lines = _repeat_false()
+        insertions = self.space_insertions(all_chunks, window)
+        if insert_new_lines is None:
+            insert_new_lines = itertools.repeat(False)
         else:
             insert_new_lines = iter(insert_new_lines)
-        i = 0
+
         ret = []
         space_insertions = []
-        try:
-            while 1:
-                _, score_with_space = next(riter)[0]
-                _, score_without_space = next(riter)[0]
-                is_new_line = next(insert_new_lines)
-                ret.append(all_chunks[i])
-                if score_with_space >= score_without_space or re.search(r'[0-9A-Za-z]$', all_chunks[i]):
-                    ret.append('\n' if is_new_line else ' ')
-                    space_insertions.append(True)
-                else:
-                    space_insertions.append(False)
-                i += 1
-        except StopIteration:
-            if i < len(all_chunks):
-                ret.append(all_chunks[i])
-        
+        for chunk, inserted, is_new_line in zip(all_chunks, insertions.tolist(), insert_new_lines):
+            ret.append(chunk)
+            if inserted: ret.append('\n' if is_new_line else ' ')
+            space_insertions.append(inserted)
+        ret.append(all_chunks[len(space_insertions)])
+
         if return_space_insertions:
             return ''.join(ret), space_insertions
         else:
@@ -1739,58 +2651,10 @@ Notes
 "띄어쓰기 문제가 있습니다"
 ```
         '''
-        ws = re.compile(r'(?<=[가-힣])\s+(?=[가-힣.,?!:;])')
-        any_ws = re.compile(r'\s+')
-        space_insertable = re.compile('|'.join([
-            r'(([^SUWX]|X[RS]|S[EH]).* ([NMI]|V[VAX]|VCN|XR|XPN|S[WLHN]))',
-            r'(SN ([MI]|N[PR]|NN[GP]|V[VAX]|VCN|XR|XPN|S[WH]))',
-            r'((S[FPL]).* ([NMI]|V[VAX]|VCN|XR|XPN|S[WH]))',
-        ]))
-
-        def _reset(t):
-            return ws.sub('', t)
-
-        def _space(arg):
-            tokens, raw = arg
-            tokens = tokens[0][0]
-            chunks = []
-            last = 0
-            prev_tag = None
-            for i, t in enumerate(tokens):
-                if last < t.start:
-                    if (t.tag.startswith('E') or t.tag.startswith('J') or t.tag.startswith('XS')
-                        or t.tag == 'VX' and t.form in '하지'
-                        or prev_tag == 'SN' and t.tag == 'NNB'
-                    ):
-                        s = any_ws.sub('', raw[last:t.start])
-                    else:
-                        s = raw[last:t.start]
-                    if s: chunks.append(s)
-                    last = t.start
-                if prev_tag and space_insertable.match(prev_tag + ' ' + t.tag):
-                    if t.tag == 'VX' and t.form in '하지':
-                        pass # 보조 용언 중 `하다/지다`는 붙여쓴다.
-                    elif not chunks[-1][-1].isspace():
-                        # 이전에 공백이 없는 경우만 삽입
-                        chunks.append(' ') 
-                if last < t.end:
-                    if t.tag.startswith('NN') and (i + 1 >= len(tokens) or t.end <= tokens[i + 1].start):
-                        s = t.form
-                    else:
-                        s = any_ws.sub('', raw[last:t.end])
-                    if s: chunks.append(s)
-                last = t.end
-                prev_tag = t.tag
-            if last < len(raw):
-                chunks.append(raw[last:])
-            return ''.join(chunks)
-
-        if isinstance(text, str):
-            if reset_whitespace: text = _reset(text)
-            return _space((super().analyze(text, 1, Match.ALL | Match.Z_CODA, False, None, None), text))
-        else:
-            if reset_whitespace: text = map(_reset, text)
-            return map(_space, super().analyze(text, 1, Match.ALL | Match.Z_CODA, True, None, None))
+        # the spacing rules are applied in the worker threads right after the analysis, so only the corrected text comes back
+        output_flags = Kiwi._OUTPUT_SPACED
+        if reset_whitespace: output_flags |= Kiwi._OUTPUT_RESET_WHITESPACE
+        return super().analyze(text, 1, Match.ALL | Match.Z_CODA, False, None, None, output_flags, True)
 
     def join(self, 
         morphs:Iterable[Tuple[str, str]],
@@ -2003,10 +2867,93 @@ ValueError: cannot specify format specifier for Kiwi Token
         output_path:str,
         morpheme_def_path:str = None,
         morpheme_def_min_cnt:int = 0,
+        max_shard_bytes:Optional[int] = None,
+        num_workers:int = 1,
+        callback:Optional[HSDataConversionCallback] = None,
     ):
+        '''
+Parameters
+----------
+max_shard_bytes: Optional[int]
+    .. versionadded:: 0.21.0
+
+    None이 아니면 `input_path`의 파일들을 입력 크기의 합이 이 값을 넘지 않도록 순서대로 묶어 
+    각 묶음을 `{output_path}.{번호}` 파일로 변환하고, `output_path`에는 이 shard들의 목록을 기록합니다. 
+    이렇게 만든 `output_path`는 `Kiwi.make_streaming_hsdataset`으로 읽을 수 있습니다.
+    크기가 이 값보다 큰 입력 파일은 단독으로 하나의 shard가 됩니다.
+num_workers: int
+    .. versionadded:: 0.21.0
+
+    변환에 사용할 스레드의 수입니다. 1보다 크면 shard들을 동시에 변환하며, 
+    `max_shard_bytes`가 None이면 입력 파일 하나가 하나의 shard가 됩니다.
+    스레드마다 사전(`KiwiBuilder`) 전체를 복사해서 사용하므로, 스레드 하나가 늘 때마다 사전 하나만큼의 메모리가 추가로 필요합니다. 
+    shard 수보다 많은 스레드는 쓸모가 없으므로 이 값은 shard 수로 제한됩니다.
+    이 경우에도 `output_path`는 shard들의 목록이 되며, `Kiwi.make_hsdataset`과 `Kiwi.make_streaming_hsdataset`에 그대로 입력할 수 있습니다.
+callback: HSDataConversionCallback
+    .. versionadded:: 0.21.0
+
+    변환의 진행상황을 보고받을 콜백입니다. 콜백은 이 함수를 호출한 스레드에서 호출됩니다.
+
+Notes
+-----
+변환하는 동안에는 GIL이 해제됩니다. 변환이 끝나기 전에 다른 스레드에서 `add_user_word` 등으로 사전을 수정하려고 하면 `RuntimeError`가 발생합니다.
+
+shard 목록을 기록할 때에는 `Kiwi.make_streaming_hsdataset`이 shard를 읽지 않고도 어휘 집합을 알 수 있도록, 
+가장 작은 shard를 한 번 읽어 그 어휘 집합을 함께 기록합니다.
+
+shard 중 하나라도 변환에 실패하면 아직 시작하지 않은 shard는 변환하지 않고, 
+이번 호출에서 쓰기 시작한 shard 파일을 모두 삭제한 뒤 예외를 발생시킵니다. 이 경우 `output_path`의 shard 목록도 기록되지 않습니다.
+`callback`에서 예외가 발생한 경우도 마찬가지입니다.
+        '''
         if isinstance(input_path, str):
             input_path = [input_path]
-        return super().convert_hsdata(input_path, output_path, morpheme_def_path, morpheme_def_min_cnt)
+        if max_shard_bytes is not None and max_shard_bytes <= 0:
+            raise ValueError("`max_shard_bytes` must be a positive integer.")
+        if num_workers < 1:
+            raise ValueError("`num_workers` must be a positive integer.")
+
+        sizes = [os.path.getsize(path) for path in input_path]
+        start_time = time.perf_counter()
+        converted = [0, 0]
+        def _report(method):
+            elapsed = time.perf_counter() - start_time
+            method(converted[0], converted[1], elapsed, converted[1] / elapsed if elapsed > 0 else 0.)
+
+        if callback: callback.begin(len(input_path), sum(sizes))
+        if max_shard_bytes is None and num_workers == 1:
+            super().convert_hsdata(input_path, output_path, morpheme_def_path, morpheme_def_min_cnt)
+            converted[:] = [len(input_path), sum(sizes)]
+            if callback: _report(callback.end)
+            return
+
+        groups = _group_by_size(sizes, max_shard_bytes)
+        shards = ['{}.{:05d}'.format(output_path, i) for i in range(len(groups))]
+        # every worker holds a copy of the whole dictionary, so none is spawned without a shard to convert
+        num_workers = max(min(num_workers, len(groups)), 1)
+
+        def _on_converted(i):
+            converted[0] += len(groups[i])
+            converted[1] += sum(sizes[j] for j in groups[i])
+            if callback: _report(callback.proc)
+
+        super()._convert_hsdata_shards(
+            [[input_path[j] for j in group] for group in groups], 
+            shards, 
+            morpheme_def_path, 
+            morpheme_def_min_cnt, 
+            num_workers, 
+            _on_converted,
+        )
+        # the vocabulary is recorded so that `make_streaming_hsdataset` does not have to read a shard for it
+        vocab = None
+        if groups:
+            smallest = min(range(len(groups)), key=lambda i: sum(sizes[j] for j in groups[i]))
+            dataset = self.make_hsdataset([shards[smallest]], morpheme_def_path=morpheme_def_path, morpheme_def_min_cnt=morpheme_def_min_cnt)
+            vocab = StreamingHSDataset._meta_of(dataset)
+            del dataset
+            vocab['settings'] = StreamingHSDataset._vocab_settings(dict(morpheme_def_path=morpheme_def_path, morpheme_def_min_cnt=morpheme_def_min_cnt))
+        StreamingHSDataset._write_manifest(output_path, shards, vocab)
+        if callback: _report(callback.end)
 
     def make_hsdataset(
         self,
@@ -2024,7 +2971,49 @@ ValueError: cannot specify format specifier for Kiwi Token
         morpheme_def_path:str = None,
         morpheme_def_min_cnt:int = 0,
         seed:int = 0,
+        rank:int = 0,
+        world_size:int = 1,
+        loader_worker_id:int = 0,
+        num_loader_workers:int = 1,
     ):
+        '''
+Parameters
+----------
+split_ratio: float
+    0보다 크면 읽어들인 문장 중 이 비율만큼을 떼어 검증용 데이터셋으로 만들고, `(학습용 데이터셋, 검증용 데이터셋)`을 반환합니다.
+    `world_size * num_loader_workers`가 1보다 크면 검증용 데이터셋도 이 shard에 배정된 파일에서만 떼어내므로, 
+    rank마다 서로 다른 검증용 데이터셋을 가지게 됩니다. 전체 검증 손실은 모든 rank의 결과를 합산하여 구해야 합니다.
+rank: int
+    .. versionadded:: 0.21.0
+
+    분산 학습에서 현재 프로세스의 rank입니다.
+world_size: int
+    .. versionadded:: 0.21.0
+
+    분산 학습에 참여하는 전체 프로세스의 수입니다.
+loader_worker_id: int
+    .. versionadded:: 0.21.0
+
+    현재 rank 안에서 데이터를 읽는 worker(예: `torch.utils.data.DataLoader`의 worker)의 번호입니다.
+num_loader_workers: int
+    .. versionadded:: 0.21.0
+
+    각 rank가 사용하는 데이터 읽기 worker의 수입니다.
+
+Notes
+-----
+`world_size * num_loader_workers`가 1보다 크면 `inputs`의 파일들을 그 수만큼의 shard로 나누고, 
+`rank * num_loader_workers + loader_worker_id`번째 shard에 속한 파일만 읽습니다. 
+파일은 크기가 고르게 나뉘도록 배정되며, 배정은 모든 rank에서 동일합니다. 
+`inputs`의 파일 수가 shard 수보다 적으면 경고와 함께 각 shard에 파일 하나씩을 돌아가며 배정하므로, 일부 파일은 여러 shard에서 중복으로 읽힙니다.
+파일 단위로 나누기 때문에 shard마다 배치의 개수가 다를 수 있습니다. 
+분산 학습에서는 `HSDataset.set_num_batches`로 모든 rank의 배치 수를 맞추어야 합니다.
+에폭마다 섞는 순서를 바꾸려면 `HSDataset.set_epoch`를 사용하세요.
+        '''
+        shard_index, num_shards = _shard_index(rank, world_size, loader_worker_id, num_loader_workers)
+        inputs = [s for path in inputs for s in (StreamingHSDataset._read_manifest(path) if StreamingHSDataset._is_manifest(path) else [path])]
+        if num_shards > 1:
+            inputs = _shard_paths(inputs, num_shards)[shard_index]
         return super().make_hsdataset(
             inputs, 
             batch_size, 
@@ -2039,8 +3028,112 @@ ValueError: cannot specify format specifier for Kiwi Token
             separate_default_morpheme, 
             morpheme_def_path, 
             morpheme_def_min_cnt, 
-            seed)
+            seed,
+            shard_index,
+            HSDataset)
+
+    def make_streaming_hsdataset(
+        self,
+        manifest_path:str,
+        batch_size:int = 128, 
+        causal_context_size:int = 0,
+        window_size:int = 8, 
+        num_workers:int = 1, 
+        dropout:float = 0, 
+        dropout_on_history:float = 0,
+        token_filter:Callable[[str, str], bool] = None, 
+        window_filter:Callable[[str, str], bool] = None, 
+        separate_default_morpheme:bool = False,
+        morpheme_def_path:str = None,
+        morpheme_def_min_cnt:int = 0,
+        seed:int = 0,
+        buffer_shards:int = 4,
+        rank:int = 0,
+        world_size:int = 1,
+        loader_worker_id:int = 0,
+        num_loader_workers:int = 1,
+    ) -> StreamingHSDataset:
+        '''.. versionadded:: 0.21.0
+
+`Kiwi.convert_hsdata`에 `max_shard_bytes`를 지정하여 만든 shard 목록을 디스크에서 필요할 때마다 읽어들이는 `StreamingHSDataset`을 생성합니다.
 
+Parameters
+----------
+manifest_path: str
+    `Kiwi.convert_hsdata`의 `output_path`로 지정했던 경로입니다.
+buffer_shards: int
+    동시에 메모리에 올려둘 shard의 최대 개수로, 미리 읽어두는 다음 shard를 포함합니다. 
+    값이 클수록 배치가 더 넓은 범위에서 섞이지만 메모리 사용량도 늘어납니다. 
+    shard는 통째로 읽어들이므로 최대 메모리 사용량은 대략 `buffer_shards` × (가장 큰 shard의 크기)입니다.
+rank, world_size, loader_worker_id, num_loader_workers: int
+    `Kiwi.make_hsdataset`과 동일하게, 지정된 경우 shard 파일들을 나누어 이 중 자신의 몫만 읽습니다.
+    이 경우 rank마다 배치의 개수가 다를 수 있으므로 `StreamingHSDataset.set_num_batches`로 맞추어야 합니다.
+
+나머지 인자들은 `Kiwi.make_hsdataset`과 동일합니다.
+        '''
+        if buffer_shards < 1:
+            raise ValueError("`buffer_shards` must be a positive integer.")
+        shard_index, num_shards = _shard_index(rank, world_size, loader_worker_id, num_loader_workers)
+        shards = StreamingHSDataset._read_manifest(manifest_path)
+        vocab = StreamingHSDataset._read_manifest_vocab(manifest_path)
+        if not shards:
+            raise ValueError("`{}` has no shards.".format(manifest_path))
+        if num_shards > 1:
+            shards = _shard_paths(shards, num_shards)[shard_index]
+        return StreamingHSDataset(self, shards, buffer_shards, seed, dict(
+            batch_size=batch_size,
+            causal_context_size=causal_context_size,
+            window_size=window_size,
+            num_workers=num_workers,
+            dropout=dropout,
+            dropout_on_history=dropout_on_history,
+            token_filter=token_filter,
+            window_filter=window_filter,
+            separate_default_morpheme=separate_default_morpheme,
+            morpheme_def_path=morpheme_def_path,
+            morpheme_def_min_cnt=morpheme_def_min_cnt,
+        ), vocab)
+
+
+def _shard_index(rank:int, world_size:int, loader_worker_id:int, num_loader_workers:int) -> Tuple[int, int]:
+    '''returns the index of the shard read by the given worker of the given rank, and the number of shards'''
+    if world_size < 1 or num_loader_workers < 1:
+        raise ValueError("`world_size` and `num_loader_workers` must be positive integers.")
+    if not (0 <= rank < world_size):
+        raise ValueError("`rank` must be in [0, world_size).")
+    if not (0 <= loader_worker_id < num_loader_workers):
+        raise ValueError("`loader_worker_id` must be in [0, num_loader_workers).")
+    return rank * num_loader_workers + loader_worker_id, world_size * num_loader_workers
+
+def _group_by_size(sizes:List[int], max_bytes:Optional[int]) -> List[List[int]]:
+    '''groups the indices of `sizes` in order so that each group sums to at most `max_bytes`, or one index per group if it is None'''
+    groups = []
+    group_bytes = 0
+    for i, size in enumerate(sizes):
+        if not groups or max_bytes is None or group_bytes + size > max_bytes:
+            groups.append([])
+            group_bytes = 0
+        groups[-1].append(i)
+        group_bytes += size
+    return groups
+
+def _shard_paths(paths:List[str], num_shards:int) -> List[List[str]]:
+    '''splits `paths` into `num_shards` lists of similar total size, the same way on every rank'''
+    paths = list(paths)
+    if not paths:
+        raise ValueError("`inputs` must not be empty.")
+    if len(paths) < num_shards:
+        warnings.warn("`inputs` has {} files, which is fewer than the number of shards ({}). "
+            "Some files are read by more than one shard.".format(len(paths), num_shards))
+        return [[paths[s % len(paths)]] for s in range(num_shards)]
+    sizes = [os.path.getsize(p) for p in paths]
+    loads = [0] * num_shards
+    assigned = [[] for _ in range(num_shards)]
+    for i in sorted(range(len(paths)), key=lambda i: (-sizes[i], i)):
+        shard = min(range(num_shards), key=lambda s: (loads[s], s))
+        loads[shard] += sizes[i]
+        assigned[shard].append(i)
+    return [[paths[i] for i in sorted(a)] for a in assigned]
 
 def extract_substrings(
     text:str,
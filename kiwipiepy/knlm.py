@@ -74,3 +74,45 @@ class KNLangModel(_KNLangModel):
                  deferred:bool = False,
                  ) -> List[float]:
         return super().evaluate(np.array(token_ids), deferred)
+
+    @staticmethod
+    def _pad(token_ids:Union[np.ndarray, List[List[int]]]) -> Tuple[np.ndarray, Optional[np.ndarray]]:
+        if isinstance(token_ids, np.ndarray):
+            return token_ids, None
+        lengths = np.array([len(t) for t in token_ids], dtype=np.int64)
+        padded = np.zeros((len(token_ids), lengths.max() if len(token_ids) else 0), dtype=np.int64)
+        for i, t in enumerate(token_ids):
+            padded[i, :len(t)] = t
+        return padded, lengths
+
+    def next_tokens_batch(self,
+                          token_ids:Union[np.ndarray, List[List[int]]],
+                          lengths:Optional[np.ndarray] = None,
+                          offsets:Optional[np.ndarray] = None,
+                          top_n:int = 1,
+                          deferred:bool = False,
+                          ) -> Tuple[np.ndarray, np.ndarray]:
+        '''여러 시퀀스에 대해 `next_tokens`를 한 번에 수행합니다.
+
+`token_ids`는 (시퀀스 수, 최대 길이) 모양의 2차원 배열이거나, `offsets`와 함께 주어지는 1차원 배열입니다.
+2차원 배열인 경우 `lengths`로 각 시퀀스의 길이를 지정할 수 있으며, 이를 넘는 위치는 패딩으로 간주합니다.
+1차원 배열인 경우 i번째 시퀀스는 `token_ids[offsets[i]:offsets[i + 1]]`입니다.
+`token_ids`가 시퀀스의 list이면 2차원 배열로 패딩하여 처리합니다.
+
+결과 배열은 입력과 같은 위치에 각 토큰의 결과를 담으며, 마지막 차원의 크기는 `top_n`입니다. 패딩된 위치의 값은 0입니다.
+시퀀스들은 `num_workers`개의 스레드에 나뉘어 처리됩니다.
+        '''
+        if offsets is None and lengths is None:
+            token_ids, lengths = self._pad(token_ids)
+        return super()._next_tokens_batch(token_ids, lengths, offsets, top_n, deferred)
+
+    def evaluate_batch(self,
+                       token_ids:Union[np.ndarray, List[List[int]]],
+                       lengths:Optional[np.ndarray] = None,
+                       offsets:Optional[np.ndarray] = None,
+                       deferred:bool = False,
+                       ) -> np.ndarray:
+        '''여러 시퀀스에 대해 `evaluate`를 한 번에 수행합니다. 입력과 결과의 형태는 `next_tokens_batch`와 같습니다.'''
+        if offsets is None and lengths is None:
+            token_ids, lengths = self._pad(token_ids)
+        return super()._evaluate_batch(token_ids, lengths, offsets, deferred)
@@ -6,7 +6,7 @@
 
 import re
 import itertools
-from typing import Callable, List, Optional, Tuple, Union, Iterable, Dict, Any
+from typing import Callable, List, Optional, Tuple, Union, Iterable, Dict, Any, NamedTuple
 from dataclasses import dataclass
 import warnings
 
@@ -164,6 +164,14 @@ class _ProgressShower(TrainerCallback):
 
 SPECIAL_TOKEN_NAMES = ['unk', 'cls', 'sep', 'mask', 'pad', 'bos', 'eos']
 
+EncodedBatch = NamedTuple('EncodedBatch', [('input_ids', 'np.ndarray'), ('attention_mask', 'np.ndarray'), ('offset_mapping', 'np.ndarray')])
+EncodedBatch.__doc__ = '''.. versionadded:: 0.21.0
+
+`SwTokenizer.encode_batch`의 결과입니다. 모든 배열은 C-contiguous한 int32 배열입니다.'''
+EncodedBatch.input_ids.__doc__ = '''`(텍스트 개수, 길이)` 크기의 token id 배열. 패딩 위치에는 `pad_token_id`(없는 경우 0)가 채워집니다.'''
+EncodedBatch.attention_mask.__doc__ = '''`(텍스트 개수, 길이)` 크기의 배열. 실제 토큰 위치는 1, 패딩 위치는 0입니다.'''
+EncodedBatch.offset_mapping.__doc__ = '''`(텍스트 개수, 길이, 2)` 크기의 배열. 각 토큰의 텍스트 상의 시작지점과 끝지점(문자 단위)이며 패딩 위치는 0입니다.'''
+
 class SwTokenizer(_SwTokenizer):
     '''
 형태소 분석기 Kiwi를 기반으로 한 서브워드 토크나이저(Subword Tokenizer)를 제공하는 클래스입니다.
@@ -204,6 +212,7 @@ num_workers: int
     def encode(self, 
         text: Union[str, Iterable[str]],
         return_offsets: bool = False,
+        ordered: bool = True,
     ) -> Union[List[int], Tuple[List[int], List[Tuple[int, int]]]]:
         '''
 주어진 텍스트를 토큰화하여 token id의 리스트로 반환합니다.
@@ -218,6 +227,12 @@ text: Union[str, Iterable[str]]
 return_offsets: bool
     True일 경우 각 토큰들의 텍스트 상의 시작지점 및 끝지점이 함께 반환됩니다.
 
+ordered: bool
+    .. versionadded:: 0.21.0
+
+    `text`를 `Iterable[str]`으로 준 경우에만 유효합니다. False일 경우 먼저 처리가 끝난 입력부터 
+    `(입력 순번, 결과)` 형태의 튜플로 반환합니다.
+
 Returns
 -------
 token_ids: List[int]
@@ -261,7 +276,68 @@ tokenizer.encode(...)
 ```
         '''
         self.kiwi.space_tolerance = self._space_tolerance
-        return super().encode(text, return_offsets)
+        return super().encode(text, return_offsets, ordered)
+
+    def encode_batch(self,
+        texts: Iterable[str],
+        max_length: Optional[int] = None,
+        padding: Union[bool, str] = 'longest',
+        truncation: bool = False,
+    ) -> EncodedBatch:
+        '''.. versionadded:: 0.21.0
+
+여러 텍스트를 한 번에 토큰화하여 패딩된 배열로 반환합니다.
+
+Parameters
+----------
+texts: Iterable[str]
+    토큰화할 텍스트의 iterable
+max_length: int
+    `truncation=True`이거나 `padding='max_length'`인 경우 사용할 최대 길이입니다.
+padding: Union[bool, str]
+    `True` 혹은 `'longest'`인 경우 가장 긴 결과의 길이에 맞춰 패딩합니다.
+    `'max_length'`인 경우 `max_length`에 맞춰 패딩합니다. 단, `truncation=False`이고 `max_length`보다 긴 결과가 있다면 그 길이에 맞춥니다.
+    결과가 하나의 배열로 반환되므로 패딩을 하지 않는 것은 불가능합니다.
+truncation: bool
+    True인 경우 `max_length`보다 긴 결과를 잘라냅니다.
+
+Returns
+-------
+encoded: EncodedBatch
+    `input_ids`, `attention_mask`, `offset_mapping`으로 구성된 `EncodedBatch`를 반환합니다.
+
+Notes
+-----
+토큰화와 배열 채우기는 모두 `kiwi`의 스레드 풀에서 병렬로 수행되며 텍스트별로 Python 객체를 생성하지 않습니다.
+반환되는 배열은 numpy 배열이므로 `torch.from_numpy`나 `torch.from_dlpack` 등으로 복사 없이 텐서로 변환할 수 있습니다.
+
+```python
+>>> tokenizer.encode_batch(["한국어에 특화된 토크나이저입니다.", "감사히 먹겠습니당!"], max_length=8, truncation=True)
+EncodedBatch(input_ids=array([[...]], dtype=int32), attention_mask=array([[...]], dtype=int32), offset_mapping=array([[[...]]], dtype=int32))
+```
+        '''
+        if padding is True or padding == 'longest':
+            pad_to_max_length = False
+        elif padding == 'max_length':
+            if max_length is None:
+                raise ValueError("`max_length` must be given when `padding='max_length'`.")
+            pad_to_max_length = True
+        else:
+            raise ValueError(f"`padding` must be one of True, 'longest' or 'max_length', but given {padding!r}.")
+        if truncation and max_length is None:
+            raise ValueError("`max_length` must be given when `truncation=True`.")
+        if max_length is not None and max_length < 0:
+            raise ValueError("`max_length` must be a non-negative integer.")
+
+        pad_token_id = self.pad_token_id
+        self.kiwi.space_tolerance = self._space_tolerance
+        return EncodedBatch(*super()._encode_batch(
+            texts, 
+            max_length or 0, 
+            pad_to_max_length, 
+            bool(truncation), 
+            pad_token_id if pad_token_id is not None else 0,
+        ))
     
     def encode_from_morphs(self, 
         morphs: Iterable[Union[Tuple[str, str, bool], Tuple[str, str]]],
@@ -293,6 +369,71 @@ token_ids_and_offsets: Tuple[List[int], List[Tuple[int, int]]]
         self.kiwi.space_tolerance = self._space_tolerance
         return super().encode_from_morphs(morphs, return_offsets)
 
+    def encode_from_morph_arrays(self,
+        arrays: Union[Tuple['np.ndarray', Optional['np.ndarray']], Tuple[str, 'np.ndarray', 'np.ndarray', Optional['np.ndarray']]],
+        return_offsets: bool = False,
+    ) -> Union['np.ndarray', Tuple['np.ndarray', 'np.ndarray']]:
+        '''.. versionadded:: 0.21.0
+
+배열로 주어진 형태소 열을 토큰화하여 token id의 배열로 변환합니다. `encode_from_morphs`와 동일하지만 형태소마다 Python 객체를 만들 필요가 없습니다.
+
+Parameters
+----------
+arrays: Union[Tuple[np.ndarray, Optional[np.ndarray]], Tuple[str, np.ndarray, np.ndarray, Optional[np.ndarray]]]
+    다음 두 형태 중 하나의 tuple입니다.
+    
+    * `(morph_ids, spaces)`: `morph_ids`는 형태소 id의 정수 배열입니다. 
+      형태소 id는 `tokenizer.kiwi`의 분석 결과(`Token.id` 혹은 `TokenArrays.id`)에서 얻은 것이어야 합니다.
+    * `(forms, form_offsets, tags, spaces)`: `forms`는 모든 형태를 이어붙인 문자열, `form_offsets`는 i번째 형태가 `forms[form_offsets[i]:form_offsets[i + 1]]`가 되는 
+      길이 `형태소 개수 + 1`의 정수 배열, `tags`는 품사 태그 값의 uint8 배열입니다. `TokenArrays`의 `form`, `form_offsets`, `tag`를 그대로 사용할 수 있습니다.
+      `form_offsets`가 uint32 배열이면 복사 없이 그대로 읽고, 그 외의 정수 배열은 int64로 변환하여 읽습니다.
+
+    `spaces`는 각 형태소의 왼쪽에 공백이 있는지를 나타내는 bool 배열이며, None일 경우 모두 False로 처리됩니다.
+return_offsets: bool
+    True일 경우 각 토큰들의 형태소 상의 시작지점 및 끝지점이 함께 반환됩니다.
+    
+Returns
+-------
+token_ids: np.ndarray
+    `return_offsets = False`인 경우.
+token_ids_and_offsets: Tuple[np.ndarray, np.ndarray]
+    `return_offsets = True`인 경우.
+
+Notes
+-----
+numpy 배열은 dtype이 맞는 경우 복사 없이 직접 읽힙니다. 
+
+```python
+>>> arrays, _ = tokenizer.kiwi.analyze("한국어에 특화된 토크나이저입니다.", output='arrays')[0]
+>>> tokenizer.encode_from_morph_arrays((arrays.id, None))
+```
+        '''
+        self.kiwi.space_tolerance = self._space_tolerance
+        return super()._encode_from_morph_arrays(arrays, return_offsets)
+
+    def encode_from_morph_arrays_batch(self,
+        batch: Iterable[Union[Tuple['np.ndarray', Optional['np.ndarray']], Tuple[str, 'np.ndarray', 'np.ndarray', Optional['np.ndarray']]]],
+        return_offsets: bool = False,
+    ) -> List[Union['np.ndarray', Tuple['np.ndarray', 'np.ndarray']]]:
+        '''.. versionadded:: 0.21.0
+
+`encode_from_morph_arrays`를 여러 입력에 대해 `kiwi`의 스레드 풀에서 병렬로 수행합니다.
+
+Parameters
+----------
+batch: Iterable[tuple]
+    `encode_from_morph_arrays`의 `arrays`와 같은 형태의 tuple들의 iterable
+return_offsets: bool
+    True일 경우 각 토큰들의 형태소 상의 시작지점 및 끝지점이 함께 반환됩니다.
+
+Returns
+-------
+results: List[Union[np.ndarray, Tuple[np.ndarray, np.ndarray]]]
+    각 입력에 대한 `encode_from_morph_arrays`의 결과를 입력 순서대로 담은 리스트
+        '''
+        self.kiwi.space_tolerance = self._space_tolerance
+        return super()._encode_from_morph_arrays_batch(batch, return_offsets)
+
     def tokenize_encode(self, 
         text: Union[str, Iterable[str]],
         return_offsets: bool = False,
@@ -363,6 +504,45 @@ Notes
 `encode`한 결과를 `decode`한다고 해서 항상 동일한 결과가 나오지는 않습니다.
         '''
         return super().decode(ids, ignore_errors)
+
+    def decode_batch(self,
+        ids: Union['np.ndarray', Iterable[Iterable[int]]],
+        pad_token_id: Optional[int] = None,
+        ignore_errors: bool = True,
+    ) -> List[str]:
+        '''.. versionadded:: 0.21.0
+
+여러 개의 token id 목록을 한 번에 텍스트로 변환합니다.
+
+Parameters
+----------
+ids: Union[np.ndarray, Iterable[Iterable[int]]]
+    `(텍스트 개수, 길이)` 크기의 2차원 정수 배열, 혹은 token id 배열이나 리스트의 iterable
+pad_token_id: int
+    변환 시 건너뛸 token id입니다. 패딩된 배열을 그대로 넘길 때 사용합니다.
+    생략 시 아무것도 건너뛰지 않습니다.
+ignore_errors: bool
+    token을 유니코드 텍스트로 복원할 때 발생하는 오류를 무시할지 설정합니다.
+    기본값은 True, 이 경우 오류가 난 부분은 대체문자로 대체됩니다.
+    
+Returns
+-------
+decoded: List[str]
+    다시 조합된 텍스트의 리스트
+
+Notes
+-----
+배열의 내용을 직접 읽어 `kiwi`의 스레드 풀에서 병렬로 변환합니다.
+`encode_batch`의 결과를 되돌리려면 `pad_token_id`에 `tokenizer.pad_token_id`를 지정하면 됩니다.
+어휘 집합의 범위를 벗어난 token id가 있으면 `ValueError`가 발생합니다.
+
+```python
+>>> enc = tokenizer.encode_batch(["한국어에 특화된 토크나이저입니다.", "감사히 먹겠습니당!"])
+>>> tokenizer.decode_batch(enc.input_ids, pad_token_id=tokenizer.pad_token_id)
+['한국어에 특화된 토크나이저입니다.', '감사히 먹겠습니당!']
+```
+        '''
+        return super()._decode_batch(ids, pad_token_id, ignore_errors)
     
     def save(self, path:str):
         '''
@@ -3,6 +3,20 @@
 #include <stdexcept>
 #include <fstream>
 #include <algorithm>
+#include <array>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <string_view>
+#include <regex>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 
 #define USE_NUMPY
 #define MAIN_MODULE
@@ -27,11 +41,45 @@ vector<pair<u16string, size_t>> pyExtractSubstrings(const u16string& str, size_t
 	return extractSubstrings(str.data(), str.data() + str.size(), minCnt, minLength, maxLength, longestOnly, stopChr.empty() ? 0 : stopChr[0]);
 }
 
+py::UniqueObj pyTagNames()
+{
+	py::UniqueObj ret{ PyList_New(256) };
+	for (size_t i = 0; i < 256; ++i)
+	{
+		const auto tag = (POSTag)i;
+		auto name = clearIrregular(tag) < POSTag::max ? py::buildPyValue(tagToString(tag)) : py::buildPyValue(nullptr);
+		PyList_SET_ITEM(ret.get(), i, name.release());
+	}
+	return ret;
+}
+
+/**
+ * @brief Measures the average time in seconds taken to convert `text` into `u16string` for the analysis entry points.
+ * Used by benchmark/throughput/u16_conversion.py.
+ */
+double pyU16ConversionTime(PyObject* text, size_t repeat)
+{
+	if (!PyUnicode_Check(text)) throw py::ValueError{ "`text` must be an instance of `str`." };
+	repeat = std::max<size_t>(repeat, 1);
+	// storing each result into a volatile sink keeps the conversion from being optimized away
+	volatile size_t sink = 0;
+	const auto start = chrono::steady_clock::now();
+	for (size_t i = 0; i < repeat; ++i)
+	{
+		auto str = py::toCpp<u16string>(text);
+		sink = str.size();
+	}
+	const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count() / repeat;
+}
+
 static py::Module gModule{ "_kiwipiepy", "Kiwi API for Python", [](PyModuleDef& def)
 {
 	static PyMethodDef methods[] =
 	{
 		{ "_extract_substrings", PY_METHOD(&pyExtractSubstrings), METH_VARARGS | METH_KEYWORDS, "" },
+		{ "_tag_names", PY_METHOD(&pyTagNames), METH_VARARGS | METH_KEYWORDS, "" },
+		{ "_u16_conversion_time", PY_METHOD(&pyU16ConversionTime), METH_VARARGS | METH_KEYWORDS, "" },
 		{ nullptr }
 	};
 	def.m_methods = methods;
@@ -202,12 +250,66 @@ struct HSDatasetObject : py::CObject<HSDatasetObject>
 
 	HSDataset hsd;
 
+	/**
+	 * @brief Serializes the calls of `hsd.next` made by iterators, which may run on their producer threads.
+	 * `epoch` counts the iterators created, so that a prefetching iterator stops once a newer one has reset the dataset.
+	 */
+	struct IterState
+	{
+		std::mutex mutex;
+		size_t epoch = 0;
+		// batches handed out by the current iterator, and the number every iteration is truncated or cycled to (0 if not fixed)
+		size_t produced = 0, numBatches = 0;
+
+		/**
+		 * @brief Calls `hsd.next` with the mutex held. With `numBatches` set, stops after that many batches
+		 * and starts over from the beginning of `hsd` if it runs out before.
+		 */
+		template<class... Args>
+		size_t next(HSDataset& hsd, Args&... args)
+		{
+			if (numBatches && produced >= numBatches) return 0;
+			size_t sz = hsd.next(args...);
+			if (!sz && numBatches && produced)
+			{
+				hsd.reset();
+				sz = hsd.next(args...);
+			}
+			if (sz) ++produced;
+			return sz;
+		}
+	};
+	std::shared_ptr<IterState> iterState = std::make_shared<IterState>();
+	size_t numBatches = 0;
+
+	// the seed given to `make_hsdataset` and the index of the shard this dataset reads
+	size_t baseSeed = 0, shardIndex = 0;
+
+	/**
+	 * @brief Mixes the epoch and the shard index into the seed,
+	 * so that every rank reshuffles its shard in a way that depends only on (seed, epoch, shard).
+	 * Epoch 0 of shard 0 keeps the seed as given.
+	 */
+	static size_t mixSeed(size_t seed, size_t epoch, size_t shard)
+	{
+		return seed + epoch * (size_t)0x9E3779B97F4A7C15ull + shard * (size_t)0xC2B2AE3D27D4EB4Full;
+	}
+
+	void setEpoch(size_t epoch)
+	{
+		py::ReleaseGIL gil;
+		std::lock_guard<std::mutex> lock{ iterState->mutex };
+		hsd.seed(mixSeed(baseSeed, epoch, shardIndex));
+	}
+
 	py::UniqueCObj<HSDatasetIterObject> iter() const
 	{
 		py::UniqueCObj<HSDatasetIterObject> ret{ (HSDatasetIterObject*)PyObject_CallFunctionObjArgs((PyObject*)py::Type<HSDatasetIterObject>, this, nullptr) };
 		return ret;
 	}
 
+	py::UniqueCObj<HSDatasetIterObject> prefetch(size_t numBuffers) const;
+
 	size_t getVocabSize() const
 	{
 		return hsd.vocabSize();
@@ -245,7 +347,15 @@ struct HSDatasetObject : py::CObject<HSDatasetObject>
 
 	Py_ssize_t len() const
 	{
-		return hsd.numEstimBatches();
+		return numBatches ? numBatches : hsd.numEstimBatches();
+	}
+
+	void setNumBatches(size_t n)
+	{
+		numBatches = n;
+		py::ReleaseGIL gil;
+		std::lock_guard<std::mutex> lock{ iterState->mutex };
+		iterState->numBatches = n;
 	}
 
 	std::vector<size_t> estimVocabFrequency() const
@@ -288,6 +398,9 @@ py::TypeWrapper<HSDatasetObject> _HSDatasetSetter{ gModule, [](PyTypeObject& obj
 		{ "get_sent", PY_METHOD(&HSDatasetObject::getSent), METH_VARARGS | METH_KEYWORDS, ""},
 		{ "estim_vocab_frequency", PY_METHOD(&HSDatasetObject::estimVocabFrequency), METH_VARARGS | METH_KEYWORDS, ""},
 		{ "extract_prefixes", PY_METHOD(&HSDatasetObject::extractPrefixes), METH_VARARGS | METH_KEYWORDS, ""},
+		{ "_prefetch", PY_METHOD(&HSDatasetObject::prefetch), METH_VARARGS | METH_KEYWORDS, ""},
+		{ "_set_epoch", PY_METHOD(&HSDatasetObject::setEpoch), METH_VARARGS | METH_KEYWORDS, ""},
+		{ "_set_num_batches", PY_METHOD(&HSDatasetObject::setNumBatches), METH_VARARGS | METH_KEYWORDS, ""},
 		{ nullptr }
 	};
 	static PyGetSetDef getsets[] =
@@ -313,6 +426,22 @@ py::TypeWrapper<HSDatasetObject> _HSDatasetSetter{ gModule, [](PyTypeObject& obj
 	obj.tp_as_sequence = &seq;
 } };
 
+/**
+ * @brief Makes a view of the first `rows` rows of `storage`, which keeps `base` alive instead of `storage`.
+ */
+inline py::UniqueObj viewRows(PyObject* storage, size_t rows, PyObject* base)
+{
+	auto* arr = (PyArrayObject*)storage;
+	npy_intp dims[2] = { (npy_intp)rows, PyArray_NDIM(arr) > 1 ? PyArray_DIM(arr, 1) : 0 };
+	auto* descr = PyArray_DESCR(arr);
+	Py_INCREF(descr);
+	py::UniqueObj ret{ PyArray_NewFromDescr(&PyArray_Type, descr, PyArray_NDIM(arr), dims, PyArray_STRIDES(arr), PyArray_DATA(arr), NPY_ARRAY_CARRAY, nullptr) };
+	if (!ret) throw py::ExcPropagation{};
+	Py_INCREF(base);
+	if (PyArray_SetBaseObject((PyArrayObject*)ret.get(), base) < 0) throw py::ExcPropagation{};
+	return ret;
+}
+
 struct HSDatasetIterObject : py::CObject<HSDatasetIterObject>
 {
 	static constexpr const char* _name = "kiwipiepy._HSDatasetIter";
@@ -320,44 +449,194 @@ struct HSDatasetIterObject : py::CObject<HSDatasetIterObject>
 	static constexpr int _flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE;
 
 	py::UniqueCObj<HSDatasetObject> obj;
+	size_t epoch = 0;
+
+	/**
+	 * @brief A batch of a prefetching iterator with its preallocated arrays, which are reused once the batch handed out from them is released.
+	 */
+	struct PrefetchSlot
+	{
+		py::UniqueObj inData, outData, lmLProbsData, outNgramNodeData;
+		size_t size = 0;
+		float restLm = 0;
+		uint32_t restLmCnt = 0;
+		std::future<void> filled;
+		std::shared_ptr<std::atomic<bool>> leased = std::make_shared<std::atomic<bool>>(false);
+	};
+
+	/**
+	 * @brief The base object of every array handed out from a slot, kept in a capsule.
+	 * 
+	 * It is destroyed only when the last array, view or exported buffer (DLPack, buffer protocol) derived from the batch is,
+	 * since every one of them keeps its base alive. The slot is not refilled before that. It also keeps the arrays of the slot alive,
+	 * so a batch outlives its iterator.
+	 */
+	struct BatchLease
+	{
+		static constexpr const char* capsuleName = "kiwipiepy._HSBatchLease";
+
+		std::shared_ptr<std::atomic<bool>> leased;
+		py::UniqueObj storages[4];
+
+		BatchLease(const PrefetchSlot& slot)
+			: leased{ slot.leased }
+		{
+			PyObject* arrays[] = { slot.inData.get(), slot.outData.get(), slot.lmLProbsData.get(), slot.outNgramNodeData.get() };
+			for (size_t i = 0; i < 4; ++i)
+			{
+				Py_INCREF(arrays[i]);
+				storages[i] = py::UniqueObj{ arrays[i] };
+			}
+			leased->store(true);
+		}
+
+		~BatchLease()
+		{
+			leased->store(false);
+		}
+
+		static void destroy(PyObject* capsule)
+		{
+			delete (BatchLease*)PyCapsule_GetPointer(capsule, capsuleName);
+		}
+
+		static py::UniqueObj make(const PrefetchSlot& slot)
+		{
+			auto* lease = new BatchLease{ slot };
+			py::UniqueObj ret{ PyCapsule_New(lease, capsuleName, &BatchLease::destroy) };
+			if (!ret)
+			{
+				delete lease;
+				throw py::ExcPropagation{};
+			}
+			return ret;
+		}
+	};
+
+	// empty for a plain iterator. Slots are filled one by one by `producer` in the order of `pending`.
+	std::unique_ptr<utils::ThreadPool> producer;
+	std::deque<PrefetchSlot> slots;
+	std::deque<size_t> pending;
+	vector<size_t> handedOut;
+	bool exhausted = false;
 
 	using _InitArgs = std::tuple<py::UniqueCObj<HSDatasetObject>>;
 
 	HSDatasetIterObject() = default;
+	HSDatasetIterObject(HSDatasetIterObject&&) = default;
+	HSDatasetIterObject& operator=(HSDatasetIterObject&& o)
+	{
+		waitProducer();
+		obj = std::move(o.obj);
+		epoch = o.epoch;
+		producer = std::move(o.producer);
+		slots = std::move(o.slots);
+		pending = std::move(o.pending);
+		handedOut = std::move(o.handedOut);
+		exhausted = o.exhausted;
+		return *this;
+	}
 
 	HSDatasetIterObject(py::UniqueCObj<HSDatasetObject>&& dataset)
 	{
 		obj = std::move(dataset);
+		auto& state = *obj->iterState;
+		py::ReleaseGIL gil;
+		std::lock_guard<std::mutex> lock{ state.mutex };
+		epoch = ++state.epoch;
+		state.produced = 0;
 		obj->hsd.reset();
 	}
 
+	~HSDatasetIterObject()
+	{
+		waitProducer();
+	}
+
+	// the slots must outlive the fills writing into them
+	void waitProducer()
+	{
+		if (pending.empty()) return;
+		py::ReleaseGIL gil;
+		for (auto i : pending)
+		{
+			if (slots[i].filled.valid()) slots[i].filled.wait();
+		}
+		pending.clear();
+	}
+
 	py::UniqueCObj<HSDatasetIterObject> iter() const
 	{
 		Py_INCREF(this);
 		return py::UniqueCObj<HSDatasetIterObject>(const_cast<HSDatasetIterObject*>(this));
 	}
 
-	py::UniqueObj iternext()
+	std::array<npy_intp, 2> batchShape() const
 	{
 		const size_t batchSize = obj->hsd.getBatchSize();
 		const size_t causalContextSize = obj->hsd.getCausalContextSize();
 		const size_t windowSize = obj->hsd.getWindowSize();
-		npy_intp sizes[2] = { (npy_intp)batchSize * 4, (npy_intp)(causalContextSize + windowSize) };
-		py::UniqueObj inData{ PyArray_EMPTY(2, sizes, NPY_INT64, 0) };
-		py::UniqueObj outData{ PyArray_EMPTY(1, sizes, NPY_INT64, 0) };
-		py::UniqueObj lmLProbsData{ PyArray_EMPTY(1, sizes, NPY_FLOAT32, 0) };
-		py::UniqueObj outNgramNodeData{ PyArray_EMPTY(1, sizes, NPY_INT64, 0) };
+		return { (npy_intp)batchSize * 4, (npy_intp)(causalContextSize + windowSize) };
+	}
+
+	void startPrefetch(size_t numBuffers)
+	{
+		producer = std::make_unique<utils::ThreadPool>(1);
+		for (size_t i = 0; i < std::max(numBuffers, (size_t)1); ++i) submit(newSlot());
+	}
+
+	size_t newSlot()
+	{
+		auto sizes = batchShape();
+		PrefetchSlot slot;
+		slot.inData = py::UniqueObj{ PyArray_EMPTY(2, sizes.data(), NPY_INT64, 0) };
+		slot.outData = py::UniqueObj{ PyArray_EMPTY(1, sizes.data(), NPY_INT64, 0) };
+		slot.lmLProbsData = py::UniqueObj{ PyArray_EMPTY(1, sizes.data(), NPY_FLOAT32, 0) };
+		slot.outNgramNodeData = py::UniqueObj{ PyArray_EMPTY(1, sizes.data(), NPY_INT64, 0) };
+		if (!slot.inData || !slot.outData || !slot.lmLProbsData || !slot.outNgramNodeData) throw py::ExcPropagation{};
+		slots.emplace_back(std::move(slot));
+		return slots.size() - 1;
+	}
+
+	void submit(size_t idx)
+	{
+		auto& slot = slots[idx];
+		slot.filled = producer->enqueue([&slot, &hsd = obj->hsd, state = obj->iterState, epoch = epoch,
+			in = (int64_t*)PyArray_DATA((PyArrayObject*)slot.inData.get()),
+			out = (int64_t*)PyArray_DATA((PyArrayObject*)slot.outData.get()),
+			lmLProbs = (float*)PyArray_DATA((PyArrayObject*)slot.lmLProbsData.get()),
+			ngramNodes = (int64_t*)PyArray_DATA((PyArrayObject*)slot.outNgramNodeData.get())](size_t)
+		{
+			std::lock_guard<std::mutex> lock{ state->mutex };
+			slot.restLm = 0;
+			slot.restLmCnt = 0;
+			slot.size = state->epoch == epoch ? state->next(hsd, in, out, lmLProbs, ngramNodes, slot.restLm, slot.restLmCnt) : 0;
+		});
+		pending.emplace_back(idx);
+	}
+
+	py::UniqueObj iternext()
+	{
+		if (producer) return prefetchedNext();
+
+		auto sizes = batchShape();
+		py::UniqueObj inData{ PyArray_EMPTY(2, sizes.data(), NPY_INT64, 0) };
+		py::UniqueObj outData{ PyArray_EMPTY(1, sizes.data(), NPY_INT64, 0) };
+		py::UniqueObj lmLProbsData{ PyArray_EMPTY(1, sizes.data(), NPY_FLOAT32, 0) };
+		py::UniqueObj outNgramNodeData{ PyArray_EMPTY(1, sizes.data(), NPY_INT64, 0) };
 		float restLm = 0;
 		uint32_t restLmCnt = 0;
 
-		const size_t sz = obj->hsd.next(
-			(int64_t*)PyArray_DATA((PyArrayObject*)inData.get()),
-			(int64_t*)PyArray_DATA((PyArrayObject*)outData.get()),
-			(float*)PyArray_DATA((PyArrayObject*)lmLProbsData.get()),
-			(int64_t*)PyArray_DATA((PyArrayObject*)outNgramNodeData.get()),
-			restLm,
-			restLmCnt
-		);
+		size_t sz;
+		{
+			py::ReleaseGIL gil;
+			auto* in = (int64_t*)PyArray_DATA((PyArrayObject*)inData.get());
+			auto* out = (int64_t*)PyArray_DATA((PyArrayObject*)outData.get());
+			auto* lmLProbs = (float*)PyArray_DATA((PyArrayObject*)lmLProbsData.get());
+			auto* ngramNodes = (int64_t*)PyArray_DATA((PyArrayObject*)outNgramNodeData.get());
+			std::lock_guard<std::mutex> lock{ obj->iterState->mutex };
+			sz = obj->iterState->next(obj->hsd, in, out, lmLProbs, ngramNodes, restLm, restLmCnt);
+		}
 		if (!sz) throw py::ExcPropagation{};
 
 		//if (sz < batchSize)
@@ -370,12 +649,164 @@ struct HSDatasetIterObject : py::CObject<HSDatasetIterObject>
 		}
 		return py::buildPyTuple(inData, outData, lmLProbsData, outNgramNodeData, restLm, restLmCnt);
 	}
+
+	/**
+	 * @brief Hands out the oldest pending batch after queueing the refill of every slot whose batch has been released.
+	 * 
+	 * The batch is returned as views of the arrays of its slot sharing a `BatchLease`, so no batch data is allocated or copied.
+	 */
+	py::UniqueObj prefetchedNext()
+	{
+		if (exhausted) throw py::ExcPropagation{};
+		for (size_t i = 0; i < handedOut.size();)
+		{
+			if (slots[handedOut[i]].leased->load())
+			{
+				++i;
+				continue;
+			}
+			submit(handedOut[i]);
+			handedOut[i] = handedOut.back();
+			handedOut.pop_back();
+		}
+		// every slot is still held by the caller
+		if (pending.empty()) submit(newSlot());
+
+		const size_t idx = pending.front();
+		pending.pop_front();
+		auto& slot = slots[idx];
+		bool reset;
+		{
+			py::ReleaseGIL gil;
+			slot.filled.wait();
+			// batches filled before a newer iterator reset the dataset belong to the old epoch
+			std::lock_guard<std::mutex> lock{ obj->iterState->mutex };
+			reset = obj->iterState->epoch != epoch;
+		}
+		handedOut.emplace_back(idx);
+		slot.filled.get();
+		if (!slot.size || reset)
+		{
+			exhausted = true;
+			waitProducer();
+			throw py::ExcPropagation{};
+		}
+
+		auto lease = BatchLease::make(slot);
+		return py::buildPyTuple(viewRows(slot.inData.get(), slot.size, lease.get()), viewRows(slot.outData.get(), slot.size, lease.get()), 
+			viewRows(slot.lmLProbsData.get(), slot.size, lease.get()), viewRows(slot.outNgramNodeData.get(), slot.size, lease.get()), 
+			slot.restLm, slot.restLmCnt);
+	}
 };
 
+py::UniqueCObj<HSDatasetIterObject> HSDatasetObject::prefetch(size_t numBuffers) const
+{
+	auto ret = iter();
+	if (!ret) throw py::ExcPropagation{};
+	ret->startPrefetch(numBuffers);
+	return ret;
+}
+
 py::TypeWrapper<HSDatasetIterObject> _HSDatasetIterSetter{ gModule, [](PyTypeObject& obj)
 {
 } };
 
+/**
+ * @brief Enqueues `fn(i)` for every `i` in `[0, n)` on `pool`, split into contiguous blocks, and returns the futures of the blocks.
+ * Each block holds its own copy of `fn`, so the state `fn` refers to must outlive the futures.
+ */
+template<class Fn>
+vector<std::future<void>> enqueueBlocks(utils::ThreadPool& pool, size_t n, const Fn& fn)
+{
+	static constexpr size_t maxBlocks = 256;
+	const size_t numBlocks = std::min(n, maxBlocks);
+	vector<std::future<void>> futures;
+	futures.reserve(numBlocks);
+	for (size_t b = 0; b < numBlocks; ++b)
+	{
+		futures.emplace_back(pool.enqueue([fn, n, b, numBlocks](size_t)
+		{
+			for (size_t i = n * b / numBlocks, e = n * (b + 1) / numBlocks; i < e; ++i) fn(i);
+		}));
+	}
+	return futures;
+}
+
+/**
+ * @brief Waits for every future, rethrowing the first exception among them.
+ */
+inline void waitAll(vector<std::future<void>>& futures)
+{
+	// every block must finish before the state it refers to goes away, even if one of them has failed
+	std::exception_ptr error;
+	for (auto& f : futures)
+	{
+		try
+		{
+			if (f.valid()) f.get();
+		}
+		catch (...)
+		{
+			if (!error) error = std::current_exception();
+		}
+	}
+	futures.clear();
+	if (error) std::rethrow_exception(error);
+}
+
+/**
+ * @brief `waitAll` for a caller holding the GIL, which is released while the futures are not ready yet.
+ */
+inline void waitAllReleasingGIL(vector<std::future<void>>& futures)
+{
+	if (futures.empty()) return;
+	{
+		py::ReleaseGIL gil;
+		for (auto& f : futures) if (f.valid()) f.wait();
+	}
+	waitAll(futures);
+}
+
+/**
+ * @brief Enqueues `fn(threadId)` on `pool` and notifies `signal` once its result, or its exception, is ready.
+ */
+template<class Ty, class Fn>
+std::future<Ty> enqueueSignalled(utils::ThreadPool& pool, std::shared_ptr<py::CompletionSignal> signal, Fn&& fn)
+{
+	auto promise = std::make_shared<std::promise<Ty>>();
+	auto ret = promise->get_future();
+	pool.enqueue([promise, signal = move(signal), fn = std::forward<Fn>(fn)](size_t threadId)
+	{
+		try
+		{
+			promise->set_value(fn(threadId));
+		}
+		catch (...)
+		{
+			promise->set_exception(std::current_exception());
+		}
+		signal->notify();
+	});
+	return ret;
+}
+
+/**
+ * @brief Calls `fn(i)` for every `i` in `[0, n)`, split into contiguous blocks over `pool`, or serially if there is no pool.
+ * Returns after every block has finished, rethrowing the first exception thrown by `fn`.
+ */
+template<class Fn>
+void forEachOnPool(utils::ThreadPool* pool, size_t n, Fn&& fn)
+{
+	if (!pool || n <= 1)
+	{
+		for (size_t i = 0; i < n; ++i) fn(i);
+		return;
+	}
+
+	auto futures = enqueueBlocks(*pool, n, [&](size_t i) { fn(i); });
+	waitAll(futures);
+}
+
 struct KNLangModelObject;
 
 struct KNLangModelNextTokensResultObject : py::CObject<KNLangModelNextTokensResultObject>
@@ -386,10 +817,22 @@ struct KNLangModelNextTokensResultObject : py::CObject<KNLangModelNextTokensResu
 
 	using _InitArgs = std::tuple<>;
 
-	py::UniqueObj inArray, outIdx, outLl;
+	py::UniqueObj inArray, inSpans, outIdx, outLl;
 	py::UniqueCObj<KNLangModelObject> parent;
 
-	mutable std::future<void> future;
+	// the blocks writing into the outputs, which are waited for before the outputs are read
+	mutable vector<std::future<void>> futures;
+
+	KNLangModelNextTokensResultObject() = default;
+	KNLangModelNextTokensResultObject(KNLangModelNextTokensResultObject&&) = default;
+	KNLangModelNextTokensResultObject& operator=(KNLangModelNextTokensResultObject&&) = default;
+
+	~KNLangModelNextTokensResultObject()
+	{
+		if (futures.empty()) return;
+		py::ReleaseGIL gil;
+		for (auto& f : futures) if (f.valid()) f.wait();
+	}
 
 	size_t len() const
 	{
@@ -398,10 +841,7 @@ struct KNLangModelNextTokensResultObject : py::CObject<KNLangModelNextTokensResu
 
 	py::UniqueObj getitem(Py_ssize_t idx) const
 	{
-		if (future.valid())
-		{
-			future.get();
-		}
+		waitAllReleasingGIL(futures);
 
 		if (idx < 0) idx += len();
 		switch(idx)
@@ -436,10 +876,21 @@ struct KNLangModelEvaluateResultObject : py::CObject<KNLangModelEvaluateResultOb
 
 	using _InitArgs = std::tuple<>;
 
-	py::UniqueObj inArray, outLl;
+	py::UniqueObj inArray, inSpans, outLl;
 	py::UniqueCObj<KNLangModelObject> parent;
 
-	mutable std::future<void> future;
+	mutable vector<std::future<void>> futures;
+
+	KNLangModelEvaluateResultObject() = default;
+	KNLangModelEvaluateResultObject(KNLangModelEvaluateResultObject&&) = default;
+	KNLangModelEvaluateResultObject& operator=(KNLangModelEvaluateResultObject&&) = default;
+
+	~KNLangModelEvaluateResultObject()
+	{
+		if (futures.empty()) return;
+		py::ReleaseGIL gil;
+		for (auto& f : futures) if (f.valid()) f.wait();
+	}
 
 	size_t len() const
 	{
@@ -448,10 +899,7 @@ struct KNLangModelEvaluateResultObject : py::CObject<KNLangModelEvaluateResultOb
 
 	py::UniqueObj getitem(py::UniqueObj arg) const
 	{
-		if (future.valid())
-		{
-			future.get();
-		}
+		waitAllReleasingGIL(futures);
 		return py::UniqueObj{ PyObject_GetItem(outLl.get(), arg.get()) };
 	}
 
@@ -469,10 +917,7 @@ struct KNLangModelEvaluateResultObject : py::CObject<KNLangModelEvaluateResultOb
 		if (ret) return ret;
 		PyErr_Clear();
 
-		if (future.valid())
-		{
-			future.get();
-		}
+		waitAllReleasingGIL(futures);
 		return py::UniqueObj{ PyObject_GetAttr(outLl.get(), arg.get()) };
 	}
 
@@ -655,27 +1100,27 @@ struct KNLangModelObject : py::CObject<KNLangModelObject>
 			ret->parent = py::UniqueCObj<KNLangModelObject>{ (KNLangModelObject*)this };
 			if (dtype == NPY_UINT16 || dtype == NPY_INT16)
 			{
-				ret->future = workers->enqueue([=](size_t threadIdx)
+				ret->futures.emplace_back(workers->enqueue([=](size_t threadIdx)
 				{
 					auto* ptr = (const uint16_t*)inData;
 					langModel->predictTopN(ptr, ptr + len, topN, idxData, llData);
-				});
+				}));
 			}
 			else if (dtype == NPY_UINT32 || dtype == NPY_INT32)
 			{
-				ret->future = workers->enqueue([=](size_t threadIdx)
+				ret->futures.emplace_back(workers->enqueue([=](size_t threadIdx)
 				{
 					auto* ptr = (const uint32_t*)inData;
 					langModel->predictTopN(ptr, ptr + len, topN, idxData, llData);
-				});
+				}));
 			}
 			else if (dtype == NPY_UINT64 || dtype == NPY_INT64)
 			{
-				ret->future = workers->enqueue([=](size_t threadIdx)
+				ret->futures.emplace_back(workers->enqueue([=](size_t threadIdx)
 				{
 					auto* ptr = (const uint64_t*)inData;
 					langModel->predictTopN(ptr, ptr + len, topN, idxData, llData);
-				});
+				}));
 			}
 			else
 			{
@@ -745,27 +1190,27 @@ struct KNLangModelObject : py::CObject<KNLangModelObject>
 			ret->parent = py::UniqueCObj<KNLangModelObject>{ (KNLangModelObject*)this };
 			if (dtype == NPY_UINT16 || dtype == NPY_INT16)
 			{
-				ret->future = workers->enqueue([=](size_t threadIdx)
+				ret->futures.emplace_back(workers->enqueue([=](size_t threadIdx)
 				{
 					auto* ptr = (const uint16_t*)inData;
 					evaluateWithCluster(ptr, len, llData);
-				});
+				}));
 			}
 			else if (dtype == NPY_UINT32 || dtype == NPY_INT32)
 			{
-				ret->future = workers->enqueue([=](size_t threadIdx)
+				ret->futures.emplace_back(workers->enqueue([=](size_t threadIdx)
 				{
 					auto* ptr = (const uint32_t*)inData;
 					evaluateWithCluster(ptr, len, llData);
-				});
+				}));
 			}
 			else if (dtype == NPY_UINT64 || dtype == NPY_INT64)
 			{
-				ret->future = workers->enqueue([=](size_t threadIdx)
+				ret->futures.emplace_back(workers->enqueue([=](size_t threadIdx)
 				{
 					auto* ptr = (const uint64_t*)inData;
 					evaluateWithCluster(ptr, len, llData);
-				});
+				}));
 			}
 			else
 			{
@@ -797,6 +1242,185 @@ struct KNLangModelObject : py::CObject<KNLangModelObject>
 			return outLl;
 		}
 	}
+
+	/**
+	 * @brief Sequences of a batch, given either as a 2D padded array with optional lengths or as a flat array with offsets.
+	 * The i-th sequence starts at `begins[i]` of `data`, and its outputs start at the same position of the outputs.
+	 * It holds no Python object, so that it can be shared with the workers.
+	 */
+	struct BatchInput
+	{
+		const void* data = nullptr;
+		int dtype = 0;
+		vector<npy_intp> shape;
+		vector<size_t> begins, lengths;
+		// whether some positions are not covered by any sequence
+		bool padded = false;
+	};
+
+	template<class Fn>
+	static void visitTokens(int dtype, const void* data, Fn&& fn)
+	{
+		if (dtype == NPY_UINT16 || dtype == NPY_INT16) fn((const uint16_t*)data);
+		else if (dtype == NPY_UINT32 || dtype == NPY_INT32) fn((const uint32_t*)data);
+		else fn((const uint64_t*)data);
+	}
+
+	static BatchInput readBatch(PyObject* obj, PyObject* lengths, PyObject* offsets, py::UniqueObj& array, py::UniqueObj& spans)
+	{
+		if (!PyArray_Check(obj)) throw py::ValueError{ "obj must be a numpy array." };
+		array = py::UniqueObj{ (PyObject*)PyArray_GETCONTIGUOUS((PyArrayObject*)obj) };
+		if (!array) throw py::ExcPropagation{};
+		auto* arr = (PyArrayObject*)array.get();
+
+		BatchInput ret;
+		ret.dtype = PyArray_TYPE(arr);
+		if (!(ret.dtype == NPY_UINT16 || ret.dtype == NPY_INT16 || ret.dtype == NPY_UINT32 || ret.dtype == NPY_INT32 
+			|| ret.dtype == NPY_UINT64 || ret.dtype == NPY_INT64))
+		{
+			throw py::ValueError{ "obj must be a numpy array of uint16, uint32 or uint64." };
+		}
+		ret.data = PyArray_DATA(arr);
+		const size_t dims = PyArray_NDIM(arr);
+
+		const bool hasLengths = lengths && lengths != Py_None, hasOffsets = offsets && offsets != Py_None;
+		if (hasLengths && hasOffsets) throw py::ValueError{ "`lengths` and `offsets` cannot be given together." };
+		if (hasOffsets)
+		{
+			if (dims != 1) throw py::ValueError{ "obj must be a 1D numpy array when `offsets` is given." };
+			const size_t size = PyArray_DIM(arr, 0);
+			spans = py::UniqueObj{ PyArray_FROMANY(offsets, NPY_INT64, 1, 1, NPY_ARRAY_CARRAY_RO) };
+			if (!spans) throw py::ExcPropagation{};
+			const size_t n = PyArray_DIM((PyArrayObject*)spans.get(), 0);
+			if (n == 0) throw py::ValueError{ "`offsets` must have at least one element." };
+			auto* off = (const int64_t*)PyArray_DATA((PyArrayObject*)spans.get());
+			if (off[0] < 0 || (size_t)off[n - 1] > size) throw py::ValueError{ "`offsets` must be in [0, len(obj)]." };
+			for (size_t i = 0; i + 1 < n; ++i)
+			{
+				if (off[i] > off[i + 1]) throw py::ValueError{ "`offsets` must be non-decreasing." };
+				ret.begins.emplace_back(off[i]);
+				ret.lengths.emplace_back(off[i + 1] - off[i]);
+			}
+			ret.shape = { (npy_intp)size };
+			ret.padded = off[0] != 0 || (size_t)off[n - 1] != size;
+		}
+		else
+		{
+			if (dims != 2) throw py::ValueError{ "obj must be a 2D numpy array, or a 1D one with `offsets`." };
+			const size_t rows = PyArray_DIM(arr, 0), cols = PyArray_DIM(arr, 1);
+			const int64_t* len = nullptr;
+			if (hasLengths)
+			{
+				spans = py::UniqueObj{ PyArray_FROMANY(lengths, NPY_INT64, 1, 1, NPY_ARRAY_CARRAY_RO) };
+				if (!spans) throw py::ExcPropagation{};
+				if ((size_t)PyArray_DIM((PyArrayObject*)spans.get(), 0) != rows) throw py::ValueError{ "`lengths` must have as many elements as the rows of obj." };
+				len = (const int64_t*)PyArray_DATA((PyArrayObject*)spans.get());
+			}
+			for (size_t i = 0; i < rows; ++i)
+			{
+				if (len && (len[i] < 0 || (size_t)len[i] > cols)) throw py::ValueError{ "`lengths` must be in [0, obj.shape[1]]." };
+				ret.begins.emplace_back(i * cols);
+				ret.lengths.emplace_back(len ? len[i] : cols);
+				ret.padded = ret.padded || ret.lengths.back() != cols;
+			}
+			ret.shape = { (npy_intp)rows, (npy_intp)cols };
+		}
+		return ret;
+	}
+
+	static py::UniqueObj newOutput(const BatchInput& input, vector<npy_intp> shape, int dtype)
+	{
+		py::UniqueObj ret{ input.padded ? PyArray_ZEROS(shape.size(), shape.data(), dtype, 0) : PyArray_EMPTY(shape.size(), shape.data(), dtype, 0) };
+		if (!ret) throw py::ExcPropagation{};
+		return ret;
+	}
+
+	py::UniqueObj nextTokensBatch(PyObject* obj, PyObject* lengths, PyObject* offsets, size_t topN, bool deferred) const
+	{
+		if (deferred && !workers)
+		{
+			throw py::ValueError{ "numWorkers must be greater than 0 when `deferred=True`." };
+		}
+		py::UniqueObj array, spans;
+		auto input = std::make_shared<const BatchInput>(readBatch(obj, lengths, offsets, array, spans));
+		auto shape = input->shape;
+		shape.emplace_back(topN);
+		auto outIdx = newOutput(*input, shape, NPY_UINT32);
+		auto outLl = newOutput(*input, shape, NPY_FLOAT32);
+		auto* idxData = (uint32_t*)PyArray_DATA((PyArrayObject*)outIdx.get());
+		auto* llData = (float*)PyArray_DATA((PyArrayObject*)outLl.get());
+
+		auto predict = [this, input, topN, idxData, llData](size_t i)
+		{
+			const size_t b = input->begins[i], len = input->lengths[i];
+			visitTokens(input->dtype, input->data, [&](auto* ptr)
+			{
+				langModel->predictTopN(ptr + b, ptr + b + len, topN, idxData + b * topN, llData + b * topN);
+			});
+		};
+
+		if (deferred)
+		{
+			auto ret = py::makeNewObject<KNLangModelNextTokensResultObject>();
+			ret->inArray = move(array);
+			ret->inSpans = move(spans);
+			ret->outIdx = move(outIdx);
+			ret->outLl = move(outLl);
+			Py_INCREF(this);
+			ret->parent = py::UniqueCObj<KNLangModelObject>{ (KNLangModelObject*)this };
+			ret->futures = enqueueBlocks(*workers, input->begins.size(), predict);
+			return ret;
+		}
+		else
+		{
+			{
+				py::ReleaseGIL gil;
+				forEachOnPool(workers.get(), input->begins.size(), predict);
+			}
+			return py::buildPyTuple(move(outIdx), move(outLl));
+		}
+	}
+
+	py::UniqueObj evaluateBatch(PyObject* obj, PyObject* lengths, PyObject* offsets, bool deferred) const
+	{
+		if (deferred && !workers)
+		{
+			throw py::ValueError{ "numWorkers must be greater than 0 when `deferred=True`." };
+		}
+		py::UniqueObj array, spans;
+		auto input = std::make_shared<const BatchInput>(readBatch(obj, lengths, offsets, array, spans));
+		auto outLl = newOutput(*input, input->shape, NPY_FLOAT32);
+		auto* llData = (float*)PyArray_DATA((PyArrayObject*)outLl.get());
+
+		auto score = [this, input, llData](size_t i)
+		{
+			const size_t b = input->begins[i], len = input->lengths[i];
+			visitTokens(input->dtype, input->data, [&](auto* ptr)
+			{
+				evaluateWithCluster(ptr + b, len, llData + b);
+			});
+		};
+
+		if (deferred)
+		{
+			auto ret = py::makeNewObject<KNLangModelEvaluateResultObject>();
+			ret->inArray = move(array);
+			ret->inSpans = move(spans);
+			ret->outLl = move(outLl);
+			Py_INCREF(this);
+			ret->parent = py::UniqueCObj<KNLangModelObject>{ (KNLangModelObject*)this };
+			ret->futures = enqueueBlocks(*workers, input->begins.size(), score);
+			return ret;
+		}
+		else
+		{
+			{
+				py::ReleaseGIL gil;
+				forEachOnPool(workers.get(), input->begins.size(), score);
+			}
+			return outLl;
+		}
+	}
 };
 
 py::TypeWrapper<KNLangModelObject> _KNLangModelObjectSetter{ gModule, [](PyTypeObject& obj)
@@ -808,6 +1432,8 @@ py::TypeWrapper<KNLangModelObject> _KNLangModelObjectSetter{ gModule, [](PyTypeO
 		{ "save", PY_METHOD(&KNLangModelObject::save), METH_VARARGS | METH_KEYWORDS, ""},
 		{ "next_tokens", PY_METHOD(&KNLangModelObject::nextTokens), METH_VARARGS | METH_KEYWORDS, ""},
 		{ "evaluate", PY_METHOD(&KNLangModelObject::evaluate), METH_VARARGS | METH_KEYWORDS, ""},
+		{ "_next_tokens_batch", PY_METHOD(&KNLangModelObject::nextTokensBatch), METH_VARARGS | METH_KEYWORDS, ""},
+		{ "_evaluate_batch", PY_METHOD(&KNLangModelObject::evaluateBatch), METH_VARARGS | METH_KEYWORDS, ""},
 		{ nullptr }
 	};
 	static PyGetSetDef getsets[] =
@@ -822,22 +1448,529 @@ py::TypeWrapper<KNLangModelObject> _KNLangModelObjectSetter{ gModule, [](PyTypeO
 	obj.tp_getset = getsets;
 } };
 
+/**
+ * @brief Incremented in the child process on every `fork()`.
+ * Worker threads are not duplicated by `fork()`, so a `Kiwi` built before the fork has a thread pool without threads in the child.
+ * `KiwiObject` compares this counter with the one it has seen last to notice that it has been inherited.
+ */
+static std::atomic<size_t> gForkGeneration{ 0 };
 
-struct KiwiObject : py::CObject<KiwiObject>
+#ifndef _WIN32
+[[maybe_unused]] static const int gForkHandlerRegistered = pthread_atfork(nullptr, nullptr, []() { ++gForkGeneration; });
+#endif
+
+inline bool isHangulSyllable(char16_t c)
 {
-	static constexpr const char* _name = "kiwipiepy._Kiwi";
-	static constexpr const char* _name_in_module = "_Kiwi";
-	static constexpr int _flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE;
+	return 0xAC00 <= c && c <= 0xD7A3;
+}
 
-	KiwiBuilder builder;
-	Kiwi kiwi;
-	TypoTransformerObject* typos = nullptr;
-	float typoCostThreshold = 2.5f;
+/**
+ * @brief Words added to an already-built `Kiwi` without rebuilding it.
+ * 
+ * A published overlay is never modified. Adding words creates a new layer on top of the current one, 
+ * so an analysis keeps the overlay it started with even if words are added meanwhile.
+ * A new layer absorbs the layers below it which are not larger than itself, which keeps the chain logarithmic in the number of words.
+ * Occurrences of overlay words are passed to `Kiwi::analyze` as pretokenized spans.
+ */
+struct UserOverlay
+{
+	std::shared_ptr<const UserOverlay> base;
+	std::deque<u16string> forms;
+	std::unordered_map<std::u16string_view, POSTag> words;
+	std::unordered_set<char16_t> firstChars;
+	size_t maxLength = 0, chainMaxLength = 0, chainSize = 0;
+
+	bool insert(const u16string& form, POSTag tag)
+	{
+		if (form.empty() || words.count(form)) return false;
+		forms.emplace_back(form);
+		words.emplace(forms.back(), tag);
+		firstChars.insert(form[0]);
+		maxLength = std::max(maxLength, form.size());
+		return true;
+	}
 
-	using _InitArgs = std::tuple<
-		size_t,
-		std::optional<const char*>,
-		bool,
+	void seal()
+	{
+		while (base && base->words.size() <= words.size())
+		{
+			auto below = base;
+			for (auto& p : below->words) insert(u16string{ p.first }, p.second);
+			base = below->base;
+		}
+		chainMaxLength = std::max(maxLength, base ? base->chainMaxLength : 0);
+		// a form which only re-tags a word of a lower layer is already counted there
+		size_t fresh = words.size();
+		if (base)
+		{
+			for (auto& p : words) if (base->find(p.first)) --fresh;
+		}
+		chainSize = fresh + (base ? base->chainSize : 0);
+	}
+
+	const POSTag* find(std::u16string_view form) const
+	{
+		for (auto* layer = this; layer; layer = layer->base.get())
+		{
+			if (form.size() > layer->maxLength || !layer->firstChars.count(form[0])) continue;
+			auto it = layer->words.find(form);
+			if (it != layer->words.end()) return &it->second;
+		}
+		return nullptr;
+	}
+
+	static bool isWordChar(char16_t c)
+	{
+		return isHangulSyllable(c) || (u'0' <= c && c <= u'9') || (u'A' <= c && c <= u'Z') || (u'a' <= c && c <= u'z');
+	}
+
+	static bool isAsciiAlnum(char16_t c)
+	{
+		return c < 0x80 && isWordChar(c);
+	}
+
+	/**
+	 * @brief Appends a span for every leftmost-longest occurrence of an overlay word in `text`.
+	 * 
+	 * An occurrence has to start a word, that is, it must not follow a Hangul syllable, a Latin letter or a digit.
+	 * It may be followed by Hangul, as particles and endings attach to it, but must not stop in the middle of a run of Latin letters and digits.
+	 */
+	void match(const u16string& text, vector<PretokenizedSpan>& out) const
+	{
+		for (size_t i = 0; i < text.size();)
+		{
+			if (i > 0 && isWordChar(text[i - 1]))
+			{
+				++i;
+				continue;
+			}
+			size_t len = std::min(chainMaxLength, text.size() - i);
+			for (; len > 0; --len)
+			{
+				const size_t end = i + len;
+				if (end < text.size() && isAsciiAlnum(text[end - 1]) && isAsciiAlnum(text[end])) continue;
+				if (auto* tag = find(std::u16string_view{ text.data() + i, len }))
+				{
+					out.emplace_back(PretokenizedSpan{ (uint32_t)i, (uint32_t)(i + len) });
+					out.back().tokenization.emplace_back();
+					auto& token = out.back().tokenization.back();
+					token.form = text.substr(i, len);
+					token.tag = *tag;
+					token.begin = 0;
+					token.end = len;
+					break;
+				}
+			}
+			i += len ? len : 1;
+		}
+	}
+};
+
+/**
+ * @brief Patterns of `add_re_word` translated to ECMAScript by kiwipiepy/_re_native.py and matched in the worker threads.
+ * 
+ * Like `UserOverlay`, a published set is never modified, so an analysis keeps the set it started with.
+ * Only patterns whose `pretokenized` is fixed live here; callbacks and patterns which cannot be translated exactly stay in Python.
+ * 
+ * The patterns with a prefilter are matched together in a single scan of the text, 
+ * which looks up the patterns that may start at each position by its character.
+ * `std::regex` recurses once per character it consumes, so a match is never searched for beyond `maxMatchLength` characters.
+ */
+struct NativeReWords
+{
+	using Tokens = decltype(PretokenizedSpan::tokenization);
+
+	static constexpr size_t maxMatchLength = 1024;
+
+	struct Pattern
+	{
+		std::wregex re;
+		// every match starts with `prefix` and with a character in `firstChars`. 
+		// Positions not satisfying them are skipped without running `re`, which is far slower than the checks.
+		std::wstring prefix;
+		vector<pair<uint32_t, uint32_t>> firstChars;
+		// offsets are in code points relative to the match. A single token without `form` takes the matched text.
+		Tokens tokenization;
+
+		bool hasPrefilter() const
+		{
+			return !prefix.empty() || !firstChars.empty();
+		}
+
+		/**
+		 * @brief Runs `re` on `wide` from `pos`, looking at most `maxMatchLength` characters ahead of where a match may start.
+		 * With `continuous`, only a match starting at `pos` is accepted.
+		 */
+		bool search(const std::wstring& wide, size_t pos, bool continuous, std::wsmatch& m) const
+		{
+			const size_t end = std::min(wide.size(), pos + (continuous ? 1 : 2) * maxMatchLength);
+			auto flags = pos ? std::regex_constants::match_prev_avail : std::regex_constants::match_default;
+			// the end of the window is not the end of the text
+			if (end < wide.size()) flags |= std::regex_constants::match_not_eol;
+			if (continuous) flags |= std::regex_constants::match_continuous;
+			return std::regex_search(wide.cbegin() + pos, wide.cbegin() + end, m, re, flags);
+		}
+	};
+
+	vector<Pattern> patterns;
+	// the first characters of the patterns with a prefilter, split into intervals. 
+	// Characters from `firstCharStarts[i]` up to the next start may start the patterns in `firstCharPatterns[i]`, in the order of `patterns`.
+	vector<uint32_t> firstCharStarts;
+	vector<vector<uint32_t>> firstCharPatterns;
+	// patterns without a prefilter, which are searched for one by one
+	vector<uint32_t> unanchored;
+
+	/**
+	 * @brief Builds the lookup of the patterns by their first character, after all `patterns` have been added.
+	 */
+	void seal()
+	{
+		auto rangesOf = [](const Pattern& pat)
+		{
+			if (pat.prefix.empty()) return pat.firstChars;
+			return vector<pair<uint32_t, uint32_t>>{ { (uint32_t)pat.prefix[0], (uint32_t)pat.prefix[0] } };
+		};
+
+		vector<uint32_t> bounds;
+		for (size_t p = 0; p < patterns.size(); ++p)
+		{
+			if (!patterns[p].hasPrefilter())
+			{
+				unanchored.emplace_back(p);
+				continue;
+			}
+			for (auto& r : rangesOf(patterns[p]))
+			{
+				bounds.emplace_back(r.first);
+				bounds.emplace_back(r.second + 1);
+			}
+		}
+		sort(bounds.begin(), bounds.end());
+		bounds.erase(unique(bounds.begin(), bounds.end()), bounds.end());
+		firstCharStarts = move(bounds);
+		firstCharPatterns.resize(firstCharStarts.size());
+		for (size_t p = 0; p < patterns.size(); ++p)
+		{
+			if (!patterns[p].hasPrefilter()) continue;
+			for (auto& r : rangesOf(patterns[p]))
+			{
+				auto b = lower_bound(firstCharStarts.begin(), firstCharStarts.end(), r.first) - firstCharStarts.begin();
+				auto e = lower_bound(firstCharStarts.begin(), firstCharStarts.end(), r.second + 1) - firstCharStarts.begin();
+				for (auto i = b; i < e; ++i) firstCharPatterns[i].emplace_back(p);
+			}
+		}
+	}
+
+	const vector<uint32_t>* patternsStartingWith(wchar_t c) const
+	{
+		auto it = upper_bound(firstCharStarts.begin(), firstCharStarts.end(), (uint32_t)c);
+		if (it == firstCharStarts.begin()) return nullptr;
+		auto& ret = firstCharPatterns[it - firstCharStarts.begin() - 1];
+		return ret.empty() ? nullptr : &ret;
+	}
+
+	/**
+	 * @brief Converts `text` into a wide string. `wcharPos` maps wide characters to UTF-16 offsets, and stays empty if they are the same.
+	 */
+	static void toWide(const u16string& text, std::wstring& wide, vector<uint32_t>& wcharPos)
+	{
+		wide.clear();
+		wcharPos.clear();
+		if constexpr (sizeof(wchar_t) == sizeof(char16_t))
+		{
+			wide.assign(text.begin(), text.end());
+		}
+		else
+		{
+			wide.reserve(text.size());
+			wcharPos.reserve(text.size() + 1);
+			for (size_t i = 0; i < text.size(); ++i)
+			{
+				wcharPos.emplace_back(i);
+				char32_t c = text[i];
+				if ((c & 0xFC00) == 0xD800 && i + 1 < text.size() && (text[i + 1] & 0xFC00) == 0xDC00)
+				{
+					c = 0x10000 + ((c - 0xD800) << 10) + (text[i + 1] - 0xDC00);
+					++i;
+				}
+				wide.push_back((wchar_t)c);
+			}
+			wcharPos.emplace_back(text.size());
+		}
+	}
+
+	/**
+	 * @brief Appends a span for every non-overlapping match of every pattern in `text`, as `re.finditer` does, 
+	 * and the index of its pattern to `origins`. Spans are ordered by their beginning, then by their pattern.
+	 */
+	void match(const u16string& text, vector<PretokenizedSpan>& out, vector<size_t>& origins) const
+	{
+		std::wstring wide;
+		vector<uint32_t> wcharPos;
+		toWide(text, wide, wcharPos);
+		auto toU16 = [&](size_t i) { return (uint32_t)(wcharPos.empty() ? i : wcharPos[i]); };
+
+		// (begin, end, pattern)
+		vector<tuple<size_t, size_t, size_t>> found;
+		std::wsmatch m;
+
+		// the matches of a pattern do not overlap, so a pattern is not tried again before the end of its last match
+		vector<size_t> resumeAt(patterns.size());
+		for (size_t pos = 0; pos < wide.size(); ++pos)
+		{
+			auto* candidates = patternsStartingWith(wide[pos]);
+			if (!candidates) continue;
+			for (auto p : *candidates)
+			{
+				if (resumeAt[p] > pos) continue;
+				auto& pat = patterns[p];
+				if (!pat.prefix.empty() && wide.compare(pos, pat.prefix.size(), pat.prefix) != 0) continue;
+				if (!pat.search(wide, pos, true, m)) continue;
+				const size_t e = m[0].second - wide.cbegin();
+				if (e == pos) continue;
+				found.emplace_back(pos, e, p);
+				resumeAt[p] = e;
+			}
+		}
+
+		for (auto p : unanchored)
+		{
+			auto& pat = patterns[p];
+			for (size_t pos = 0; pos < wide.size();)
+			{
+				if (!pat.search(wide, pos, false, m))
+				{
+					// nothing starts within the window, so the next one begins where a match could have started last
+					if (pos + maxMatchLength >= wide.size()) break;
+					pos += maxMatchLength;
+					continue;
+				}
+				const size_t b = m[0].first - wide.cbegin(), e = m[0].second - wide.cbegin();
+				if (b >= pos + maxMatchLength && e == std::min(wide.size(), pos + 2 * maxMatchLength))
+				{
+					// the match may have been cut by the window, so it is searched for again from its beginning
+					pos = b;
+					continue;
+				}
+				if (b == e)
+				{
+					pos = b + 1;
+					continue;
+				}
+				found.emplace_back(b, e, p);
+				pos = e;
+			}
+		}
+		if (!unanchored.empty())
+		{
+			sort(found.begin(), found.end(), [](auto&& a, auto&& b) { return make_pair(get<0>(a), get<2>(a)) < make_pair(get<0>(b), get<2>(b)); });
+		}
+
+		for (auto& f : found)
+		{
+			const size_t b = get<0>(f), e = get<1>(f);
+			auto& pat = patterns[get<2>(f)];
+			out.emplace_back(PretokenizedSpan{ toU16(b), toU16(e) });
+			auto& span = out.back();
+			span.tokenization = pat.tokenization;
+			if (span.tokenization.size() == 1 && span.tokenization[0].form.empty())
+			{
+				auto& token = span.tokenization[0];
+				token.form = text.substr(span.begin, span.end - span.begin);
+				token.begin = 0;
+				token.end = span.end - span.begin;
+			}
+			else
+			{
+				for (auto& t : span.tokenization)
+				{
+					t.begin = toU16(std::min<size_t>(b + t.begin, e)) - span.begin;
+					t.end = toU16(std::min<size_t>(b + t.end, e)) - span.begin;
+				}
+			}
+			origins.emplace_back(get<2>(f));
+		}
+	}
+};
+
+/**
+ * @brief What `KiwiObject::analyze` returns for each input, as a combination of flags.
+ * `False` and `True` given by the older callers mean `tokens` and `arrays`.
+ */
+enum class AnalyzeOutput : uint32_t
+{
+	tokens = 0,
+	arrays = 1 << 0,
+	// the best result is split into sentences by `TokenResult::sentPosition`. The flags below choose what a sentence holds.
+	sentences = 1 << 1,
+	sentenceTokens = 1 << 2,
+	subSentences = 1 << 3,
+	sentenceSpans = 1 << 4,
+	// only the text respaced by `spaceByTokens` is returned, optionally with the whitespace between Hangul removed beforehand
+	spaced = 1 << 5,
+	resetWhitespace = 1 << 6,
+	// the native patterns of `add_re_word` are applied. Only the callers which have synced them with `Kiwi._sync_re_words` set it.
+	reWords = 1 << 7,
+};
+
+inline bool operator&(AnalyzeOutput a, AnalyzeOutput b)
+{
+	return ((uint32_t)a & (uint32_t)b) != 0;
+}
+
+/**
+ * @brief Set on the worker threads which have run a task of this module.
+ * A generation released on such a thread is destroyed on another one, since its pool cannot join the thread it is running on.
+ */
+static thread_local bool tlsOnKiwiWorker = false;
+
+/**
+ * @brief Whether the interpreter is shutting down, after which a foreign thread must not take the GIL any more.
+ */
+inline bool isPyFinalizing()
+{
+#if PY_VERSION_HEX >= 0x030D0000
+	return Py_IsFinalizing();
+#else
+	return _Py_IsFinalizing();
+#endif
+}
+
+/**
+ * @brief Counters about the model generations of a `KiwiObject`, shared with the deleters of the generations.
+ */
+struct KiwiGenerationStats
+{
+	std::atomic<size_t> alive{ 0 };
+	size_t published = 0;
+	double lastBuildTime = 0, lastSwapLatency = 0;
+};
+
+/**
+ * @brief Counts the analyses running without the GIL on a generation.
+ * The settings of a generation are changed only while none of them is running, see `KiwiObject::changeSettings`.
+ */
+struct RunningAnalyses
+{
+	std::mutex mutex;
+	std::condition_variable cv;
+	size_t count = 0;
+
+	bool idle()
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		return count == 0;
+	}
+
+	void waitIdle()
+	{
+		std::unique_lock<std::mutex> lock{ mutex };
+		cv.wait(lock, [&]() { return count == 0; });
+	}
+};
+
+/**
+ * @brief Deleter of a published generation, which also carries the `RunningAnalyses` of the generation.
+ */
+struct GenerationDeleter
+{
+	std::shared_ptr<KiwiGenerationStats> stats;
+	std::shared_ptr<RunningAnalyses> running = std::make_shared<RunningAnalyses>();
+
+	void operator()(Kiwi* k) const
+	{
+		auto destroy = [stats = stats, k]()
+		{
+			delete k;
+			--stats->alive;
+		};
+		// a pool cannot join itself, so a generation released by one of its own workers is destroyed elsewhere
+		if (tlsOnKiwiWorker) std::thread{ destroy }.detach();
+		else destroy();
+	}
+};
+
+/**
+ * @brief Counts an analysis on `generation` as running until the returned handle and all of its copies are dropped.
+ * It has to be made while holding the GIL, before the GIL is released for the analysis.
+ */
+inline std::shared_ptr<void> markRunning(const std::shared_ptr<const Kiwi>& generation)
+{
+	auto* deleter = std::get_deleter<GenerationDeleter>(generation);
+	// a generation which has never been built is not published and has nothing to protect
+	if (!deleter) return {};
+	auto running = deleter->running;
+	{
+		std::lock_guard<std::mutex> lock{ running->mutex };
+		++running->count;
+	}
+	return std::shared_ptr<void>{ nullptr, [running](void*)
+	{
+		std::lock_guard<std::mutex> lock{ running->mutex };
+		if (--running->count == 0) running->cv.notify_all();
+	} };
+}
+
+struct KiwiObject : py::CObject<KiwiObject>
+{
+	static constexpr const char* _name = "kiwipiepy._Kiwi";
+	static constexpr const char* _name_in_module = "_Kiwi";
+	static constexpr int _flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE;
+
+	KiwiBuilder builder;
+	// the current model generation. An analysis keeps the generation it started with, 
+	// so a replaced generation is freed when the last analysis using it has finished.
+	std::shared_ptr<Kiwi> kiwi = std::make_shared<Kiwi>();
+	std::shared_ptr<KiwiGenerationStats> generationStats = std::make_shared<KiwiGenerationStats>();
+	size_t builderVersion = 0, builtVersion = 0;
+	bool rebuilding = false;
+	// the thread of `rebuildInBackground`, joined before the object goes away
+	std::thread rebuildThread;
+	// set before joining `rebuildThread` on destruction, so that the thread does not publish into a dying object
+	bool closing = false;
+	TypoTransformerObject* typos = nullptr;
+	float typoCostThreshold = 2.5f;
+	size_t prefetchItems = 0, prefetchChars = 0;
+	size_t microBatchChars = 256;
+	// `inheritedKiwi` was built in a parent process and is shared with it copy-on-write.
+	// Its thread pool has no threads here, so `forkedPool` replaces it and the inherited generation is never destroyed.
+	size_t forkGeneration = gForkGeneration;
+	const Kiwi* inheritedKiwi = nullptr;
+	std::unique_ptr<utils::ThreadPool> forkedPool;
+	std::shared_ptr<const UserOverlay> overlay;
+	std::shared_ptr<const NativeReWords> reWords;
+	// user values of `reWords`, in the same order
+	py::UniqueObj reWordValues;
+	// the number of calls reading `builder` with the GIL released, during which it must not be modified
+	mutable size_t builderReaders = 0;
+
+	/**
+	 * @brief Counts a call reading `builder` with the GIL released. It must be destroyed with the GIL held.
+	 */
+	struct BuilderReading
+	{
+		const KiwiObject* obj;
+
+		BuilderReading(const KiwiObject* _obj) : obj{ _obj }
+		{
+			++obj->builderReaders;
+		}
+
+		~BuilderReading()
+		{
+			--obj->builderReaders;
+		}
+	};
+
+	void checkBuilderWritable() const
+	{
+		if (builderReaders) throw py::RuntimeError{ "The dictionary cannot be modified while `make_hsdataset` or `convert_hsdata` is running." };
+	}
+
+	using _InitArgs = std::tuple<
+		size_t,
+		std::optional<const char*>,
+		bool,
 		bool,
 		bool,
 		bool,
@@ -847,6 +1980,14 @@ struct KiwiObject : py::CObject<KiwiObject>
 	>;
 
 	KiwiObject() = default;
+	KiwiObject(KiwiObject&&) = default;
+	KiwiObject& operator=(KiwiObject&&) = default;
+
+	~KiwiObject()
+	{
+		closing = true;
+		waitRebuild();
+	}
 
 	KiwiObject(size_t numThreads, 
 		std::optional<const char*> modelPath = {}, 
@@ -898,10 +2039,79 @@ struct KiwiObject : py::CObject<KiwiObject>
 		builder = KiwiBuilder{ spath, numThreads, (BuildOption)boptions, !!sbg };
 	}
 
+	void checkFork()
+	{
+		if (forkGeneration == gForkGeneration) return;
+		forkGeneration = gForkGeneration;
+		// a worker of the parent may have held the pool at the moment of the fork, so it must never be joined or destroyed here
+		forkedPool.release();
+		inheritedKiwi = nullptr;
+		if (!kiwi->ready()) return;
+		new std::shared_ptr<Kiwi>{ kiwi };
+		inheritedKiwi = kiwi.get();
+		if (kiwi->getThreadPool()) forkedPool = std::make_unique<utils::ThreadPool>(kiwi->getNumThreads());
+	}
+
+	utils::ThreadPool* threadPool(const Kiwi& generation)
+	{
+		checkFork();
+		if (&generation == inheritedKiwi) return forkedPool.get();
+		return generation.getThreadPool();
+	}
+
+	/**
+	 * @brief Marks the current generation as outdated after `builder` has been changed.
+	 * It keeps serving until a new generation is published.
+	 */
+	void resetKiwi()
+	{
+		++builderVersion;
+	}
+
 	void doPrepare()
 	{
-		if (kiwi.ready()) return;
-		kiwi = builder.build(typos ? typos->tt : getDefaultTypoSet(DefaultTypoSet::withoutTypo), typoCostThreshold);
+		checkFork();
+		// while a background rebuild is running the outdated generation keeps serving
+		if (kiwi->ready() && (builtVersion == builderVersion || rebuilding)) return;
+		const size_t version = builderVersion;
+		const auto start = chrono::steady_clock::now();
+		auto built = builder.build(typos ? typos->tt : getDefaultTypoSet(DefaultTypoSet::withoutTypo), typoCostThreshold);
+		const auto builtAt = chrono::steady_clock::now();
+		generationStats->lastBuildTime = chrono::duration<double>(builtAt - start).count();
+		publish(std::move(built), version, builtAt);
+	}
+
+	/**
+	 * @brief Applies `fn` to the current generation once no analysis is running on it.
+	 * Analyses running without the GIL read the settings of their generation, so these are never changed under them.
+	 * Starting an analysis requires the GIL, so none can start between the check and the change.
+	 */
+	template<class Fn>
+	void changeSettings(Fn&& fn)
+	{
+		if (auto* deleter = std::get_deleter<GenerationDeleter>(kiwi))
+		{
+			auto running = deleter->running;
+			while (!running->idle())
+			{
+				py::ReleaseGIL gil;
+				running->waitIdle();
+			}
+		}
+		fn(*kiwi);
+	}
+
+	void publish(Kiwi&& built, size_t version, chrono::steady_clock::time_point builtAt)
+	{
+		auto stats = generationStats;
+		++stats->alive;
+		std::shared_ptr<Kiwi> next{ new Kiwi{ std::move(built) }, GenerationDeleter{ stats } };
+		auto prev = std::exchange(kiwi, std::move(next));
+		builtVersion = version;
+		++stats->published;
+		stats->lastSwapLatency = chrono::duration<double>(chrono::steady_clock::now() - builtAt).count();
+		prev.reset();
+
 		py::UniqueObj handler{ PyObject_GetAttrString((PyObject*)this, "_on_build") };
 		if (handler)
 		{
@@ -915,12 +2125,70 @@ struct KiwiObject : py::CObject<KiwiObject>
 	}
 
 	std::pair<uint32_t, bool> addUserWord(const char* word, const char* tag = "NNP", float score = 0, std::optional<const char*> origWord = {});
+	py::UniqueObj addUserWordsBulk(PyObject* forms, PyObject* tags, PyObject* scores);
 	bool addPreAnalyzedWord(const char* form, PyObject* oAnalyzed = nullptr, float score = 0);
 	std::vector<std::pair<uint32_t, std::u16string>> addRule(const char* tag, PyObject* replacer, float score = 0);
-	py::UniqueObj analyze(PyObject* text, size_t topN = 1, Match matchOptions = Match::all, bool echo = false, PyObject* blockList = Py_None, PyObject* pretokenized = Py_None);
+	py::UniqueObj analyze(PyObject* text, size_t topN = 1, Match matchOptions = Match::all, bool echo = false, PyObject* blockList = Py_None, PyObject* pretokenized = Py_None, AnalyzeOutput output = AnalyzeOutput::tokens, bool ordered = true);
+	void analyzeAsync(PyObject* text, size_t topN, Match matchOptions, PyObject* blockList, PyObject* pretokenized, PyObject* post);
+	py::UniqueObj glue(PyObject* chunks, size_t window);
 	py::UniqueObj extractAddWords(PyObject* sentences, size_t minCnt = 10, size_t maxWordLen = 10, float minScore = 0.25f, float posScore = -3, bool lmFilter = true);
 	py::UniqueObj extractWords(PyObject* sentences, size_t minCnt, size_t maxWordLen = 10, float minScore = 0.25f, float posScore = -3, bool lmFilter = true) const;
 	size_t loadUserDictionary(const char* path);
+	size_t addOverlayWords(PyObject* words);
+
+	void clearOverlay()
+	{
+		overlay.reset();
+	}
+
+	std::vector<size_t> setNativeReWords(PyObject* patterns);
+
+	size_t getOverlaySize() const
+	{
+		return overlay ? overlay->chainSize : 0;
+	}
+
+	void rebuildInBackground();
+
+	/**
+	 * @brief Joins the thread of the background rebuild, if any, without holding the GIL, so that the thread can publish its result.
+	 */
+	void waitRebuild()
+	{
+		if (!rebuildThread.joinable()) return;
+		py::ReleaseGIL gil;
+		rebuildThread.join();
+	}
+
+	size_t getGeneration() const
+	{
+		return generationStats->published;
+	}
+
+	size_t getAliveGenerations() const
+	{
+		return generationStats->alive;
+	}
+
+	double getLastBuildTime() const
+	{
+		return generationStats->lastBuildTime;
+	}
+
+	double getLastSwapLatency() const
+	{
+		return generationStats->lastSwapLatency;
+	}
+
+	bool getRebuilding() const
+	{
+		return rebuilding;
+	}
+
+	void saveModel(const char* path) const
+	{
+		builder.saveModel(path);
+	}
 	py::UniqueObj getMorpheme(size_t id);
 	py::UniqueObj join(PyObject* morphs, bool lmSearch = true, bool returnPositions = false);
 	
@@ -930,6 +2198,14 @@ struct KiwiObject : py::CObject<KiwiObject>
 		PyObject* morphemeDefPath = nullptr,
 		size_t morphemeDefMinCnt = 0) const;
 
+	void convertHSDataShards(
+		PyObject* inputGroups,
+		PyObject* outputPathes,
+		PyObject* morphemeDefPath,
+		size_t morphemeDefMinCnt,
+		size_t numWorkers,
+		PyObject* onConverted) const;
+
 	py::UniqueObj makeHSDataset(PyObject* inputPathes, 
 		size_t batchSize, 
 		size_t causalContextSize, 
@@ -943,93 +2219,102 @@ struct KiwiObject : py::CObject<KiwiObject>
 		bool separateDefaultMorpheme = false, 
 		PyObject* morphemeDefPath = nullptr,
 		size_t morphemeDefMinCnt = 0,
-		size_t seed = 42) const;
+		size_t seed = 42,
+		size_t shardIndex = 0,
+		PyObject* datasetType = nullptr) const;
 
 	py::UniqueObj listAllScripts() const;
 
 	float getCutOffThreshold() const
 	{
-		return kiwi.getCutOffThreshold();
+		return kiwi->getCutOffThreshold();
 	}
 
 	void setCutOffThreshold(float v)
 	{
-		kiwi.setCutOffThreshold(v);
+		changeSettings([&](Kiwi& k) { k.setCutOffThreshold(v); });
 	}
 
 	size_t getMaxUnkFormSize() const
 	{
-		return kiwi.getMaxUnkFormSize();
+		return kiwi->getMaxUnkFormSize();
 	}
 
 	void setMaxUnkFormSize(size_t v)
 	{
-		kiwi.setMaxUnkFormSize(v);
+		changeSettings([&](Kiwi& k) { k.setMaxUnkFormSize(v); });
 	}
 
 	float getUnkScoreBias() const
 	{
-		return kiwi.getUnkScoreBias();
+		return kiwi->getUnkScoreBias();
 	}
 
 	void setUnkScoreBias(float v)
 	{
-		kiwi.setUnkScoreBias(v);
+		changeSettings([&](Kiwi& k) { k.setUnkScoreBias(v); });
 	}
 
 	float getUnkScoreScale() const
 	{
-		return kiwi.getUnkScoreScale();
+		return kiwi->getUnkScoreScale();
 	}
 
 	void setUnkScoreScale(float v)
 	{
-		kiwi.setUnkScoreScale(v);
+		changeSettings([&](Kiwi& k) { k.setUnkScoreScale(v); });
 	}
 
 	bool getIntegrateAllomorph() const
 	{
-		return kiwi.getIntegrateAllomorph();
+		return kiwi->getIntegrateAllomorph();
 	}
 
 	void setIntegrateAllomorph(bool v)
 	{
-		kiwi.setIntegrateAllomorph(v);
+		changeSettings([&](Kiwi& k) { k.setIntegrateAllomorph(v); });
 	}
 
 	size_t getSpaceTolerance() const
 	{
-		return kiwi.getSpaceTolerance();
+		return kiwi->getSpaceTolerance();
 	}
 
 	void setSpaceTolerance(size_t v)
 	{
-		kiwi.setSpaceTolerance(v);
+		changeSettings([&](Kiwi& k) { k.setSpaceTolerance(v); });
 	}
 
 	float getSpacePenalty() const
 	{
-		return kiwi.getSpacePenalty();
+		return kiwi->getSpacePenalty();
 	}
 
 	void setSpacePenalty(float v)
 	{
-		kiwi.setSpacePenalty(v);
+		changeSettings([&](Kiwi& k) { k.setSpacePenalty(v); });
 	}
 
 	float getTypoCostWeight() const
 	{
-		return kiwi.getTypoCostWeight();
+		return kiwi->getTypoCostWeight();
 	}
 
 	void setTypoCostWeight(float v)
 	{
-		kiwi.setTypoCostWeight(v);
+		changeSettings([&](Kiwi& k) { k.setTypoCostWeight(v); });
 	}
 
 	size_t getNumWorkers() const
 	{
-		return kiwi.getNumThreads();
+		return kiwi->getNumThreads();
+	}
+
+	template<class Iter>
+	void setPrefetchWindow(Iter& iter) const
+	{
+		const size_t numThreads = std::max<size_t>(kiwi->getNumThreads(), 1);
+		iter.setWindow(numThreads, prefetchItems ? prefetchItems : numThreads * 16, prefetchChars);
 	}
 };
 
@@ -1038,15 +2323,26 @@ py::TypeWrapper<KiwiObject> _KiwiSetter{ gModule, [](PyTypeObject& obj)
 	static PyMethodDef methods[] =
 	{
 		{ "add_user_word", PY_METHOD(&KiwiObject::addUserWord), METH_VARARGS | METH_KEYWORDS, ""},
+		{ "_add_user_words_bulk", PY_METHOD(&KiwiObject::addUserWordsBulk), METH_VARARGS | METH_KEYWORDS, ""},
 		{ "add_pre_analyzed_word", PY_METHOD(&KiwiObject::addPreAnalyzedWord), METH_VARARGS | METH_KEYWORDS, ""},
 		{ "add_rule", PY_METHOD(&KiwiObject::addRule), METH_VARARGS | METH_KEYWORDS, ""},
 		{ "load_user_dictionary", PY_METHOD(&KiwiObject::loadUserDictionary), METH_VARARGS | METH_KEYWORDS, "" },
+		{ "_add_overlay_words", PY_METHOD(&KiwiObject::addOverlayWords), METH_VARARGS | METH_KEYWORDS, "" },
+		{ "_clear_overlay", PY_METHOD(&KiwiObject::clearOverlay), METH_VARARGS | METH_KEYWORDS, "" },
+		{ "_set_native_re_words", PY_METHOD(&KiwiObject::setNativeReWords), METH_VARARGS | METH_KEYWORDS, "" },
+		{ "_save_model", PY_METHOD(&KiwiObject::saveModel), METH_VARARGS | METH_KEYWORDS, "" },
+		{ "_prepare", PY_METHOD(&KiwiObject::doPrepare), METH_VARARGS | METH_KEYWORDS, "" },
+		{ "_rebuild_in_background", PY_METHOD(&KiwiObject::rebuildInBackground), METH_VARARGS | METH_KEYWORDS, "" },
+		{ "_wait_rebuild", PY_METHOD(&KiwiObject::waitRebuild), METH_VARARGS | METH_KEYWORDS, "" },
 		{ "extract_words", PY_METHOD(&KiwiObject::extractWords), METH_VARARGS | METH_KEYWORDS, "" },
 		{ "extract_add_words", PY_METHOD(&KiwiObject::extractAddWords), METH_VARARGS | METH_KEYWORDS, "" },
 		{ "analyze", PY_METHOD(&KiwiObject::analyze), METH_VARARGS | METH_KEYWORDS, "" },
+		{ "_analyze_async", PY_METHOD(&KiwiObject::analyzeAsync), METH_VARARGS | METH_KEYWORDS, "" },
+		{ "_glue", PY_METHOD(&KiwiObject::glue), METH_VARARGS | METH_KEYWORDS, "" },
 		{ "morpheme", PY_METHOD(&KiwiObject::getMorpheme), METH_VARARGS | METH_KEYWORDS, "" },
 		{ "join", PY_METHOD(&KiwiObject::join), METH_VARARGS | METH_KEYWORDS, "" },
 		{ "convert_hsdata", PY_METHOD(&KiwiObject::convertHSData), METH_VARARGS | METH_KEYWORDS, "" },
+		{ "_convert_hsdata_shards", PY_METHOD(&KiwiObject::convertHSDataShards), METH_VARARGS | METH_KEYWORDS, "" },
 		{ "make_hsdataset", PY_METHOD(&KiwiObject::makeHSDataset), METH_VARARGS | METH_KEYWORDS, "" },
 		{ "list_all_scripts", PY_METHOD(&KiwiObject::listAllScripts), METH_VARARGS | METH_KEYWORDS, "" },
 		{ nullptr }
@@ -1063,19 +2359,45 @@ py::TypeWrapper<KiwiObject> _KiwiSetter{ gModule, [](PyTypeObject& obj)
 		{ (char*)"_typo_cost_weight", PY_GETTER(&KiwiObject::getTypoCostWeight), PY_SETTER(&KiwiObject::setTypoCostWeight), "", nullptr },
 		{ (char*)"_typo_cost_threshold", PY_GETTER(&KiwiObject::typoCostThreshold), PY_SETTER(&KiwiObject::typoCostThreshold), "", nullptr },
 		{ (char*)"_num_workers", PY_GETTER(&KiwiObject::getNumWorkers), nullptr, "", nullptr },
+		{ (char*)"_overlay_size", PY_GETTER(&KiwiObject::getOverlaySize), nullptr, "", nullptr },
+		{ (char*)"_generation", PY_GETTER(&KiwiObject::getGeneration), nullptr, "", nullptr },
+		{ (char*)"_alive_generations", PY_GETTER(&KiwiObject::getAliveGenerations), nullptr, "", nullptr },
+		{ (char*)"_last_build_time", PY_GETTER(&KiwiObject::getLastBuildTime), nullptr, "", nullptr },
+		{ (char*)"_last_swap_latency", PY_GETTER(&KiwiObject::getLastSwapLatency), nullptr, "", nullptr },
+		{ (char*)"_rebuilding", PY_GETTER(&KiwiObject::getRebuilding), nullptr, "", nullptr },
+		{ (char*)"_prefetch_items", PY_GETTER(&KiwiObject::prefetchItems), PY_SETTER(&KiwiObject::prefetchItems), "", nullptr },
+		{ (char*)"_prefetch_chars", PY_GETTER(&KiwiObject::prefetchChars), PY_SETTER(&KiwiObject::prefetchChars), "", nullptr },
+		{ (char*)"_micro_batch_chars", PY_GETTER(&KiwiObject::microBatchChars), PY_SETTER(&KiwiObject::microBatchChars), "", nullptr },
 		{ nullptr },
 	};
 	obj.tp_methods = methods;
 	obj.tp_getset = getsets;
 }};
 
+/**
+ * @brief Immutable analysis result shared by every `Token` built from it.
+ * Strings and user values are resolved from here only when a token is asked for them.
+ */
+struct TokenResultBuffer
+{
+	vector<TokenResult> results;
+	vector<py::UniqueObj> userValues;
+	// entries of `Kiwi._user_values` for the morphemes in `results`, copied when the buffer is made
+	// so that a later `add_user_word` does not change the tokens already returned
+	py::UniqueObj userValuesDict;
+	// the morphemes referenced by `results` belong to this generation
+	std::shared_ptr<const Kiwi> kiwi;
+};
+
 struct TokenObject : py::CObject<TokenObject>
 {
 	static constexpr const char* _name = "kiwipiepy.Token";
 	static constexpr const char* _name_in_module = "Token";
 
+	std::shared_ptr<const TokenResultBuffer> _buffer;
+	const TokenInfo* _info = nullptr;
 	u16string _form, _raw_form;
-	const char* _tag = nullptr;
+	mutable const char* _tag = nullptr;
 	size_t resultHash = 0;
 	uint32_t _pos = 0, _len = 0, _wordPosition = 0, _sentPosition = 0, _subSentPosition = 0, _lineNumber = 0;
 	int32_t _pairedToken = -1, _sense = 0;
@@ -1083,10 +2405,12 @@ struct TokenObject : py::CObject<TokenObject>
 	size_t _morphId = 0;
 	const Morpheme* _morph = nullptr;
 	const Morpheme* _baseMorph = nullptr;
-	py::UniqueObj _userValue;
+	mutable py::UniqueObj _userValue;
+	int32_t _userValueSlot = -1;
 	POSTag _rawTag = POSTag::unknown;
 	ScriptType _script = ScriptType::unknown;
 	bool _regularity = false;
+	mutable bool _userValueResolved = false;
 
 	using _InitArgs = std::tuple<int>;
 	
@@ -1107,17 +2431,72 @@ struct TokenObject : py::CObject<TokenObject>
 		return make_tuple(_pos, _pos + _len);
 	}
 
+	const u16string& form() const
+	{
+		return _info ? _info->str : _form;
+	}
+
+	const u16string& rawForm() const
+	{
+		if (_info && !_typoCost) return _info->str;
+		return _raw_form;
+	}
+
+	const py::UniqueObj& userValue() const
+	{
+		// set the following object semi-immortal. (it is neither freed nor managed)
+		// it prevents crashes at Python3.12
+		static PyObject* noneValue = py::buildPyValue(nullptr).release();
+		if (_userValueResolved) return _userValue;
+		_userValueResolved = true;
+		if (!_buffer) return _userValue;
+
+		PyObject* v = nullptr;
+		if (_userValueSlot >= 0)
+		{
+			v = _buffer->userValues[_userValueSlot].get();
+		}
+		else if (_buffer->userValuesDict)
+		{
+			v = PyDict_GetItem(_buffer->userValuesDict.get(), py::buildPyValue(_morphId).get());
+		}
+		if (!v) v = noneValue;
+		Py_INCREF(v);
+		_userValue = py::UniqueObj{ v };
+		return _userValue;
+	}
+
+	const char* tag() const
+	{
+		// set the following object semi-immortal. (it is neither freed nor managed)
+		// it prevents crashes at Python3.12
+		static PyObject* tagAttr = py::buildPyValue("tag").release();
+		if (_tag) return _tag;
+		_tag = getTagStr(_rawTag, form());
+		auto& uv = userValue();
+		if (PyDict_Check(uv.get()))
+		{
+			// tag override
+			auto v = PyDict_GetItem(uv.get(), tagAttr);
+			if (v)
+			{
+				_tag = PyUnicode_AsUTF8(v);
+			}
+		}
+		return _tag;
+	}
+
 	u16string taggedForm() const
 	{
-		u16string ret = _form;
+		u16string ret = form();
 		ret.push_back(u'/');
-		ret += utf8To16(_tag);
+		ret += utf8To16(tag());
 	 	return ret;
 	}
 	
 	py::UniqueObj formTag() const
 	{
-		return py::buildPyTuple(_form, _tag);
+		return py::buildPyTuple(form(), tag());
 	}
 
 	u16string baseForm() const
@@ -1137,7 +2516,7 @@ struct TokenObject : py::CObject<TokenObject>
 
 	py::UniqueObj regularity()
 	{
-		if (_tag[0] == 'V') return py::buildPyValue(_regularity);
+		if (tag()[0] == 'V') return py::buildPyValue(_regularity);
 		return py::buildPyValue(nullptr);
 	}
 
@@ -1155,8 +2534,8 @@ struct TokenObject : py::CObject<TokenObject>
 
 	u16string lemma() const
 	{
-		if (_tag[0] == 'V') return _form + u'\uB2E4';
-		else return _form;
+		if (tag()[0] == 'V') return form() + u'\uB2E4';
+		else return form();
 	}
 
 	py::UniqueObj getitem(Py_ssize_t idx) const
@@ -1164,8 +2543,8 @@ struct TokenObject : py::CObject<TokenObject>
 		if (idx < 0) idx += 4;
 		switch (idx)
 		{
-		case 0: return py::buildPyValue(_form);
-		case 1: return py::buildPyValue(_tag);
+		case 0: return py::buildPyValue(form());
+		case 1: return py::buildPyValue(tag());
 		case 2: return py::buildPyValue(_pos);
 		case 3: return py::buildPyValue(_len);
 		}
@@ -1179,8 +2558,8 @@ struct TokenObject : py::CObject<TokenObject>
 			if (_sense)
 			{
 				return "Token("
-					"form=" + py::reprFromCpp(_form) + ", "
-					"tag=" + py::reprFromCpp(_tag) + ", "
+					"form=" + py::reprFromCpp(form()) + ", "
+					"tag=" + py::reprFromCpp(tag()) + ", "
 					"start=" + to_string(_pos) + ", "
 					"len=" + to_string(_len) + ", "
 					"sense=" + to_string(_sense) + ")";
@@ -1188,8 +2567,8 @@ struct TokenObject : py::CObject<TokenObject>
 			else
 			{
 				return "Token("
-					"form=" + py::reprFromCpp(_form) + ", "
-					"tag=" + py::reprFromCpp(_tag) + ", "
+					"form=" + py::reprFromCpp(form()) + ", "
+					"tag=" + py::reprFromCpp(tag()) + ", "
 					"start=" + to_string(_pos) + ", "
 					"len=" + to_string(_len) + ")";
 			}
@@ -1199,15 +2578,15 @@ struct TokenObject : py::CObject<TokenObject>
 			if (_sense)
 			{
 				return "Token("
-					"form=" + py::reprFromCpp(_form) + ", "
-					"tag=" + py::reprFromCpp(_tag) + ", "
+					"form=" + py::reprFromCpp(form()) + ", "
+					"tag=" + py::reprFromCpp(tag()) + ", "
 					"sense=" + to_string(_sense) + ")";
 			}
 			else
 			{
 				return "Token("
-					"form=" + py::reprFromCpp(_form) + ", "
-					"tag=" + py::reprFromCpp(_tag) + ")";
+					"form=" + py::reprFromCpp(form()) + ", "
+					"tag=" + py::reprFromCpp(tag()) + ")";
 			}
 		}
 	}
@@ -1217,8 +2596,8 @@ py::TypeWrapper<TokenObject> _TokenSetter{ gModule, [](PyTypeObject& obj)
 {
 	static PyGetSetDef getsets[] =
 	{
-		{ (char*)"form", PY_GETTER(&TokenObject::_form), nullptr, "", nullptr },
-		{ (char*)"tag", PY_GETTER(&TokenObject::_tag), nullptr, "", nullptr},
+		{ (char*)"form", PY_GETTER(&TokenObject::form), nullptr, "", nullptr },
+		{ (char*)"tag", PY_GETTER(&TokenObject::tag), nullptr, "", nullptr},
 		{ (char*)"start", PY_GETTER(&TokenObject::_pos), nullptr, "", nullptr},
 		{ (char*)"len", PY_GETTER(&TokenObject::_len), nullptr, "", nullptr},
 		{ (char*)"end", PY_GETTER(&TokenObject::end), nullptr, "", nullptr},
@@ -1234,11 +2613,11 @@ py::TypeWrapper<TokenObject> _TokenSetter{ gModule, [](PyTypeObject& obj)
 		{ (char*)"form_tag", PY_GETTER(&TokenObject::formTag), nullptr, "", nullptr},
 		{ (char*)"score", PY_GETTER(&TokenObject::_score), nullptr, "", nullptr},
 		{ (char*)"typo_cost", PY_GETTER(&TokenObject::_typoCost), nullptr, "", nullptr},
-		{ (char*)"raw_form", PY_GETTER(&TokenObject::_raw_form), nullptr, "", nullptr},
+		{ (char*)"raw_form", PY_GETTER(&TokenObject::rawForm), nullptr, "", nullptr},
 		{ (char*)"regularity", PY_GETTER(&TokenObject::regularity), nullptr, "", nullptr},
 		{ (char*)"lemma", PY_GETTER(&TokenObject::lemma), nullptr, "", nullptr},
 		{ (char*)"paired_token", PY_GETTER(&TokenObject::_pairedToken), nullptr, "", nullptr},
-		{ (char*)"user_value", PY_GETTER(&TokenObject::_userValue), nullptr, "", nullptr},
+		{ (char*)"user_value", PY_GETTER(&TokenObject::userValue), nullptr, "", nullptr},
 		{ (char*)"script", PY_GETTER(&TokenObject::script), nullptr, "", nullptr},
 		{ (char*)"sense", PY_GETTER(&TokenObject::_sense), nullptr, "", nullptr},
 		{ nullptr },
@@ -1293,18 +2672,26 @@ inline const char* getTagStr(const POSTag tag, const u16string& form)
 	return tagToString(tag);
 }
 
-py::UniqueObj resToPyList(vector<TokenResult>&& res, const KiwiObject* kiwiObj, vector<py::UniqueObj>&& userValues = {})
+py::UniqueObj resToPyList(vector<TokenResult>&& res, const KiwiObject* kiwiObj, const std::shared_ptr<const Kiwi>& generation, vector<py::UniqueObj>&& userValues = {})
 {
-	auto& kiwi = kiwiObj->kiwi;
+	auto& kiwi = *generation;
 	// set the following objects semi-immortal. (they are neither freed nor managed)
 	// it prevents crashes at Python3.12
 	static PyObject* userValuesAttr = py::buildPyValue("_user_values").release();
-	static PyObject* tagAttr = py::buildPyValue("tag").release();
-	py::UniqueObj userValuesObj{ PyObject_GetAttr((PyObject*)kiwiObj, userValuesAttr) };
+	auto buffer = std::make_shared<TokenResultBuffer>();
+	buffer->results = move(res);
+	buffer->userValues = move(userValues);
+	buffer->kiwi = generation;
+	py::UniqueObj liveUserValues{ PyObject_GetAttr((PyObject*)kiwiObj, userValuesAttr) };
 	PyErr_Clear();
-	py::UniqueObj retList{ PyList_New(res.size()) };
+	if (liveUserValues && (!PyDict_Check(liveUserValues.get()) || PyDict_Size(liveUserValues.get()) == 0)) liveUserValues = py::UniqueObj{};
+	if (liveUserValues) buffer->userValuesDict = py::UniqueObj{ PyDict_New() };
+	// a pretokenized user value belongs only to the first token produced from its span
+	vector<bool> claimedUserValues(buffer->userValues.size());
+
+	py::UniqueObj retList{ PyList_New(buffer->results.size()) };
 	size_t idx = 0;
-	for (auto& p : res)
+	for (auto& p : buffer->results)
 	{
 		py::UniqueObj rList{ PyList_New(p.first.size()) };
 		size_t jdx = 0;
@@ -1319,11 +2706,11 @@ py::UniqueObj resToPyList(vector<TokenResult>&& res, const KiwiObject* kiwiObj,
 			}
 
 			auto tItem = py::makeNewObject<TokenObject>();
-			tItem->_form = move(q.str);
+			tItem->_buffer = buffer;
+			tItem->_info = &q;
 			tItem->_regularity = !isIrregular(q.tag);
 			tItem->_rawTag = q.tag;
 			tItem->resultHash = resultHash;
-			tItem->_tag = getTagStr(q.tag, tItem->_form);
 			tItem->_pos = q.position - u32offset;
 			tItem->_len = q.length - u32chrs;
 			tItem->_wordPosition = q.wordPosition;
@@ -1334,8 +2721,16 @@ py::UniqueObj resToPyList(vector<TokenResult>&& res, const KiwiObject* kiwiObj,
 			tItem->_typoCost = q.typoCost;
 			tItem->_morph = q.morph;
 			tItem->_morphId = q.morph ? kiwi.morphToId(q.morph) : -1;
+			if (liveUserValues && q.morph)
+			{
+				py::UniqueObj key = py::buildPyValue(tItem->_morphId);
+				if (auto v = PyDict_GetItem(liveUserValues.get(), key.get()))
+				{
+					PyDict_SetItem(buffer->userValuesDict.get(), key.get(), v);
+				}
+			}
 			tItem->_baseMorph = q.morph ? (q.morph->origMorphemeId ?  kiwi.idToMorph(q.morph->origMorphemeId) : q.morph) : nullptr;
-			tItem->_raw_form = q.typoCost ? kiwi.getTypoForm(q.typoFormId) : tItem->_form;
+			if (q.typoCost) tItem->_raw_form = kiwi.getTypoForm(q.typoFormId);
 			tItem->_pairedToken = q.pairedToken;
 			if (q.tag == POSTag::sl || q.tag == POSTag::sh || q.tag == POSTag::sw || q.tag == POSTag::w_emoji)
 			{
@@ -1346,25 +2741,11 @@ py::UniqueObj resToPyList(vector<TokenResult>&& res, const KiwiObject* kiwiObj,
 				tItem->_sense = q.senseId;
 			}
 
-			if (!q.typoCost && q.typoFormId && userValues[q.typoFormId - 1])
+			if (!q.typoCost && q.typoFormId && q.typoFormId <= claimedUserValues.size() 
+				&& buffer->userValues[q.typoFormId - 1] && !claimedUserValues[q.typoFormId - 1])
 			{
-				tItem->_userValue = move(userValues[q.typoFormId - 1]);
-			}
-			else
-			{
-				tItem->_userValue = py::UniqueObj{ userValuesObj ? PyDict_GetItem(userValuesObj.get(), py::buildPyValue(tItem->_morphId).get()) : nullptr };
-				if (!tItem->_userValue) tItem->_userValue = py::UniqueObj{ Py_None };
-				Py_INCREF(tItem->_userValue.get());
-			}
-
-			if (PyDict_Check(tItem->_userValue.get()))
-			{
-				// tag override
-				auto v = PyDict_GetItem(tItem->_userValue.get(), tagAttr);
-				if (v)
-				{
-					tItem->_tag = PyUnicode_AsUTF8(v);
-				}
+				claimedUserValues[q.typoFormId - 1] = true;
+				tItem->_userValueSlot = q.typoFormId - 1;
 			}
 
 			PyList_SET_ITEM(rList.get(), jdx++, (PyObject*)tItem.release());
@@ -1375,6 +2756,194 @@ py::UniqueObj resToPyList(vector<TokenResult>&& res, const KiwiObject* kiwiObj,
 	return retList;
 }
 
+/**
+ * @brief Converts analysis results into struct-of-arrays form without creating any `Token` objects.
+ * Each candidate becomes `(arrays, score)` where `arrays` is a tuple of
+ * (id, tag, start, len, word_position, sent_position, sub_sent_position, score, typo_cost, form, form_offsets).
+ */
+py::UniqueObj resToPyArrays(vector<TokenResult>&& res, const Kiwi& kiwi)
+{
+	py::UniqueObj retList{ PyList_New(res.size()) };
+	size_t idx = 0;
+	for (auto& p : res)
+	{
+		npy_intp size = p.first.size(), offsetSize = size + 1;
+		py::UniqueObj ids{ PyArray_EMPTY(1, &size, NPY_INT64, 0) };
+		py::UniqueObj tags{ PyArray_EMPTY(1, &size, NPY_UINT8, 0) };
+		py::UniqueObj starts{ PyArray_EMPTY(1, &size, NPY_UINT32, 0) };
+		py::UniqueObj lens{ PyArray_EMPTY(1, &size, NPY_UINT32, 0) };
+		py::UniqueObj wordPositions{ PyArray_EMPTY(1, &size, NPY_UINT32, 0) };
+		py::UniqueObj sentPositions{ PyArray_EMPTY(1, &size, NPY_UINT32, 0) };
+		py::UniqueObj subSentPositions{ PyArray_EMPTY(1, &size, NPY_UINT32, 0) };
+		py::UniqueObj scores{ PyArray_EMPTY(1, &size, NPY_FLOAT32, 0) };
+		py::UniqueObj typoCosts{ PyArray_EMPTY(1, &size, NPY_FLOAT32, 0) };
+		py::UniqueObj formOffsets{ PyArray_EMPTY(1, &offsetSize, NPY_UINT32, 0) };
+		auto* idData = (int64_t*)PyArray_DATA((PyArrayObject*)ids.get());
+		auto* tagData = (uint8_t*)PyArray_DATA((PyArrayObject*)tags.get());
+		auto* startData = (uint32_t*)PyArray_DATA((PyArrayObject*)starts.get());
+		auto* lenData = (uint32_t*)PyArray_DATA((PyArrayObject*)lens.get());
+		auto* wordPosData = (uint32_t*)PyArray_DATA((PyArrayObject*)wordPositions.get());
+		auto* sentPosData = (uint32_t*)PyArray_DATA((PyArrayObject*)sentPositions.get());
+		auto* subSentPosData = (uint32_t*)PyArray_DATA((PyArrayObject*)subSentPositions.get());
+		auto* scoreData = (float*)PyArray_DATA((PyArrayObject*)scores.get());
+		auto* typoCostData = (float*)PyArray_DATA((PyArrayObject*)typoCosts.get());
+		auto* formOffsetData = (uint32_t*)PyArray_DATA((PyArrayObject*)formOffsets.get());
+
+		u16string forms;
+		size_t u32offset = 0, formU32offset = 0;
+		for (size_t i = 0; i < p.first.size(); ++i)
+		{
+			auto& q = p.first[i];
+			size_t u32chrs = 0;
+			for (auto u : q.str)
+			{
+				if ((u & 0xFC00) == 0xD800) u32chrs++;
+			}
+			idData[i] = q.morph ? (int64_t)kiwi.morphToId(q.morph) : -1;
+			tagData[i] = (uint8_t)q.tag;
+			startData[i] = q.position - u32offset;
+			lenData[i] = q.length - u32chrs;
+			wordPosData[i] = q.wordPosition;
+			sentPosData[i] = q.sentPosition;
+			subSentPosData[i] = q.subSentPosition;
+			scoreData[i] = q.score;
+			typoCostData[i] = q.typoCost;
+			formOffsetData[i] = forms.size() - formU32offset;
+			forms += q.str;
+			u32offset += u32chrs;
+			formU32offset += u32chrs;
+		}
+		formOffsetData[size] = forms.size() - formU32offset;
+
+		auto arrays = py::buildPyTuple(ids, tags, starts, lens, wordPositions, sentPositions, subSentPositions, scores, typoCosts, forms, formOffsets);
+		PyList_SET_ITEM(retList.get(), idx++, py::buildPyTuple(move(arrays), p.second).release());
+	}
+	return retList;
+}
+
+/**
+ * @brief Splits the best result into sentences, slicing their texts from `input`, the analyzed `str`.
+ * 
+ * Returns a list of `Sentence`s, or with `AnalyzeOutput::sentenceSpans` an `(N, 2)` array of the sentence spans 
+ * which may come with the token arrays of `resToPyArrays` if `AnalyzeOutput::arrays` is also given. 
+ * Sub-sentences are formed as in the former Python implementation: consecutive tokens sharing a non-zero `subSentPosition`.
+ */
+py::UniqueObj resToPySentences(vector<TokenResult>&& res, PyObject* input, AnalyzeOutput output, 
+	const KiwiObject* kiwiObj, const std::shared_ptr<const Kiwi>& generation, vector<py::UniqueObj>&& userValues = {})
+{
+	static PyObject* sentenceTypeAttr = py::buildPyValue("_sentence_type").release();
+	if (res.empty()) res.emplace_back();
+	if (res.size() > 1) res.erase(res.begin() + 1, res.end());
+
+	// offsets in code points as `resToPyList` computes them, since they are gone after `res` is handed over
+	const auto& tokens = res[0].first;
+	const size_t numTokens = tokens.size();
+	vector<uint32_t> starts(numTokens), ends(numTokens), subSentPositions(numTokens);
+	vector<size_t> sentBegins;
+	size_t u32offset = 0;
+	for (size_t i = 0; i < numTokens; ++i)
+	{
+		auto& q = tokens[i];
+		size_t u32chrs = 0;
+		for (auto u : q.str)
+		{
+			if ((u & 0xFC00) == 0xD800) u32chrs++;
+		}
+		starts[i] = q.position - u32offset;
+		ends[i] = starts[i] + q.length - u32chrs;
+		subSentPositions[i] = q.subSentPosition;
+		if (!i || q.sentPosition != tokens[i - 1].sentPosition) sentBegins.emplace_back(i);
+		u32offset += u32chrs;
+	}
+	sentBegins.emplace_back(numTokens);
+	const size_t numSents = sentBegins.size() - 1;
+
+	if (output & AnalyzeOutput::sentenceSpans)
+	{
+		npy_intp dims[2] = { (npy_intp)numSents, 2 };
+		py::UniqueObj spans{ PyArray_EMPTY(2, dims, NPY_UINT32, 0) };
+		auto* data = (uint32_t*)PyArray_DATA((PyArrayObject*)spans.get());
+		for (size_t s = 0; s < numSents; ++s)
+		{
+			data[s * 2] = starts[sentBegins[s]];
+			data[s * 2 + 1] = ends[sentBegins[s + 1] - 1];
+		}
+		if (!(output & AnalyzeOutput::arrays)) return spans;
+		auto candidates = resToPyArrays(move(res), *generation);
+		py::UniqueObj arrays{ PyTuple_GET_ITEM(PyList_GET_ITEM(candidates.get(), 0), 0) };
+		Py_INCREF(arrays.get());
+		return py::buildPyTuple(move(spans), move(arrays));
+	}
+
+	py::UniqueObj sentenceType{ PyObject_GetAttr((PyObject*)kiwiObj, sentenceTypeAttr) };
+	if (!sentenceType) throw py::ExcPropagation{};
+	if (!PyType_Check(sentenceType.get()) || !PyType_IsSubtype((PyTypeObject*)sentenceType.get(), &PyTuple_Type))
+	{
+		throw py::ValueError{ "`_sentence_type` must be a subclass of `tuple`." };
+	}
+	auto* type = (PyTypeObject*)sentenceType.get();
+
+	py::UniqueObj tokenList;
+	if (output & AnalyzeOutput::sentenceTokens)
+	{
+		auto results = resToPyList(move(res), kiwiObj, generation, move(userValues));
+		tokenList = py::UniqueObj{ PyTuple_GET_ITEM(PyList_GET_ITEM(results.get(), 0), 0) };
+		Py_INCREF(tokenList.get());
+	}
+
+	// `Sentence` is a namedtuple, so it is filled like a plain tuple
+	auto makeSentence = [&](size_t b, size_t e, py::UniqueObj&& subs)
+	{
+		py::UniqueObj text{ PyUnicode_Substring(input, starts[b], ends[e - 1]) };
+		if (!text) throw py::ExcPropagation{};
+		py::UniqueObj sentTokens;
+		if (tokenList)
+		{
+			sentTokens = py::UniqueObj{ PyList_GetSlice(tokenList.get(), b, e) };
+		}
+		else
+		{
+			sentTokens = py::UniqueObj{ Py_None };
+			Py_INCREF(Py_None);
+		}
+		if (!subs)
+		{
+			subs = py::UniqueObj{ Py_None };
+			Py_INCREF(Py_None);
+		}
+		py::UniqueObj ret{ type->tp_alloc(type, 5) };
+		if (!ret) throw py::ExcPropagation{};
+		PyTuple_SET_ITEM(ret.get(), 0, text.release());
+		PyTuple_SET_ITEM(ret.get(), 1, py::buildPyValue(starts[b]).release());
+		PyTuple_SET_ITEM(ret.get(), 2, py::buildPyValue(ends[e - 1]).release());
+		PyTuple_SET_ITEM(ret.get(), 3, sentTokens.release());
+		PyTuple_SET_ITEM(ret.get(), 4, subs.release());
+		return ret;
+	};
+
+	py::UniqueObj ret{ PyList_New(numSents) };
+	for (size_t s = 0; s < numSents; ++s)
+	{
+		const size_t b = sentBegins[s], e = sentBegins[s + 1];
+		py::UniqueObj subs;
+		if (output & AnalyzeOutput::subSentences)
+		{
+			subs = py::UniqueObj{ PyList_New(0) };
+			uint32_t last = 0;
+			size_t subBegin = b;
+			for (size_t i = b; i < e; ++i)
+			{
+				if (subSentPositions[i] == last) continue;
+				if (last && PyList_Append(subs.get(), makeSentence(subBegin, i, {}).get())) throw py::ExcPropagation{};
+				subBegin = i;
+				last = subSentPositions[i];
+			}
+		}
+		PyList_SET_ITEM(ret.get(), s, makeSentence(b, e, move(subs)).release());
+	}
+	return ret;
+}
+
 inline POSTag parseTag(const char* tag)
 {
 	auto u16 = utf8To16(tag);
@@ -1427,7 +2996,7 @@ struct MorphemeSetObject : py::CObject<MorphemeSetObject>
 				{
 					tag = parseTag(stag.c_str());
 				}
-				auto m = kiwi->kiwi.findMorpheme(utf8To16(form), tag);
+				auto m = kiwi->kiwi->findMorpheme(utf8To16(form), tag);
 				morphSet.insert(m.begin(), m.end());
 			}
 			else
@@ -1491,6 +3060,8 @@ struct SwTokenizerObject : py::CObject<SwTokenizerObject>
 	static constexpr int _flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE;
 
 	py::UniqueCObj<KiwiObject> kiwi;
+	// the generation `tokenizer` refers to
+	std::shared_ptr<Kiwi> generation;
 	kiwi::SwTokenizer tokenizer;
 
 	using _InitArgs = std::tuple<py::UniqueCObj<KiwiObject>, const char*>;
@@ -1501,8 +3072,9 @@ struct SwTokenizerObject : py::CObject<SwTokenizerObject>
 	{
 		kiwi = std::move(_kiwi);
 		kiwi->doPrepare();
+		generation = kiwi->kiwi;
 		std::ifstream ifs;
-		tokenizer = kiwi::SwTokenizer::load(kiwi->kiwi, openFile(ifs, path));
+		tokenizer = kiwi::SwTokenizer::load(*generation, openFile(ifs, path));
 	}
 
 	void save(const char* path) const
@@ -1511,14 +3083,22 @@ struct SwTokenizerObject : py::CObject<SwTokenizerObject>
 		tokenizer.save(openFile(ofs, path));
 	}
 
-	py::UniqueObj encode(PyObject* text, bool returnOffsets = false) const;
+	py::UniqueObj encode(PyObject* text, bool returnOffsets = false, bool ordered = true) const;
+
+	py::UniqueObj encodeBatch(PyObject* texts, size_t maxLength, bool padToMaxLength, bool truncation, uint32_t padId) const;
 
 	py::UniqueObj encodeFromMorphs(PyObject* morphs, bool returnOffsets = false) const;
 
+	py::UniqueObj encodeFromMorphArrays(PyObject* arrays, bool returnOffsets = false) const;
+
+	py::UniqueObj encodeFromMorphArraysBatch(PyObject* batch, bool returnOffsets = false) const;
+
 	py::UniqueObj tokenizeAndEncode(PyObject* text, bool returnOffsets = false) const;
 
 	std::string decode(PyObject* ids, bool ignoreErrors = true) const;
 
+	py::UniqueObj decodeBatch(PyObject* ids, std::optional<int64_t> padId, bool ignoreErrors = true) const;
+
 	py::UniqueObj config()
 	{
 		py::UniqueObj ret{ PyDict_New() };
@@ -1628,7 +3208,7 @@ struct SwTokenizerObject : py::CObject<SwTokenizerObject>
 		trainCfg.preventMixedDigitTokens = !!preventMixedDigitTokens;
 		
 		kiwi->doPrepare();
-		UnigramSwTrainer trainer{ kiwi->kiwi, cfg, trainCfg };
+		UnigramSwTrainer trainer{ *kiwi->kiwi, cfg, trainCfg };
 		py::UniqueObj methodNames[] {
 			py::buildPyValue("begin_tokenization"),
 			py::buildPyValue("proc_tokenization"),
@@ -1768,9 +3348,13 @@ py::TypeWrapper<SwTokenizerObject> _SwTokenizerSetter{ gModule, [](PyTypeObject&
 	static PyMethodDef methods[] =
 	{
 		{ "encode", PY_METHOD(&SwTokenizerObject::encode), METH_VARARGS | METH_KEYWORDS, ""},
+		{ "_encode_batch", PY_METHOD(&SwTokenizerObject::encodeBatch), METH_VARARGS | METH_KEYWORDS, ""},
 		{ "encode_from_morphs", PY_METHOD(&SwTokenizerObject::encodeFromMorphs), METH_VARARGS | METH_KEYWORDS, ""},
+		{ "_encode_from_morph_arrays", PY_METHOD(&SwTokenizerObject::encodeFromMorphArrays), METH_VARARGS | METH_KEYWORDS, ""},
+		{ "_encode_from_morph_arrays_batch", PY_METHOD(&SwTokenizerObject::encodeFromMorphArraysBatch), METH_VARARGS | METH_KEYWORDS, ""},
 		{ "tokenize_encode", PY_METHOD(&SwTokenizerObject::tokenizeAndEncode), METH_VARARGS | METH_KEYWORDS, ""},
 		{ "decode", PY_METHOD(&SwTokenizerObject::decode), METH_VARARGS | METH_KEYWORDS, ""},
+		{ "_decode_batch", PY_METHOD(&SwTokenizerObject::decodeBatch), METH_VARARGS | METH_KEYWORDS, ""},
 		{ "_train", PY_METHOD(&SwTokenizerObject::train), METH_VARARGS | METH_KEYWORDS | METH_STATIC, ""},
 		{ "save", PY_METHOD(&SwTokenizerObject::save), METH_VARARGS | METH_KEYWORDS, ""},
 		{ nullptr }
@@ -1919,6 +3503,104 @@ inline pair<vector<PretokenizedSpan>, vector<py::UniqueObj>> makePretokenizedSpa
 	return make_pair(move(ret), move(userValues));
 }
 
+/**
+ * @brief Completes the pretokenized spans of an input with the matches of `reWords` and `overlay`. Runs without the GIL.
+ * 
+ * Spans given from Python take precedence over the native patterns, among which a later pattern wins as in `makePretokenizedSpans`.
+ * Overlay words only fill the gaps left by them.
+ * Returns for each resulting span the index of the given span it came from, -1 if it has no user value, 
+ * or `-2 - p` if it came from the `p`-th native pattern. Nothing is returned if `spans` is left unchanged.
+ */
+inline vector<int32_t> completePretokenizedSpans(const NativeReWords* reWords, const UserOverlay* overlay, const u16string& text, vector<PretokenizedSpan>& spans)
+{
+	vector<PretokenizedSpan> found, overlaid;
+	vector<size_t> patternIds;
+	if (reWords) reWords->match(text, found, patternIds);
+	if (overlay) overlay->match(text, overlaid);
+	if (found.empty() && overlaid.empty()) return {};
+
+	// (span, precedence, origin)
+	vector<tuple<PretokenizedSpan, size_t, int32_t>> merged;
+	merged.reserve(spans.size() + found.size() + overlaid.size());
+	for (size_t i = 0; i < spans.size(); ++i) merged.emplace_back(move(spans[i]), SIZE_MAX, (int32_t)i);
+	for (size_t i = 0; i < found.size(); ++i) merged.emplace_back(move(found[i]), patternIds[i], -2 - (int32_t)patternIds[i]);
+	stable_sort(merged.begin(), merged.end(), [](auto&& a, auto&& b) { return get<0>(a).begin < get<0>(b).begin; });
+
+	if (!merged.empty())
+	{
+		size_t target = 0;
+		for (size_t cursor = 1; cursor < merged.size(); ++cursor)
+		{
+			// spans of the same precedence never overlap, except those given by the caller which are passed through as before
+			if (get<0>(merged[target]).end > get<0>(merged[cursor]).begin && get<1>(merged[target]) != get<1>(merged[cursor]))
+			{
+				if (get<1>(merged[target]) < get<1>(merged[cursor])) merged[target] = move(merged[cursor]);
+			}
+			else
+			{
+				++target;
+				if (target != cursor) merged[target] = move(merged[cursor]);
+			}
+		}
+		merged.erase(merged.begin() + target + 1, merged.end());
+	}
+
+	if (!overlaid.empty())
+	{
+		const size_t kept = merged.size();
+		for (auto& f : overlaid)
+		{
+			auto it = std::partition_point(merged.begin(), merged.begin() + kept, [&](auto&& m) { return get<0>(m).end <= f.begin; });
+			bool overlapped = false;
+			for (; it != merged.begin() + kept && get<0>(*it).begin < f.end && !overlapped; ++it)
+			{
+				overlapped = get<0>(*it).end > f.begin;
+			}
+			if (!overlapped) merged.emplace_back(move(f), 0, -1);
+		}
+		stable_sort(merged.begin(), merged.end(), [](auto&& a, auto&& b) { return get<0>(a).begin < get<0>(b).begin; });
+	}
+
+	spans.clear();
+	vector<int32_t> origins;
+	origins.reserve(merged.size());
+	for (auto& m : merged)
+	{
+		spans.emplace_back(move(get<0>(m)));
+		origins.emplace_back(get<2>(m));
+	}
+	return origins;
+}
+
+/**
+ * @brief Lays out the user values of the spans returned by `completePretokenizedSpans`.
+ * `reWordValues` is the tuple of the user values of the native patterns.
+ */
+inline vector<py::UniqueObj> resolveUserValues(vector<py::UniqueObj>&& given, const vector<int32_t>& origins, PyObject* reWordValues)
+{
+	if (origins.empty()) return move(given);
+	vector<py::UniqueObj> ret;
+	ret.reserve(origins.size());
+	for (auto o : origins)
+	{
+		if (o >= 0)
+		{
+			ret.emplace_back(move(given[o]));
+		}
+		else if (o == -1 || !reWordValues || PyTuple_GET_ITEM(reWordValues, -2 - o) == Py_None)
+		{
+			ret.emplace_back();
+		}
+		else
+		{
+			PyObject* v = PyTuple_GET_ITEM(reWordValues, -2 - o);
+			Py_INCREF(v);
+			ret.emplace_back(v);
+		}
+	}
+	return ret;
+}
+
 inline void updatePretokenizedSpanToU16(vector<PretokenizedSpan>& spans, const py::StringWithOffset<u16string>& so)
 {
 	for (auto& s : spans)
@@ -1938,36 +3620,316 @@ inline void updatePretokenizedSpanToU16(vector<PretokenizedSpan>& spans, const p
 	}
 }
 
-template<class FutureTy, class CarriedTy>
-struct FutureCarrier
+/**
+ * @brief Whitespace as Python's `str.isspace` and `\s` see it.
+ */
+inline bool isPySpace(char16_t c)
+{
+	return (0x09 <= c && c <= 0x0D) || (0x1C <= c && c <= 0x20) || c == 0x85 || c == 0xA0 || c == 0x1680
+		|| (0x2000 <= c && c <= 0x200A) || c == 0x2028 || c == 0x2029 || c == 0x202F || c == 0x205F || c == 0x3000;
+}
+
+/**
+ * @brief Removes whitespace between a Hangul syllable and a following Hangul syllable or punctuation, for `reset_whitespace` of `Kiwi.space`.
+ */
+inline u16string removeHangulWhitespace(const u16string& text)
+{
+	u16string ret;
+	ret.reserve(text.size());
+	for (size_t i = 0; i < text.size();)
+	{
+		if (!isPySpace(text[i]) || ret.empty() || !isHangulSyllable(ret.back()))
+		{
+			ret.push_back(text[i++]);
+			continue;
+		}
+		size_t e = i;
+		while (e < text.size() && isPySpace(text[e])) ++e;
+		const bool attach = e < text.size() && (isHangulSyllable(text[e]) || u16string_view{ u".,?!:;" }.find(text[e]) != u16string_view::npos);
+		if (!attach) ret.append(text, i, e - i);
+		i = e;
+	}
+	return ret;
+}
+
+/**
+ * @brief The spacing rules of `Kiwi.space`, precomputed for every pair of tags.
+ * 
+ * Tags are looked up without their irregular bit, since the rules only test prefixes of the tag names.
+ */
+class SpacingRules
 {
-	std::future<FutureTy> future;
-	CarriedTy carried;
+	static constexpr size_t numTags = (size_t)POSTag::max;
+	// a space goes between a morpheme tagged with the row and the next one tagged with the column
+	std::array<std::array<bool, numTags>, numTags> insertable{};
+	// a morpheme with this tag is attached to the previous one, removing the whitespace between them
+	std::array<bool, numTags> attaching{};
+
+	static bool startsWith(const char* s, std::initializer_list<const char*> prefixes)
+	{
+		for (auto p : prefixes)
+		{
+			if (!strncmp(s, p, strlen(p))) return true;
+		}
+		return false;
+	}
+
+	static bool matchesRules(const char* prev, const char* next)
+	{
+		if ((!strchr("SUWX", prev[0]) || startsWith(prev, { "XR", "XS", "SE", "SH" }))
+			&& startsWith(next, { "N", "M", "I", "VV", "VA", "VX", "VCN", "XR", "XPN", "SW", "SL", "SH", "SN" })) return true;
+		if (!strcmp(prev, "SN")
+			&& startsWith(next, { "M", "I", "NP", "NR", "NNG", "NNP", "VV", "VA", "VX", "VCN", "XR", "XPN", "SW", "SH" })) return true;
+		if (startsWith(prev, { "SF", "SP", "SL" })
+			&& startsWith(next, { "N", "M", "I", "VV", "VA", "VX", "VCN", "XR", "XPN", "SW", "SH" })) return true;
+		return false;
+	}
 
-	FutureCarrier(std::future<FutureTy>&& _future, const CarriedTy& _carried)
-		: future{std::move(_future)}, carried{_carried}
-	{}
+	SpacingRules()
+	{
+		for (size_t p = 0; p < numTags; ++p)
+		{
+			const char* prev = tagToString((POSTag)p);
+			attaching[p] = startsWith(prev, { "E", "J", "XS" });
+			for (size_t n = 0; n < numTags; ++n)
+			{
+				insertable[p][n] = matchesRules(prev, tagToString((POSTag)n));
+			}
+		}
+	}
 
-	FutureCarrier(std::future<FutureTy>&& _future, CarriedTy&& _carried)
-		: future{ std::move(_future) }, carried{ std::move(_carried) }
-	{}
+public:
+	static const SpacingRules& get()
+	{
+		static const SpacingRules rules;
+		return rules;
+	}
 
-	FutureCarrier(FutureCarrier&&) = default;
-	FutureCarrier& operator=(FutureCarrier&&) = default;
+	bool isInsertable(POSTag prev, POSTag next) const
+	{
+		const size_t p = (size_t)clearIrregular(prev), n = (size_t)clearIrregular(next);
+		return p < numTags && n < numTags && insertable[p][n];
+	}
 
-	std::pair<FutureTy, CarriedTy> get()
+	bool isAttaching(POSTag tag) const
 	{
-		return std::make_pair(future.get(), std::move(carried));
+		const size_t t = (size_t)clearIrregular(tag);
+		return t < numTags && attaching[t];
 	}
 };
 
-template<class FutureTy, class CarriedTy>
-auto makeFutureCarrier(std::future<FutureTy>&& future, CarriedTy&& carried)
+/**
+ * @brief Rebuilds `text` with the spacing `Kiwi.space` derives from `tokens`, the best analysis of `text`.
+ */
+inline u16string spaceByTokens(const u16string& text, const vector<TokenInfo>& tokens)
 {
-	return FutureCarrier<FutureTy, std::remove_reference_t<CarriedTy>>{ std::move(future), std::forward<CarriedTy>(carried) };
+	auto& rules = SpacingRules::get();
+	u16string ret;
+	ret.reserve(text.size() + text.size() / 4);
+	auto appendWithoutSpace = [&](size_t b, size_t e)
+	{
+		for (size_t i = b; i < e; ++i)
+		{
+			if (!isPySpace(text[i])) ret.push_back(text[i]);
+		}
+	};
+
+	size_t last = 0;
+	const TokenInfo* prev = nullptr;
+	for (size_t i = 0; i < tokens.size(); ++i)
+	{
+		auto& t = tokens[i];
+		const size_t start = t.position, end = t.position + t.length;
+		// the auxiliary verbs `하다/지다` are attached to the previous word
+		const bool auxHaJi = t.tag == POSTag::vx && (t.str.empty() || t.str == u"하" || t.str == u"지" || t.str == u"하지");
+		if (last < start)
+		{
+			if (rules.isAttaching(t.tag) || auxHaJi || (prev && prev->tag == POSTag::sn && t.tag == POSTag::nnb)) appendWithoutSpace(last, start);
+			else ret.append(text, last, start - last);
+			last = start;
+		}
+		// a space is inserted only where there is none yet
+		if (prev && !auxHaJi && rules.isInsertable(prev->tag, t.tag) && !ret.empty() && !isPySpace(ret.back()))
+		{
+			ret.push_back(u' ');
+		}
+		if (last < end)
+		{
+			const auto tag = clearIrregular(t.tag);
+			const bool isNoun = tag == POSTag::nng || tag == POSTag::nnp || tag == POSTag::nnb;
+			if (isNoun && (i + 1 >= tokens.size() || end <= tokens[i + 1].position)) ret += t.str;
+			else appendWithoutSpace(last, end);
+		}
+		last = end;
+		prev = &t;
+	}
+	if (last < text.size()) ret.append(text, last);
+	return ret;
 }
 
-struct KiwiResIter : public py::ResultIter<KiwiResIter, vector<TokenResult>, FutureCarrier<vector<TokenResult>, vector<py::UniqueObj>>>
+/**
+ * @brief A group of consecutive short inputs which is analyzed by a single task of the thread pool.
+ * 
+ * Inputs are collected on the Python thread and the batch is submitted either when it is full, 
+ * when the pool has an idle worker, or when a result of the batch is waited for.
+ */
+struct AnalyzeBatch
+{
+	std::shared_ptr<const Kiwi> kiwi;
+	utils::ThreadPool* pool = nullptr;
+	std::shared_ptr<std::atomic<size_t>> inflight;
+	size_t topN = 1;
+	Match matchOptions = Match::all;
+	const std::unordered_set<const Morpheme*>* blocklist = nullptr;
+	std::shared_ptr<const NativeReWords> reWords;
+	std::shared_ptr<const UserOverlay> overlay;
+	AnalyzeOutput output = AnalyzeOutput::tokens;
+	std::shared_ptr<py::CompletionSignal> completion;
+
+	struct Result
+	{
+		vector<TokenResult> results;
+		// the origins of the spans from `completePretokenizedSpans`
+		vector<int32_t> origins;
+		// filled instead of `results` with `AnalyzeOutput::spaced`
+		u16string spaced;
+	};
+
+	vector<u16string> texts;
+	vector<vector<PretokenizedSpan>> spans;
+	size_t numChars = 0;
+	std::future<vector<Result>> future;
+	vector<Result> results;
+	bool submitted = false, retrieved = false;
+
+	void submit()
+	{
+		if (submitted) return;
+		submitted = true;
+		++*inflight;
+		auto run = [kiwi = kiwi, running = markRunning(kiwi), inflight = inflight, topN = topN, 
+			matchOptions = matchOptions, blocklist = blocklist, reWords = reWords, overlay = overlay, output = output,
+			texts = move(texts), spans = move(spans)](size_t)
+		{
+			struct InflightGuard
+			{
+				std::atomic<size_t>& counter;
+				~InflightGuard() { --counter; }
+			} guard{ *inflight };
+
+			vector<Result> ret;
+			ret.reserve(texts.size());
+			for (size_t i = 0; i < texts.size(); ++i)
+			{
+				u16string reset;
+				if (output & AnalyzeOutput::resetWhitespace) reset = removeHangulWhitespace(texts[i]);
+				const u16string& text = (output & AnalyzeOutput::resetWhitespace) ? reset : texts[i];
+				auto textSpans = spans[i];
+				auto origins = completePretokenizedSpans(reWords.get(), overlay.get(), text, textSpans);
+				auto res = kiwi->analyze(text, topN, matchOptions, blocklist, textSpans);
+				if (output & AnalyzeOutput::spaced)
+				{
+					ret.push_back(Result{ {}, {}, res.empty() ? text : spaceByTokens(text, res[0].first) });
+				}
+				else
+				{
+					ret.push_back(Result{ move(res), move(origins), {} });
+				}
+			}
+			return ret;
+		};
+
+		if (pool)
+		{
+			future = enqueueSignalled<vector<Result>>(*pool, completion, [run = move(run)](size_t threadId)
+			{
+				tlsOnKiwiWorker = true;
+				return run(threadId);
+			});
+			return;
+		}
+
+		// without a thread pool the batch is analyzed right away on the calling thread
+		std::promise<vector<Result>> promise;
+		try
+		{
+			py::ReleaseGIL gil;
+			promise.set_value(run(0));
+		}
+		catch (...)
+		{
+			promise.set_exception(std::current_exception());
+		}
+		future = promise.get_future();
+	}
+
+	Result get(size_t idx)
+	{
+		submit();
+		if (!retrieved)
+		{
+			{
+				py::ReleaseGIL gil;
+				future.wait();
+			}
+			results = future.get();
+			retrieved = true;
+		}
+		return move(results[idx]);
+	}
+
+	template<class Rep, class Period>
+	std::future_status wait_for(const std::chrono::duration<Rep, Period>& timeout)
+	{
+		if (retrieved) return std::future_status::ready;
+		if (!submitted)
+		{
+			// a plain readiness check must not force the batch out early
+			if (timeout.count() <= 0) return std::future_status::timeout;
+			submit();
+		}
+		return future.wait_for(timeout);
+	}
+};
+
+struct AnalyzedInput
+{
+	vector<TokenResult> results;
+	vector<py::UniqueObj> userValues;
+	// kept only when sentence texts are sliced from it
+	py::SharedObj input;
+	u16string spaced;
+};
+
+struct AnalyzeBatchSlot
+{
+	std::shared_ptr<AnalyzeBatch> batch;
+	size_t idx = 0;
+	vector<py::UniqueObj> carried;
+	py::SharedObj input;
+	// borrowed from the iterator which owns the slot
+	PyObject* reWordValues = nullptr;
+
+	AnalyzedInput get()
+	{
+		auto res = batch->get(idx);
+		return AnalyzedInput{ move(res.results), resolveUserValues(move(carried), res.origins, reWordValues), move(input), move(res.spaced) };
+	}
+
+	template<class Rep, class Period>
+	std::future_status wait_for(const std::chrono::duration<Rep, Period>& timeout) const
+	{
+		return batch->wait_for(timeout);
+	}
+
+	// false while the batch is still collecting inputs, which `wait_for(0)` reports as not ready
+	bool isSubmitted() const
+	{
+		return batch->submitted;
+	}
+};
+
+struct KiwiResIter : public py::ResultIter<KiwiResIter, vector<TokenResult>, AnalyzeBatchSlot>
 {
 	static constexpr const char* _name = "kiwipiepy._ResIter";
 	static constexpr const char* _name_in_module = "_ResIter";
@@ -1977,6 +3939,16 @@ struct KiwiResIter : public py::ResultIter<KiwiResIter, vector<TokenResult>, Fut
 	py::UniqueObj pretokenizedCallable;
 	size_t topN = 1;
 	Match matchOptions = Match::all;
+	AnalyzeOutput output = AnalyzeOutput::tokens;
+	size_t microBatchChars = 0;
+	std::shared_ptr<AnalyzeBatch> pendingBatch;
+	std::shared_ptr<std::atomic<size_t>> inflight = std::make_shared<std::atomic<size_t>>(0);
+	// the model generation, the overlay and the native patterns at the time of the call are used for all inputs, 
+	// regardless of words added or models swapped later
+	std::shared_ptr<Kiwi> generation;
+	std::shared_ptr<const UserOverlay> overlay;
+	std::shared_ptr<const NativeReWords> reWords;
+	py::UniqueObj reWordValues;
 
 	KiwiResIter() = default;
 	KiwiResIter(KiwiResIter&&) = default;
@@ -1987,15 +3959,41 @@ struct KiwiResIter : public py::ResultIter<KiwiResIter, vector<TokenResult>, Fut
 		waitQueue();
 	}
 
-	py::UniqueObj buildPy(pair<vector<TokenResult>, vector<py::UniqueObj>>&& v)
+	py::UniqueObj buildPy(AnalyzedInput&& v)
 	{
 		return py::handleExc([&]()
 		{
-			if (v.first.size() > topN) v.first.erase(v.first.begin() + topN, v.first.end());
-			return resToPyList(move(v.first), kiwi.get(), move(v.second));
+			if (output & AnalyzeOutput::spaced) return py::buildPyValue(v.spaced);
+			if (v.results.size() > topN) v.results.erase(v.results.begin() + topN, v.results.end());
+			if (output & AnalyzeOutput::sentences) return resToPySentences(move(v.results), v.input.get(), output, kiwi.get(), generation, move(v.userValues));
+			if (output & AnalyzeOutput::arrays) return resToPyArrays(move(v.results), *generation);
+			return resToPyList(move(v.results), kiwi.get(), generation, move(v.userValues));
 		});
 	}
 
+	std::shared_ptr<AnalyzeBatch> newBatch()
+	{
+		auto batch = std::make_shared<AnalyzeBatch>();
+		batch->kiwi = generation;
+		batch->pool = kiwi->threadPool(*generation);
+		batch->inflight = inflight;
+		batch->topN = topN;
+		batch->matchOptions = matchOptions;
+		batch->blocklist = blocklist ? &blocklist->morphSet : nullptr;
+		batch->reWords = reWords;
+		batch->overlay = overlay;
+		batch->output = output;
+		batch->completion = completion;
+		return batch;
+	}
+
+	void flush()
+	{
+		if (!pendingBatch) return;
+		pendingBatch->submit();
+		pendingBatch.reset();
+	}
+
 	FutureTy feedNext(py::SharedObj&& next)
 	{
 		if (!PyUnicode_Check(next)) throw py::ValueError{ "`analyze` requires an instance of `str` or an iterable of `str`." };
@@ -2006,6 +4004,10 @@ struct KiwiResIter : public py::ResultIter<KiwiResIter, vector<TokenResult>, Fut
 			py::UniqueObj ptResult{ PyObject_CallFunctionObjArgs(pretokenizedCallable.get(), next.get(), nullptr) };
 			pretokenized = makePretokenizedSpans(ptResult.get());
 		}
+		if ((output & AnalyzeOutput::resetWhitespace) && !pretokenized.first.empty())
+		{
+			throw py::ValueError{ "`pretokenized` cannot be used with resetting whitespace." };
+		}
 		py::StringWithOffset<u16string> so;
 		if (pretokenized.first.empty())
 		{
@@ -2016,15 +4018,48 @@ struct KiwiResIter : public py::ResultIter<KiwiResIter, vector<TokenResult>, Fut
 			so = py::toCpp<py::StringWithOffset<u16string>>(next);
 			updatePretokenizedSpanToU16(pretokenized.first, so);
 		}
-		return makeFutureCarrier(
-			kiwi->kiwi.asyncAnalyze(move(so.str), topN, matchOptions, blocklist ? &blocklist->morphSet : nullptr, move(pretokenized.first)), 
-			move(pretokenized.second)
-		);
+
+		const size_t numChars = so.str.size();
+		// a long input goes alone, after the inputs collected so far
+		if (pendingBatch && !pendingBatch->submitted && pendingBatch->numChars + numChars > microBatchChars)
+		{
+			pendingBatch->submit();
+			pendingBatch.reset();
+		}
+		// a batch waited for before it was full is already gone
+		if (pendingBatch && pendingBatch->submitted) pendingBatch.reset();
+		if (!pendingBatch) pendingBatch = newBatch();
+
+		AnalyzeBatchSlot slot;
+		slot.batch = pendingBatch;
+		slot.idx = pendingBatch->texts.size();
+		slot.carried = move(pretokenized.second);
+		slot.reWordValues = reWordValues.get();
+		if (output & AnalyzeOutput::sentences) slot.input = next;
+		pendingBatch->texts.emplace_back(move(so.str));
+		pendingBatch->spans.emplace_back(move(pretokenized.first));
+		pendingBatch->numChars += numChars;
+
+		// keep every worker busy: batches accumulate only while the pool is saturated
+		if (pendingBatch->numChars >= microBatchChars || *inflight < generation->getNumThreads())
+		{
+			pendingBatch->submit();
+			pendingBatch.reset();
+		}
+		return slot;
 	}
 };
 
-py::TypeWrapper<KiwiResIter> _ResIterSetter{ gModule, [](PyTypeObject&)
+py::TypeWrapper<KiwiResIter> _ResIterSetter{ gModule, [](PyTypeObject& obj)
 {
+	static PyGetSetDef getsets[] =
+	{
+		{ (char*)"window_size", PY_GETTER(&KiwiResIter::getWindowSize), nullptr, "", nullptr },
+		{ (char*)"stall_count", PY_GETTER(&KiwiResIter::getStallCount), nullptr, "", nullptr },
+		{ (char*)"pending_chars", PY_GETTER(&KiwiResIter::getPendingChars), nullptr, "", nullptr },
+		{ nullptr },
+	};
+	obj.tp_getset = getsets;
 } };
 
 using EncodeResult = pair<vector<uint32_t>, vector<pair<uint32_t, uint32_t>>>;
@@ -2055,12 +4090,32 @@ struct SwTokenizerResIter : public py::ResultIter<SwTokenizerResIter, EncodeResu
 	future<EncodeResult> feedNext(py::SharedObj&& next)
 	{
 		if (!PyUnicode_Check(next)) throw py::ValueError{ "`encode` requires an instance of `str` or an iterable of `str`." };
-		return tokenizer->tokenizer.asyncEncodeOffset(py::toCpp<string>(next), true);
+		auto encode = [&](size_t, const string& text)
+		{
+			vector<pair<uint32_t, uint32_t>> offsets;
+			auto tokenIds = tokenizer->tokenizer.encode(text, &offsets, true);
+			return make_pair(move(tokenIds), move(offsets));
+		};
+		if (auto* pool = tokenizer->kiwi->threadPool(*tokenizer->generation))
+		{
+			return enqueueSignalled<EncodeResult>(*pool, completion, [encode, running = markRunning(tokenizer->generation), text = py::toCpp<string>(next)](size_t tid) { return encode(tid, text); });
+		}
+		promise<EncodeResult> ret;
+		ret.set_value(encode(0, py::toCpp<string>(next)));
+		return ret.get_future();
 	}
 };
 
-py::TypeWrapper<SwTokenizerResIter> _SwTokenizerResIterSetter{ gModule, [](PyTypeObject&)
+py::TypeWrapper<SwTokenizerResIter> _SwTokenizerResIterSetter{ gModule, [](PyTypeObject& obj)
 {
+	static PyGetSetDef getsets[] =
+	{
+		{ (char*)"window_size", PY_GETTER(&SwTokenizerResIter::getWindowSize), nullptr, "", nullptr },
+		{ (char*)"stall_count", PY_GETTER(&SwTokenizerResIter::getStallCount), nullptr, "", nullptr },
+		{ (char*)"pending_chars", PY_GETTER(&SwTokenizerResIter::getPendingChars), nullptr, "", nullptr },
+		{ nullptr },
+	};
+	obj.tp_getset = getsets;
 } };
 
 inline void chrOffsetsToTokenOffsets(const vector<TokenInfo>& tokens, vector<pair<uint32_t, uint32_t>>& offsets)
@@ -2111,29 +4166,44 @@ struct SwTokenizerResTEIter : public py::ResultIter<SwTokenizerResTEIter, TokenE
 
 	py::UniqueObj buildPy(TokenEncodeResult&& v)
 	{
-		if (returnOffsets) return py::buildPyTuple(resToPyList(move(get<0>(v)), tokenizer->kiwi.get()), get<1>(v), get<2>(v));
-		return py::buildPyTuple(resToPyList(move(get<0>(v)), tokenizer->kiwi.get()), get<1>(v));
+		if (returnOffsets) return py::buildPyTuple(resToPyList(move(get<0>(v)), tokenizer->kiwi.get(), tokenizer->generation), get<1>(v), get<2>(v));
+		return py::buildPyTuple(resToPyList(move(get<0>(v)), tokenizer->kiwi.get(), tokenizer->generation), get<1>(v));
 	}
 
 	future<TokenEncodeResult> feedNext(py::SharedObj&& next)
 	{
 		if (!PyUnicode_Check(next)) throw py::ValueError{ "`tokenize_encode` requires an instance of `str` or an iterable of `str`." };
-		return tokenizer->kiwi->kiwi.getThreadPool()->enqueue([&](size_t, const string& text)
+		auto encode = [&](size_t, const string& text)
 		{
 			vector<pair<uint32_t, uint32_t>> offsets;
-			auto res = tokenizer->kiwi->kiwi.analyze(text, 1, Match::allWithNormalizing | Match::zCoda);
+			auto res = tokenizer->generation->analyze(text, 1, Match::allWithNormalizing | Match::zCoda);
 			auto tokenIds = tokenizer->tokenizer.encode(res[0].first.data(), res[0].first.size(), returnOffsets ? &offsets : nullptr);
 			if (returnOffsets) chrOffsetsToTokenOffsets(res[0].first, offsets);
 			return make_tuple(move(res), move(tokenIds), move(offsets));
-		}, py::toCpp<string>(next));
+		};
+		if (auto* pool = tokenizer->kiwi->threadPool(*tokenizer->generation))
+		{
+			return enqueueSignalled<TokenEncodeResult>(*pool, completion, [encode, running = markRunning(tokenizer->generation), text = py::toCpp<string>(next)](size_t tid) { return encode(tid, text); });
+		}
+		promise<TokenEncodeResult> ret;
+		ret.set_value(encode(0, py::toCpp<string>(next)));
+		return ret.get_future();
 	}
 };
 
-py::TypeWrapper<SwTokenizerResTEIter> _SwTokenizerResTEIterSetter{ gModule, [](PyTypeObject&)
+py::TypeWrapper<SwTokenizerResTEIter> _SwTokenizerResTEIterSetter{ gModule, [](PyTypeObject& obj)
 {
+	static PyGetSetDef getsets[] =
+	{
+		{ (char*)"window_size", PY_GETTER(&SwTokenizerResTEIter::getWindowSize), nullptr, "", nullptr },
+		{ (char*)"stall_count", PY_GETTER(&SwTokenizerResTEIter::getStallCount), nullptr, "", nullptr },
+		{ (char*)"pending_chars", PY_GETTER(&SwTokenizerResTEIter::getPendingChars), nullptr, "", nullptr },
+		{ nullptr },
+	};
+	obj.tp_getset = getsets;
 } };
 
-py::UniqueObj SwTokenizerObject::encode(PyObject* text, bool returnOffsets) const
+py::UniqueObj SwTokenizerObject::encode(PyObject* text, bool returnOffsets, bool ordered) const
 {
 	if (PyUnicode_Check(text))
 	{
@@ -2157,26 +4227,91 @@ py::UniqueObj SwTokenizerObject::encode(PyObject* text, bool returnOffsets) cons
 	Py_INCREF(this);
 	ret->inputIter = move(iter);
 	ret->returnOffsets = !!returnOffsets;
+	ret->ordered = !!ordered;
 		
-	for (size_t i = 0; i < kiwi->kiwi.getNumThreads() * 16; ++i)
-	{
-		if (!ret->feed()) break;
-	}
+	kiwi->setPrefetchWindow(*ret);
+	ret->fill();
 	return ret;
 }
 
-py::UniqueObj SwTokenizerObject::encodeFromMorphs(PyObject* morphs, bool returnOffsets) const
+/**
+ * @brief Encodes all `texts` on the thread pool into `(input_ids, attention_mask, offset_mapping)`,
+ * int32 arrays of shape `(N, L)`, `(N, L)` and `(N, L, 2)`.
+ * 
+ * `L` is the longest encoded length, cut to `maxLength` with `truncation` 
+ * and raised to `maxLength` with `padToMaxLength`. Padded positions hold `padId`, a zero mask and zero offsets.
+ */
+py::UniqueObj SwTokenizerObject::encodeBatch(PyObject* texts, size_t maxLength, bool padToMaxLength, bool truncation, uint32_t padId) const
 {
-	py::UniqueObj iter{ PyObject_GetIter(morphs) };
-	if (!iter) throw py::ValueError{ "`encodeFromMorphs` requires an iterable of `Tuple[str, str, bool]` parameters." };
-	vector<tuple<u16string, POSTag, bool>> tokens;
-	py::foreachVisit<variant<
-		tuple<string, string, bool>,
-		tuple<string, string>
-	>>(iter.get(), [&](auto&& item)
+	if (truncation && !maxLength) throw py::ValueError{ "`max_length` must be given for truncation." };
+	vector<string> inputs;
+	py::foreach<string>(texts, [&](string&& s)
 	{
-		using T = decay_t<decltype(item)>;
-		if constexpr (is_same_v<T, tuple<string, string, bool>>)
+		inputs.emplace_back(move(s));
+	}, "`texts` must be an iterable of `str`.");
+
+	auto* pool = kiwi.get()->threadPool(*generation);
+	vector<EncodeResult> encoded(inputs.size());
+	{
+		auto running = markRunning(generation);
+		py::ReleaseGIL gil;
+		forEachOnPool(pool, inputs.size(), [&](size_t i)
+		{
+			encoded[i].first = tokenizer.encode(inputs[i], &encoded[i].second, true);
+		});
+	}
+
+	size_t width = padToMaxLength ? maxLength : 0;
+	for (auto& e : encoded)
+	{
+		width = std::max(width, truncation ? std::min(e.first.size(), maxLength) : e.first.size());
+	}
+
+	npy_intp sizes[3] = { (npy_intp)inputs.size(), (npy_intp)width, 2 };
+	py::UniqueObj ids{ PyArray_EMPTY(2, sizes, NPY_INT32, 0) };
+	py::UniqueObj mask{ PyArray_EMPTY(2, sizes, NPY_INT32, 0) };
+	py::UniqueObj offsets{ PyArray_EMPTY(3, sizes, NPY_INT32, 0) };
+	auto* idData = (int32_t*)PyArray_DATA((PyArrayObject*)ids.get());
+	auto* maskData = (int32_t*)PyArray_DATA((PyArrayObject*)mask.get());
+	auto* offsetData = (int32_t*)PyArray_DATA((PyArrayObject*)offsets.get());
+	{
+		py::ReleaseGIL gil;
+		forEachOnPool(pool, inputs.size(), [&](size_t i)
+		{
+			auto& e = encoded[i];
+			const size_t len = std::min(e.first.size(), width);
+			auto* rowIds = idData + i * width;
+			auto* rowMask = maskData + i * width;
+			auto* rowOffsets = offsetData + i * width * 2;
+			for (size_t j = 0; j < len; ++j)
+			{
+				rowIds[j] = (int32_t)e.first[j];
+				rowMask[j] = 1;
+				rowOffsets[j * 2] = (int32_t)e.second[j].first;
+				rowOffsets[j * 2 + 1] = (int32_t)e.second[j].second;
+			}
+			std::fill(rowIds + len, rowIds + width, (int32_t)padId);
+			std::fill(rowMask + len, rowMask + width, 0);
+			std::fill(rowOffsets + len * 2, rowOffsets + width * 2, 0);
+			// the encoded form is not needed any more
+			e = {};
+		});
+	}
+	return py::buildPyTuple(move(ids), move(mask), move(offsets));
+}
+
+py::UniqueObj SwTokenizerObject::encodeFromMorphs(PyObject* morphs, bool returnOffsets) const
+{
+	py::UniqueObj iter{ PyObject_GetIter(morphs) };
+	if (!iter) throw py::ValueError{ "`encodeFromMorphs` requires an iterable of `Tuple[str, str, bool]` parameters." };
+	vector<tuple<u16string, POSTag, bool>> tokens;
+	py::foreachVisit<variant<
+		tuple<string, string, bool>,
+		tuple<string, string>
+	>>(iter.get(), [&](auto&& item)
+	{
+		using T = decay_t<decltype(item)>;
+		if constexpr (is_same_v<T, tuple<string, string, bool>>)
 		{
 			auto form = utf8To16(get<0>(item));
 			auto pos = parseTag(get<1>(item).c_str());
@@ -2203,6 +4338,145 @@ py::UniqueObj SwTokenizerObject::encodeFromMorphs(PyObject* morphs, bool returnO
 	}
 }
 
+/**
+ * @brief The morphemes of one input of `encode_from_morph_arrays`, read from the buffers of its arrays.
+ * 
+ * Either `ids`, the morpheme ids of the generation, or `forms`, `formOffsets` and `tags` are given. 
+ * `spaces` may be null. The pointers are valid as long as `owners` are alive.
+ */
+struct MorphArraysInput
+{
+	size_t size = 0;
+	const int64_t* ids = nullptr;
+	py::StringWithOffset<u16string> forms;
+	const int64_t* formOffsets = nullptr;
+	const uint32_t* formOffsets32 = nullptr; // set instead of `formOffsets` when given as uint32, as `TokenArrays` stores them
+	const uint8_t* tags = nullptr;
+	const npy_bool* spaces = nullptr;
+	vector<py::UniqueObj> owners;
+
+	// views `obj` as a 1D array of `npyType`, converting it only if needed. `expected` of -1 accepts any length, stored in `size`
+	template<class Ty>
+	const Ty* view(PyObject* obj, int npyType, const char* name, ptrdiff_t expected)
+	{
+		py::UniqueObj arr{ PyArray_FROMANY(obj, npyType, 1, 1, NPY_ARRAY_CARRAY_RO) };
+		if (!arr) throw py::ExcPropagation{};
+		const size_t len = PyArray_DIM((PyArrayObject*)arr.get(), 0);
+		if (expected < 0) size = len;
+		else if (len != (size_t)expected) throw py::ValueError{ "`" + string{ name } + "` must have " + to_string(expected) + " elements, but has " + to_string(len) + "." };
+		auto* data = (const Ty*)PyArray_DATA((PyArrayObject*)arr.get());
+		owners.emplace_back(move(arr));
+		return data;
+	}
+
+	/**
+	 * @brief Reads `(morph_ids, spaces)` or `(forms, form_offsets, tags, spaces)`. `spaces` may be None.
+	 */
+	explicit MorphArraysInput(PyObject* arrays)
+	{
+		if (!PyTuple_Check(arrays) || (PyTuple_GET_SIZE(arrays) != 2 && PyTuple_GET_SIZE(arrays) != 4))
+		{
+			throw py::ValueError{ "morpheme arrays must be a tuple of `(morph_ids, spaces)` or `(forms, form_offsets, tags, spaces)`." };
+		}
+		PyObject* spacesObj;
+		if (PyTuple_GET_SIZE(arrays) == 2)
+		{
+			ids = view<int64_t>(PyTuple_GET_ITEM(arrays, 0), NPY_INT64, "morph_ids", -1);
+			spacesObj = PyTuple_GET_ITEM(arrays, 1);
+		}
+		else
+		{
+			forms = py::toCpp<py::StringWithOffset<u16string>>(PyTuple_GET_ITEM(arrays, 0));
+			tags = view<uint8_t>(PyTuple_GET_ITEM(arrays, 2), NPY_UINT8, "tags", -1);
+			PyObject* offsetsObj = PyTuple_GET_ITEM(arrays, 1);
+			if (PyArray_Check(offsetsObj) && PyArray_TYPE((PyArrayObject*)offsetsObj) == NPY_UINT32)
+			{
+				formOffsets32 = view<uint32_t>(offsetsObj, NPY_UINT32, "form_offsets", size + 1);
+			}
+			else
+			{
+				formOffsets = view<int64_t>(offsetsObj, NPY_INT64, "form_offsets", size + 1);
+			}
+			spacesObj = PyTuple_GET_ITEM(arrays, 3);
+		}
+		if (spacesObj != Py_None) spaces = view<npy_bool>(spacesObj, NPY_BOOL, "spaces", size);
+	}
+
+	/**
+	 * @brief Builds the morphemes `SwTokenizer::encode` takes. Needs no GIL.
+	 */
+	vector<tuple<u16string, POSTag, bool>> toTokens(const Kiwi& kiwi) const
+	{
+		vector<tuple<u16string, POSTag, bool>> ret;
+		ret.reserve(size);
+		const size_t numChrs = forms.offsets.empty() ? 0 : forms.offsets.size() - 1;
+		for (size_t i = 0; i < size; ++i)
+		{
+			const bool space = spaces && spaces[i];
+			if (ids)
+			{
+				auto* morph = ids[i] >= 0 ? kiwi.idToMorph(ids[i]) : nullptr;
+				if (!morph) throw py::ValueError{ "morpheme id " + to_string(ids[i]) + " is out of range." };
+				ret.emplace_back(joinHangul(morph->getForm()), morph->tag, space);
+			}
+			else
+			{
+				const int64_t b = formOffsets32 ? (int64_t)formOffsets32[i] : formOffsets[i],
+					e = formOffsets32 ? (int64_t)formOffsets32[i + 1] : formOffsets[i + 1];
+				if (b < 0 || b > e || (size_t)e > numChrs) throw py::ValueError{ "`form_offsets` must be non-decreasing offsets into `forms`." };
+				if (clearIrregular((POSTag)tags[i]) >= POSTag::max) throw py::ValueError{ "Unknown tag value " + to_string(tags[i]) };
+				const size_t ub = forms.offsets[b], ue = forms.offsets[e];
+				ret.emplace_back(forms.str.substr(ub, ue - ub), (POSTag)tags[i], space);
+			}
+		}
+		return ret;
+	}
+};
+
+py::UniqueObj SwTokenizerObject::encodeFromMorphArrays(PyObject* arrays, bool returnOffsets) const
+{
+	MorphArraysInput input{ arrays };
+	vector<pair<uint32_t, uint32_t>> offsets;
+	vector<uint32_t> tokenIds;
+	{
+		py::ReleaseGIL gil;
+		tokenIds = tokenizer.encode(input.toTokens(*generation), returnOffsets ? &offsets : nullptr);
+	}
+	if (returnOffsets) return py::buildPyTuple(tokenIds, offsets);
+	return py::buildPyValue(tokenIds);
+}
+
+/**
+ * @brief Encodes every item of `batch`, each given as `encodeFromMorphArrays` takes, on the thread pool.
+ * Returns a list of the results.
+ */
+py::UniqueObj SwTokenizerObject::encodeFromMorphArraysBatch(PyObject* batch, bool returnOffsets) const
+{
+	vector<MorphArraysInput> inputs;
+	py::foreach<PyObject*>(batch, [&](PyObject* item)
+	{
+		inputs.emplace_back(item);
+	}, "`batch` must be an iterable of morpheme arrays.");
+
+	vector<EncodeResult> encoded(inputs.size());
+	{
+		py::ReleaseGIL gil;
+		forEachOnPool(kiwi.get()->threadPool(*generation), inputs.size(), [&](size_t i)
+		{
+			encoded[i].first = tokenizer.encode(inputs[i].toTokens(*generation), returnOffsets ? &encoded[i].second : nullptr);
+		});
+	}
+
+	py::UniqueObj ret{ PyList_New(encoded.size()) };
+	for (size_t i = 0; i < encoded.size(); ++i)
+	{
+		auto v = returnOffsets ? py::buildPyTuple(encoded[i].first, encoded[i].second) : py::buildPyValue(encoded[i].first);
+		if (!v) throw py::ExcPropagation{};
+		PyList_SET_ITEM(ret.get(), i, v.release());
+	}
+	return ret;
+}
+
 py::UniqueObj SwTokenizerObject::tokenizeAndEncode(PyObject* text, bool returnOffsets) const
 {
 	if (PyUnicode_Check(text))
@@ -2213,11 +4487,11 @@ py::UniqueObj SwTokenizerObject::tokenizeAndEncode(PyObject* text, bool returnOf
 		if (returnOffsets)
 		{
 			chrOffsetsToTokenOffsets(res[0].first, offsets);
-			return py::buildPyTuple(resToPyList(move(res), kiwi.get()), tokenIds, offsets);
+			return py::buildPyTuple(resToPyList(move(res), kiwi.get(), generation), tokenIds, offsets);
 		}
 		else
 		{
-			return py::buildPyTuple(resToPyList(move(res), kiwi.get()), tokenIds);
+			return py::buildPyTuple(resToPyList(move(res), kiwi.get(), generation), tokenIds);
 		}
 	}
 
@@ -2230,10 +4504,8 @@ py::UniqueObj SwTokenizerObject::tokenizeAndEncode(PyObject* text, bool returnOf
 	ret->inputIter = move(iter);
 	ret->returnOffsets = !!returnOffsets;
 
-	for (size_t i = 0; i < kiwi->kiwi.getNumThreads() * 16; ++i)
-	{
-		if (!ret->feed()) break;
-	}
+	kiwi->setPrefetchWindow(*ret);
+	ret->fill();
 	return ret;
 }
 
@@ -2242,8 +4514,71 @@ std::string SwTokenizerObject::decode(PyObject* ids, bool ignoreErrors) const
 	return tokenizer.decode(py::toCpp<vector<uint32_t>>(ids), !!ignoreErrors);
 }
 
+/**
+ * @brief Decodes every row of `ids`, either a 2D array or an iterable of 1D arrays or lists, on the thread pool.
+ * 
+ * Each row is read as an int64 buffer, converted by numpy at most once per row, and every occurrence of `padId` is skipped.
+ * Returns a list of `str`.
+ */
+py::UniqueObj SwTokenizerObject::decodeBatch(PyObject* ids, std::optional<int64_t> padId, bool ignoreErrors) const
+{
+	// the rows as (pointer, length) into `arrays`, which keep the buffers alive
+	vector<py::UniqueObj> arrays;
+	vector<pair<const int64_t*, size_t>> rows;
+	auto toArray = [&](PyObject* obj, int minDims, int maxDims)
+	{
+		py::UniqueObj arr{ PyArray_FROMANY(obj, NPY_INT64, minDims, maxDims, NPY_ARRAY_CARRAY_RO) };
+		if (!arr) throw py::ExcPropagation{};
+		arrays.emplace_back(move(arr));
+		return (PyArrayObject*)arrays.back().get();
+	};
+
+	if (PyArray_Check(ids) && PyArray_NDIM((PyArrayObject*)ids) == 2)
+	{
+		auto* arr = toArray(ids, 2, 2);
+		const size_t numRows = PyArray_DIM(arr, 0), width = PyArray_DIM(arr, 1);
+		auto* data = (const int64_t*)PyArray_DATA(arr);
+		for (size_t i = 0; i < numRows; ++i) rows.emplace_back(data + i * width, width);
+	}
+	else
+	{
+		py::foreach<PyObject*>(ids, [&](PyObject* row)
+		{
+			auto* arr = toArray(row, 1, 1);
+			rows.emplace_back((const int64_t*)PyArray_DATA(arr), PyArray_DIM(arr, 0));
+		}, "`ids` must be a 2D array or an iterable of sequences of int.");
+	}
+
+	const size_t vocabSize = tokenizer.size();
+	vector<string> decoded(rows.size());
+	{
+		py::ReleaseGIL gil;
+		forEachOnPool(kiwi.get()->threadPool(*generation), rows.size(), [&](size_t i)
+		{
+			vector<uint32_t> tokenIds;
+			tokenIds.reserve(rows[i].second);
+			for (size_t j = 0; j < rows[i].second; ++j)
+			{
+				const int64_t id = rows[i].first[j];
+				if (padId && id == *padId) continue;
+				if (id < 0 || (size_t)id >= vocabSize) throw py::ValueError{ "token id " + to_string(id) + " is out of the vocabulary." };
+				tokenIds.emplace_back((uint32_t)id);
+			}
+			decoded[i] = tokenizer.decode(tokenIds, !!ignoreErrors);
+		});
+	}
+
+	py::UniqueObj ret{ PyList_New(decoded.size()) };
+	for (size_t i = 0; i < decoded.size(); ++i)
+	{
+		PyList_SET_ITEM(ret.get(), i, py::buildPyValue(decoded[i]).release());
+	}
+	return ret;
+}
+
 std::pair<uint32_t, bool> KiwiObject::addUserWord(const char* word, const char* tag, float score, std::optional<const char*> origWord)
 {	
+	checkBuilderWritable();
 	auto pos = parseTag(tag);
 	std::pair<uint32_t, bool> added = std::make_pair(0, false);
 	if (origWord)
@@ -2254,12 +4589,88 @@ std::pair<uint32_t, bool> KiwiObject::addUserWord(const char* word, const char*
 	{
 		added = builder.addWord(utf8To16(word), pos, score);
 	}
-	if (added.second) kiwi = Kiwi{};
+	if (added.second) resetKiwi();
 	return added;
 }
 
+/**
+ * @brief Adds words given as parallel sequences in a single call.
+ * `tags` and `scores` are either one value for every word or a sequence as long as `forms`.
+ * Each distinct tag string is parsed only once, and the model is marked outdated once at the end.
+ * Returns `(ids, inserted)` as arrays.
+ */
+py::UniqueObj KiwiObject::addUserWordsBulk(PyObject* forms, PyObject* tags, PyObject* scores)
+{
+	checkBuilderWritable();
+	std::unordered_map<string, POSTag> tagCache;
+	auto toTag = [&](PyObject* obj)
+	{
+		auto str = py::toCpp<string>(obj);
+		auto it = tagCache.find(str);
+		if (it == tagCache.end())
+		{
+			const POSTag tag = parseTag(str.c_str());
+			it = tagCache.emplace(move(str), tag).first;
+		}
+		return it->second;
+	};
+
+	vector<u16string> formList;
+	py::foreach<PyObject*>(forms, [&](PyObject* item)
+	{
+		formList.emplace_back(py::toCpp<u16string>(item));
+	}, "`forms` must be an iterable of `str`.");
+
+	POSTag singleTag = POSTag::nnp;
+	vector<POSTag> tagList;
+	if (PyUnicode_Check(tags))
+	{
+		singleTag = toTag(tags);
+	}
+	else
+	{
+		tagList.reserve(formList.size());
+		py::foreach<PyObject*>(tags, [&](PyObject* item)
+		{
+			tagList.emplace_back(toTag(item));
+		}, "`tags` must be a `str` or an iterable of `str`.");
+		if (tagList.size() != formList.size()) throw py::ValueError{ "`tags` must have the same length as `forms`." };
+	}
+
+	float singleScore = 0;
+	vector<float> scoreList;
+	if (PyFloat_Check(scores) || PyLong_Check(scores))
+	{
+		singleScore = py::toCpp<float>(scores);
+	}
+	else if (scores != Py_None)
+	{
+		scoreList = py::toCpp<vector<float>>(scores);
+		if (scoreList.size() != formList.size()) throw py::ValueError{ "`scores` must have the same length as `forms`." };
+	}
+
+	npy_intp size = formList.size();
+	py::UniqueObj ids{ PyArray_EMPTY(1, &size, NPY_UINT32, 0) };
+	py::UniqueObj inserted{ PyArray_EMPTY(1, &size, NPY_BOOL, 0) };
+	auto* idData = (uint32_t*)PyArray_DATA((PyArrayObject*)ids.get());
+	auto* insertedData = (npy_bool*)PyArray_DATA((PyArrayObject*)inserted.get());
+	bool anyInserted = false;
+	for (size_t i = 0; i < formList.size(); ++i)
+	{
+		auto added = builder.addWord(formList[i], 
+			tagList.empty() ? singleTag : tagList[i], 
+			scoreList.empty() ? singleScore : scoreList[i]);
+		idData[i] = added.first;
+		insertedData[i] = added.second;
+		anyInserted = anyInserted || added.second;
+	}
+	if (anyInserted) resetKiwi();
+	return py::buildPyTuple(ids, inserted);
+}
+
 bool KiwiObject::addPreAnalyzedWord(const char* form, PyObject* oAnalyzed, float score)
 {
+	checkBuilderWritable();
 	vector<pair<u16string, POSTag>> analyzed;
 	vector<pair<size_t, size_t>> positions;
 	py::foreach<PyObject*>(oAnalyzed, [&](PyObject* item)
@@ -2299,12 +4710,13 @@ bool KiwiObject::addPreAnalyzedWord(const char* form, PyObject* oAnalyzed, float
 	}
 
 	auto added = builder.addPreAnalyzedWord(utf8To16(form), analyzed, positions, score);
-	if (added) kiwi = Kiwi{};
+	if (added) resetKiwi();
 	return added;
 }
 
 std::vector<std::pair<uint32_t, std::u16string>> KiwiObject::addRule(const char* tag, PyObject* replacer, float score)
 {
+	checkBuilderWritable();
 	if (!PyCallable_Check(replacer)) throw py::ValueError{ "`replacer` must be an callable." };
 
 	auto pos = parseTag(tag);
@@ -2314,17 +4726,170 @@ std::vector<std::pair<uint32_t, std::u16string>> KiwiObject::addRule(const char*
 		if (!ret) throw py::ExcPropagation{};
 		return py::toCpp<u16string>(ret.get());
 	}, score);
-	if (!added.empty()) kiwi = Kiwi{};
+	if (!added.empty()) resetKiwi();
 	return added;
 }
 
 size_t KiwiObject::loadUserDictionary(const char* path)
 {
+	checkBuilderWritable();
 	auto ret = builder.loadDictionary(path);
-	if (ret) kiwi = Kiwi{};
+	if (ret) resetKiwi();
 	return ret;
 }
 
+void KiwiObject::rebuildInBackground()
+{
+	checkFork();
+	if (rebuilding) return;
+	// the previous rebuild has already published its result, so only its thread is left to be collected
+	waitRebuild();
+	rebuilding = true;
+	// the build works on copies, so `builder` and `typos` remain free to change meanwhile
+	auto snapshot = std::make_shared<KiwiBuilder>(builder);
+	auto typoSet = typos ? typos->tt : getDefaultTypoSet(DefaultTypoSet::withoutTypo);
+	const float threshold = typoCostThreshold;
+	const size_t version = builderVersion;
+	// the object joins this thread before going away, so the thread does not need a reference to it
+	rebuildThread = std::thread{ [this, snapshot, typoSet = move(typoSet), threshold, version]()
+	{
+		std::optional<Kiwi> built;
+		std::exception_ptr error;
+		const auto start = chrono::steady_clock::now();
+		try
+		{
+			built.emplace(snapshot->build(typoSet, threshold));
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+		const auto builtAt = chrono::steady_clock::now();
+
+		if (isPyFinalizing()) return;
+		PyGILState_STATE gilState = PyGILState_Ensure();
+		rebuilding = false;
+		if (!closing)
+		{
+			py::UniqueObj ret{ py::handleExc([&]() -> PyObject*
+			{
+				if (error) std::rethrow_exception(error);
+				generationStats->lastBuildTime = chrono::duration<double>(builtAt - start).count();
+				publish(std::move(*built), version, builtAt);
+				Py_RETURN_NONE;
+			}) };
+			if (!ret) PyErr_WriteUnraisable((PyObject*)this);
+		}
+		PyGILState_Release(gilState);
+	} };
+}
+
+size_t KiwiObject::addOverlayWords(PyObject* words)
+{
+	auto layer = std::make_shared<UserOverlay>();
+	layer->base = overlay;
+	size_t added = 0;
+	py::foreachVisit<variant<u16string, tuple<u16string, u16string>>>(words, [&](auto&& item)
+	{
+		using T = decay_t<decltype(item)>;
+		POSTag tag = POSTag::nnp;
+		const u16string* form;
+		if constexpr (is_same_v<T, u16string>)
+		{
+			form = &item;
+		}
+		else
+		{
+			form = &get<0>(item);
+			tag = parseTag(get<1>(item));
+		}
+		if (form->empty()) throw py::ValueError{ "`form` of an overlay word must not be empty." };
+		// a form already in a lower layer only has its tag replaced
+		if (layer->insert(*form, tag) && !(layer->base && layer->base->find(*form))) ++added;
+	}, "`words` must be an iterable of `str` or `Tuple[str, str]`.");
+	if (layer->words.empty()) return 0;
+	layer->seal();
+	overlay = move(layer);
+	return added;
+}
+
+/**
+ * @brief Replaces the native `add_re_word` patterns with `patterns`, 
+ * an iterable of `(ecmascript_pattern, first_chars, prefix, pretokenized, user_value)` made by kiwipiepy/_re_native.py.
+ * Returns the indices of the patterns which `std::wregex` rejected. They are left out, so that the caller matches them in Python.
+ */
+std::vector<size_t> KiwiObject::setNativeReWords(PyObject* patterns)
+{
+	auto next = std::make_shared<NativeReWords>();
+	vector<size_t> rejected;
+	py::UniqueObj values{ PyList_New(0) };
+	size_t idx = 0;
+	py::foreach<tuple<u16string, PyObject*, u16string, PyObject*, PyObject*>>(patterns, [&](auto&& item)
+	{
+		NativeReWords::Pattern pat;
+		std::wstring wpattern;
+		vector<uint32_t> wcharPos;
+		NativeReWords::toWide(get<0>(item), wpattern, wcharPos);
+		try
+		{
+			// case folding is already spelled out in the pattern, as `std::regex_constants::icase` only folds by the C locale
+			pat.re = std::wregex{ wpattern, std::regex_constants::ECMAScript | std::regex_constants::optimize };
+		}
+		catch (const std::regex_error&)
+		{
+			rejected.emplace_back(idx++);
+			return;
+		}
+
+		if (get<1>(item) != Py_None)
+		{
+			py::foreach<pair<uint32_t, uint32_t>>(get<1>(item), [&](auto&& r)
+			{
+				pat.firstChars.emplace_back(r);
+			}, "`first_chars` must be an iterable of `Tuple[int, int]`.");
+			sort(pat.firstChars.begin(), pat.firstChars.end());
+		}
+		NativeReWords::toWide(get<2>(item), pat.prefix, wcharPos);
+
+		if (PyUnicode_Check(get<3>(item)))
+		{
+			auto tag = parseTag(py::toCpp<u16string>(get<3>(item)));
+			pat.tokenization.emplace_back();
+			pat.tokenization.back().tag = tag;
+		}
+		else
+		{
+			py::foreach<tuple<u16string, u16string, size_t, size_t>>(get<3>(item), [&](auto&& t)
+			{
+				auto tag = parseTag(get<1>(t));
+				pat.tokenization.emplace_back();
+				auto& token = pat.tokenization.back();
+				token.form = move(get<0>(t));
+				token.tag = tag;
+				token.begin = get<2>(t);
+				token.end = get<3>(t);
+			}, "`pretokenized` must be a `str` or an iterable of `PretokenizedToken`.");
+		}
+
+		next->patterns.emplace_back(move(pat));
+		if (PyList_Append(values.get(), get<4>(item))) throw py::ExcPropagation{};
+		++idx;
+	}, "`patterns` must be an iterable of `Tuple[str, Optional[List[Tuple[int, int]]], str, Any, Any]`.");
+
+	if (next->patterns.empty())
+	{
+		reWords.reset();
+		reWordValues = {};
+	}
+	else
+	{
+		next->seal();
+		reWords = move(next);
+		reWordValues = py::UniqueObj{ PyList_AsTuple(values.get()) };
+	}
+	return rejected;
+}
+
 U16MultipleReader obj2reader(PyObject* obj)
 {
 	return [obj]()
@@ -2364,8 +4929,9 @@ py::UniqueObj KiwiObject::extractWords(PyObject* sentences, size_t minCnt, size_
 
 py::UniqueObj KiwiObject::extractAddWords(PyObject* sentences, size_t minCnt, size_t maxWordLen, float minScore, float posScore, bool lmFilter)
 {
+	checkBuilderWritable();
 	auto res = builder.extractAddWords(obj2reader(sentences), minCnt, maxWordLen, minScore, posScore, lmFilter);
-	kiwi = Kiwi{};
+	resetKiwi();
 
 	py::UniqueObj retList{ PyList_New(res.size()) };
 	size_t idx = 0;
@@ -2378,7 +4944,7 @@ py::UniqueObj KiwiObject::extractAddWords(PyObject* sentences, size_t minCnt, si
 	return retList;
 }
 
-py::UniqueObj KiwiObject::analyze(PyObject* text, size_t topN, Match matchOptions, bool echo, PyObject* blockList, PyObject* pretokenized)
+py::UniqueObj KiwiObject::analyze(PyObject* text, size_t topN, Match matchOptions, bool echo, PyObject* blockList, PyObject* pretokenized, AnalyzeOutput output, bool ordered)
 {
 	doPrepare();
 	if (PyUnicode_Check(text))
@@ -2397,6 +4963,11 @@ py::UniqueObj KiwiObject::analyze(PyObject* text, size_t topN, Match matchOption
 			pretokenizedSpans = makePretokenizedSpans(pretokenized);
 		}
 
+		if ((output & AnalyzeOutput::resetWhitespace) && !pretokenizedSpans.first.empty())
+		{
+			throw py::ValueError{ "`pretokenized` cannot be used with resetting whitespace." };
+		}
+
 		py::StringWithOffset<u16string> so;
 		if (pretokenizedSpans.first.empty())
 		{
@@ -2408,9 +4979,27 @@ py::UniqueObj KiwiObject::analyze(PyObject* text, size_t topN, Match matchOption
 			updatePretokenizedSpanToU16(pretokenizedSpans.first, so);
 		}
 
-		auto res = kiwi.analyze(so.str, topN, matchOptions, morphs, pretokenizedSpans.first);
+		// holding the generation, the patterns and the overlay keeps them alive even if they are replaced meanwhile
+		auto generation = kiwi;
+		auto textReWords = (output & AnalyzeOutput::reWords) ? reWords : nullptr;
+		auto textOverlay = overlay;
+		vector<TokenResult> res;
+		vector<int32_t> origins;
+		u16string spaced;
+		{
+			auto running = markRunning(generation);
+			py::ReleaseGIL gil;
+			if (output & AnalyzeOutput::resetWhitespace) so.str = removeHangulWhitespace(so.str);
+			origins = completePretokenizedSpans(textReWords.get(), textOverlay.get(), so.str, pretokenizedSpans.first);
+			res = generation->analyze(so.str, topN, matchOptions, morphs, pretokenizedSpans.first);
+			if (output & AnalyzeOutput::spaced) spaced = res.empty() ? so.str : spaceByTokens(so.str, res[0].first);
+		}
+		if (output & AnalyzeOutput::spaced) return py::buildPyValue(spaced);
 		if (res.size() > topN) res.erase(res.begin() + topN, res.end());
-		return resToPyList(move(res), this, move(pretokenizedSpans.second));
+		auto userValues = resolveUserValues(move(pretokenizedSpans.second), origins, reWordValues.get());
+		if (output & AnalyzeOutput::sentences) return resToPySentences(move(res), text, output, this, generation, move(userValues));
+		if (output & AnalyzeOutput::arrays) return resToPyArrays(move(res), *generation);
+		return resToPyList(move(res), this, generation, move(userValues));
 	}
 	else
 	{
@@ -2424,6 +5013,14 @@ py::UniqueObj KiwiObject::analyze(PyObject* text, size_t topN, Match matchOption
 		ret->topN = topN;
 		ret->matchOptions = matchOptions;
 		ret->echo = !!echo;
+		ret->output = output;
+		ret->ordered = !!ordered;
+		ret->microBatchChars = microBatchChars;
+		ret->generation = kiwi;
+		ret->overlay = overlay;
+		if (output & AnalyzeOutput::reWords) ret->reWords = reWords;
+		ret->reWordValues = py::UniqueObj{ reWordValues.get() };
+		Py_XINCREF(reWordValues.get());
 		if (blockList != Py_None)
 		{
 			ret->blocklist = py::UniqueCObj<MorphemeSetObject>{ (MorphemeSetObject*)blockList };
@@ -2440,11 +5037,271 @@ py::UniqueObj KiwiObject::analyze(PyObject* text, size_t topN, Match matchOption
 			throw py::ValueError{ "`analyze` of multiple inputs requires a callable `pretokenized` argument." };
 		}
 
-		for (size_t i = 0; i < kiwi.getNumThreads() * 16; ++i)
+		setPrefetchWindow(*ret);
+		ret->fill();
+		return ret;
+	}
+}
+
+/**
+ * @brief Decides for each boundary between consecutive `chunks` whether a space goes there, 
+ * by comparing the scores of the text around the boundary analyzed with and without a space.
+ * 
+ * Only the last `window` characters of the left chunk and the first `window` of the right one are analyzed, 
+ * cut at a whitespace where possible, so the cost of a boundary does not depend on the length of the chunks.
+ * `window = 0` analyzes the whole chunks. Boundaries are scored in parallel on the thread pool.
+ * Returns a bool array with one element less than `chunks`.
+ */
+py::UniqueObj KiwiObject::glue(PyObject* chunks, size_t window)
+{
+	doPrepare();
+	vector<u16string> texts;
+	py::foreach<u16string>(chunks, [&](u16string&& s)
+	{
+		texts.emplace_back(move(s));
+	}, "`text_chunks` must be an iterable of `str`.");
+
+	npy_intp size = texts.size() > 1 ? texts.size() - 1 : 0;
+	py::UniqueObj ret{ PyArray_EMPTY(1, &size, NPY_BOOL, 0) };
+	auto* data = (npy_bool*)PyArray_DATA((PyArrayObject*)ret.get());
+	if (!size) return ret;
+
+	auto isAlnum = [](char16_t c) { return ('0' <= c && c <= '9') || ('A' <= c && c <= 'Z') || ('a' <= c && c <= 'z'); };
+
+	// the generation outlives every task below, so none of them releases it
+	auto generation = kiwi;
+	const Kiwi& k = *generation;
+	auto decide = [&](size_t i) -> bool
+	{
+		auto& left = texts[i];
+		auto& right = texts[i + 1];
+		// a chunk ending with an alphanumeric is always followed by a space, as before
+		if (!left.empty() && isAlnum(left.back())) return true;
+
+		size_t b = 0, e = right.size();
+		if (window && left.size() > window)
 		{
-			if (!ret->feed()) break;
+			b = left.size() - window;
+			for (size_t j = b; j < left.size(); ++j)
+			{
+				if (isPySpace(left[j])) { b = j + 1; break; }
+			}
+			if ((left[b] & 0xFC00) == 0xDC00) ++b;
 		}
-		return ret;
+		if (window && right.size() > window)
+		{
+			e = window;
+			for (size_t j = e; j > 0; --j)
+			{
+				if (isPySpace(right[j - 1])) { e = j - 1; break; }
+			}
+			if (e && (right[e - 1] & 0xFC00) == 0xD800) --e;
+		}
+
+		const vector<PretokenizedSpan> noSpans;
+		u16string joined = left.substr(b);
+		joined += u' ';
+		joined.append(right, 0, e);
+		const float withSpace = k.analyze(joined, 1, Match::all, nullptr, noSpans)[0].second;
+		joined.erase(left.size() - b, 1);
+		const float withoutSpace = k.analyze(joined, 1, Match::all, nullptr, noSpans)[0].second;
+		return withSpace >= withoutSpace;
+	};
+
+	{
+		auto running = markRunning(generation);
+		py::ReleaseGIL gil;
+		forEachOnPool(threadPool(k), size, [&](size_t i)
+		{
+			data[i] = decide(i);
+		});
+	}
+	return ret;
+}
+
+/**
+ * @brief State of a single `_analyze_async` call.
+ * 
+ * The worker only analyzes the text and hands the raw result to the event loop through `post`.
+ * The tokens are built by `build` on the loop thread, so the worker holds the GIL just for that hand-off.
+ * The Python references held here are released only with the GIL, by whichever side drops the task last.
+ */
+struct AsyncAnalyzeTask
+{
+	py::UniqueCObj<KiwiObject> kiwiObj;
+	std::shared_ptr<Kiwi> generation;
+	py::UniqueObj post, blocklistObj, reWordValues;
+	std::shared_ptr<const NativeReWords> reWords;
+	std::shared_ptr<const UserOverlay> overlay;
+	u16string text;
+	vector<PretokenizedSpan> spans;
+	vector<int32_t> origins;
+	vector<py::UniqueObj> userValues;
+	size_t topN = 1;
+	Match matchOptions = Match::all;
+	const unordered_set<const Morpheme*>* blocklist = nullptr;
+	std::shared_ptr<void> running;
+	vector<TokenResult> results;
+	std::exception_ptr error;
+
+	void run()
+	{
+		try
+		{
+			origins = completePretokenizedSpans(reWords.get(), overlay.get(), text, spans);
+			results = generation->analyze(text, topN, matchOptions, blocklist, spans);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+		running.reset();
+	}
+
+	py::UniqueObj build()
+	{
+		if (!kiwiObj) throw py::RuntimeError{ "The result has already been built." };
+		auto kiwiObj = move(this->kiwiObj);
+		if (error) std::rethrow_exception(error);
+		if (results.size() > topN) results.erase(results.begin() + topN, results.end());
+		return resToPyList(move(results), kiwiObj.get(), generation, resolveUserValues(move(userValues), origins, reWordValues.get()));
+	}
+
+	// the interpreter is going away: the references can be neither released nor used any more
+	void abandon()
+	{
+		kiwiObj.release();
+		post.release();
+		blocklistObj.release();
+		reWordValues.release();
+		for (auto& v : userValues) v.release();
+	}
+};
+
+struct AsyncAnalyzeResultObject : py::CObject<AsyncAnalyzeResultObject>
+{
+	static constexpr const char* _name = "kiwipiepy._AsyncAnalyzeResult";
+	static constexpr const char* _name_in_module = "_AsyncAnalyzeResult";
+	static constexpr int _flags = Py_TPFLAGS_DEFAULT;
+
+	using _InitArgs = std::tuple<>;
+
+	std::shared_ptr<AsyncAnalyzeTask> task;
+
+	py::UniqueObj build()
+	{
+		return task->build();
+	}
+};
+
+py::TypeWrapper<AsyncAnalyzeResultObject> _AsyncAnalyzeResultObjectSetter{ gModule, [](PyTypeObject& obj)
+{
+	static PyMethodDef methods[] =
+	{
+		{ "_build", PY_METHOD(&AsyncAnalyzeResultObject::build), METH_VARARGS | METH_KEYWORDS, "" },
+		{ nullptr }
+	};
+	obj.tp_methods = methods;
+} };
+
+/**
+ * @brief Hands the analyzed `task` to the event loop, taking the GIL only for the call of `post`.
+ * The worker gives up its reference to the task here, so that the last one is always dropped with the GIL.
+ */
+void postAsyncResult(std::shared_ptr<AsyncAnalyzeTask>&& task)
+{
+	if (isPyFinalizing())
+	{
+		task->abandon();
+		return;
+	}
+	PyGILState_STATE gilState = PyGILState_Ensure();
+	{
+		auto handle = py::makeNewObject<AsyncAnalyzeResultObject>();
+		auto post = std::move(task->post);
+		handle->task = std::move(task);
+		py::UniqueObj ret{ PyObject_CallFunctionObjArgs(post.get(), (PyObject*)handle.get(), nullptr) };
+		if (!ret) PyErr_WriteUnraisable(post.get());
+	}
+	PyGILState_Release(gilState);
+}
+
+void KiwiObject::analyzeAsync(PyObject* text, size_t topN, Match matchOptions, PyObject* blockList, PyObject* pretokenized, PyObject* post)
+{
+	if (!PyUnicode_Check(text)) throw py::ValueError{ "`analyze_async` requires an instance of `str`." };
+	if (!PyCallable_Check(post)) throw py::ValueError{ "`post` must be callable." };
+	doPrepare();
+
+	auto task = std::make_shared<AsyncAnalyzeTask>();
+	pair<vector<PretokenizedSpan>, vector<py::UniqueObj>> pretokenizedSpans;
+	if (PyCallable_Check(pretokenized))
+	{
+		py::UniqueObj ptResult{ PyObject_CallFunctionObjArgs(pretokenized, text, nullptr) };
+		if (!ptResult) throw py::ExcPropagation{};
+		pretokenizedSpans = makePretokenizedSpans(ptResult.get());
+	}
+	else if (pretokenized != Py_None)
+	{
+		pretokenizedSpans = makePretokenizedSpans(pretokenized);
+	}
+
+	py::StringWithOffset<u16string> so;
+	if (pretokenizedSpans.first.empty())
+	{
+		so.str = py::toCpp<u16string>(text);
+	}
+	else
+	{
+		so = py::toCpp<py::StringWithOffset<u16string>>(text);
+		updatePretokenizedSpanToU16(pretokenizedSpans.first, so);
+	}
+
+	task->text = move(so.str);
+	task->spans = move(pretokenizedSpans.first);
+	task->userValues = move(pretokenizedSpans.second);
+	task->topN = topN;
+	task->matchOptions = matchOptions;
+	if (blockList != Py_None)
+	{
+		task->blocklist = &((MorphemeSetObject*)blockList)->morphSet;
+		Py_INCREF(blockList);
+		task->blocklistObj = py::UniqueObj{ blockList };
+	}
+	Py_INCREF(post);
+	task->post = py::UniqueObj{ post };
+	Py_INCREF(this);
+	task->kiwiObj = py::UniqueCObj<KiwiObject>{ this };
+	task->generation = kiwi;
+	task->running = markRunning(kiwi);
+	task->overlay = overlay;
+	task->reWords = reWords;
+	if (reWordValues)
+	{
+		Py_INCREF(reWordValues.get());
+		task->reWordValues = py::UniqueObj{ reWordValues.get() };
+	}
+
+	if (auto* pool = threadPool(*kiwi))
+	{
+		pool->enqueue([task = move(task)](size_t) mutable
+		{
+			tlsOnKiwiWorker = true;
+			task->run();
+			postAsyncResult(move(task));
+		});
+	}
+	else
+	{
+		// without worker threads the analysis runs here, without holding the GIL, and the result is posted right away
+		{
+			py::ReleaseGIL gil;
+			task->run();
+		}
+		auto handle = py::makeNewObject<AsyncAnalyzeResultObject>();
+		auto postFn = std::move(task->post);
+		handle->task = std::move(task);
+		py::UniqueObj ret{ PyObject_CallFunctionObjArgs(postFn.get(), (PyObject*)handle.get(), nullptr) };
+		if (!ret) throw py::ExcPropagation{};
 	}
 }
 
@@ -2452,11 +5309,12 @@ py::UniqueObj KiwiObject::getMorpheme(size_t id)
 {
 	auto ret = py::makeNewObject<TokenObject>();
 	doPrepare();
-	auto* morph = kiwi.idToMorph(id);
+	auto* morph = kiwi->idToMorph(id);
 	if (!morph) throw py::ValueError{ "out of range" };
 	auto joinedForm = joinHangul(morph->getForm());
 	ret->_form = move(joinedForm);
 	ret->_tag = getTagStr(morph->tag, ret->_form);
+	ret->_rawTag = morph->tag;
 	ret->_baseMorph = ret->_morph = morph;
 	ret->_morphId = id;
 	ret->_regularity = !isIrregular(morph->tag);
@@ -2467,7 +5325,7 @@ py::UniqueObj KiwiObject::getMorpheme(size_t id)
 py::UniqueObj KiwiObject::join(PyObject* morphs, bool lmSearch, bool returnPositions)
 {
 	doPrepare();
-	auto joiner = kiwi.newJoiner(!!lmSearch);
+	auto joiner = kiwi->newJoiner(!!lmSearch);
 	size_t prevHash = 0;
 	size_t prevEnd = 0;
 	py::foreach<PyObject*>(morphs, [&](PyObject* item)
@@ -2487,7 +5345,7 @@ py::UniqueObj KiwiObject::join(PyObject* morphs, bool lmSearch, bool returnPosit
 			}
 			else
 			{
-				joiner.add(token._form, token._rawTag, false, space);
+				joiner.add(token.form(), token._rawTag, false, space);
 			}
 			prevHash = token.resultHash;
 			prevEnd = token.end();
@@ -2559,7 +5417,114 @@ void KiwiObject::convertHSData(
 		morphemeDefPathStr = py::toCpp<string>(morphemeDefPath);
 	}
 
-	builder.convertHSData(py::toCpp<vector<string>>(inputPathes), outputPath, morphemeDefPathStr, morphemeDefMinCnt);
+	auto inputs = py::toCpp<vector<string>>(inputPathes);
+	BuilderReading reading{ this };
+	py::ReleaseGIL gil;
+	builder.convertHSData(inputs, outputPath, morphemeDefPathStr, morphemeDefMinCnt);
+}
+
+void KiwiObject::convertHSDataShards(
+	PyObject* inputGroups,
+	PyObject* outputPathes,
+	PyObject* morphemeDefPath,
+	size_t morphemeDefMinCnt,
+	size_t numWorkers,
+	PyObject* onConverted
+) const
+{
+	auto groups = py::toCpp<vector<vector<string>>>(inputGroups);
+	auto outputs = py::toCpp<vector<string>>(outputPathes);
+	if (groups.size() != outputs.size()) throw py::ValueError{ "`input_groups` and `output_pathes` must have the same length." };
+
+	string morphemeDefPathStr;
+	if (morphemeDefPath && morphemeDefPath != Py_None)
+	{
+		morphemeDefPathStr = py::toCpp<string>(morphemeDefPath);
+	}
+
+	BuilderReading reading{ this };
+	// every worker converts with its own copy of `builder`, since `convertHSData` is not known to be safe to call concurrently
+	const size_t numThreads = std::max(std::min(numWorkers, groups.size()), (size_t)1);
+	vector<KiwiBuilder> builders;
+	{
+		py::ReleaseGIL gil;
+		builders.reserve(numThreads);
+		if (numThreads > 1) for (size_t t = 0; t < numThreads; ++t) builders.emplace_back(builder);
+	}
+
+	// indices of the shards finished by the workers, in the order they have finished
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<size_t> finished;
+	// set once a shard has failed, so that the shards not started yet are skipped
+	std::atomic<bool> failed{ false };
+	// written only by the worker of each shard, and read once every worker has finished
+	vector<char> started(groups.size());
+	vector<std::future<void>> futures;
+	futures.reserve(groups.size());
+	// declared last so that the workers are joined before the state above goes away
+	utils::ThreadPool pool{ numThreads };
+	for (size_t i = 0; i < groups.size(); ++i)
+	{
+		futures.emplace_back(pool.enqueue([&, i](size_t threadId)
+		{
+			try
+			{
+				if (!failed.load())
+				{
+					started[i] = 1;
+					(builders.empty() ? builder : builders[threadId]).convertHSData(groups[i], outputs[i], morphemeDefPathStr, morphemeDefMinCnt);
+				}
+			}
+			catch (...)
+			{
+				failed.store(true);
+				std::lock_guard<std::mutex> lock{ mutex };
+				finished.emplace_back(i);
+				cv.notify_one();
+				throw;
+			}
+			std::lock_guard<std::mutex> lock{ mutex };
+			finished.emplace_back(i);
+			cv.notify_one();
+		}));
+	}
+
+	try
+	{
+		for (size_t n = 0; n < groups.size(); ++n)
+		{
+			size_t i;
+			{
+				py::ReleaseGIL gil;
+				std::unique_lock<std::mutex> lock{ mutex };
+				cv.wait(lock, [&]() { return !finished.empty(); });
+				i = finished.front();
+				finished.pop_front();
+			}
+			futures[i].get();
+			if (failed.load()) continue;
+			if (onConverted && onConverted != Py_None)
+			{
+				py::UniqueObj ret{ PyObject_CallFunction(onConverted, "n", (Py_ssize_t)i) };
+				if (!ret) throw py::ExcPropagation{};
+			}
+		}
+	}
+	catch (...)
+	{
+		// stops the remaining shards, then removes every output written by this call, including the ones already finished
+		failed.store(true);
+		{
+			py::ReleaseGIL gil;
+			for (auto& f : futures) if (f.valid()) f.wait();
+		}
+		for (size_t i = 0; i < outputs.size(); ++i)
+		{
+			if (started[i]) std::remove(outputs[i].c_str());
+		}
+		throw;
+	}
 }
 
 py::UniqueObj KiwiObject::makeHSDataset(PyObject* inputPathes, 
@@ -2575,7 +5540,9 @@ py::UniqueObj KiwiObject::makeHSDataset(PyObject* inputPathes,
 	bool separateDefaultMorpheme, 
 	PyObject* morphemeDefPath,
 	size_t morphemeDefMinCnt,
-	size_t seed) const
+	size_t seed,
+	size_t shardIndex,
+	PyObject* datasetType) const
 {
 	KiwiBuilder::TokenFilter tf, wf;
 	if (tokenFilter && tokenFilter != Py_None)
@@ -2607,8 +5574,13 @@ py::UniqueObj KiwiObject::makeHSDataset(PyObject* inputPathes,
 		morphemeDefPathStr = py::toCpp<string>(morphemeDefPath);
 	}
 
+	auto inputs = py::toCpp<vector<string>>(inputPathes);
+	BuilderReading reading{ this };
+	// the filters call into Python, so the GIL is kept only if there are any
+	std::optional<py::ReleaseGIL> gil;
+	if (!tf && !wf) gil.emplace();
 	HSDataset anotherDataset;
-	auto dataset = builder.makeHSDataset(py::toCpp<vector<string>>(inputPathes), 
+	auto dataset = builder.makeHSDataset(inputs, 
 		batchSize, 
 		causalContextSize, 
 		windowSize, 
@@ -2622,19 +5594,32 @@ py::UniqueObj KiwiObject::makeHSDataset(PyObject* inputPathes,
 		morphemeDefPathStr,
 		morphemeDefMinCnt,
 		&anotherDataset);
-	dataset.seed(seed);
-	if (splitRatio == 0)
+	dataset.seed(HSDatasetObject::mixSeed(seed, 0, shardIndex));
+	gil.reset();
+	// the caller may pass a subclass of `_HSDataset` to be instantiated instead
+	if (!datasetType || datasetType == Py_None) datasetType = (PyObject*)py::Type<HSDatasetObject>;
+	else if (!PyType_Check(datasetType) || !PyType_IsSubtype((PyTypeObject*)datasetType, py::Type<HSDatasetObject>))
+	{
+		throw py::ValueError{ "`dataset_type` must be a subclass of `_HSDataset`." };
+	}
+	auto wrap = [&](HSDataset&& d)
 	{
-		py::UniqueObj ret{ PyObject_CallObject((PyObject*)py::Type<HSDatasetObject>, nullptr) };
-		((HSDatasetObject*)ret.get())->hsd = move(dataset);
+		py::UniqueObj ret{ PyObject_CallObject(datasetType, nullptr) };
+		if (!ret) throw py::ExcPropagation{};
+		auto* obj = (HSDatasetObject*)ret.get();
+		obj->hsd = move(d);
+		obj->baseSeed = seed;
+		obj->shardIndex = shardIndex;
 		return ret;
+	};
+	if (splitRatio == 0)
+	{
+		return wrap(move(dataset));
 	}
 	else
 	{
-		py::UniqueObj ret1{ PyObject_CallObject((PyObject*)py::Type<HSDatasetObject>, nullptr) };
-		((HSDatasetObject*)ret1.get())->hsd = move(dataset);
-		py::UniqueObj ret2{ PyObject_CallObject((PyObject*)py::Type<HSDatasetObject>, nullptr) };
-		((HSDatasetObject*)ret2.get())->hsd = move(anotherDataset);
+		auto ret1 = wrap(move(dataset));
+		auto ret2 = wrap(move(anotherDataset));
 		auto ret = py::buildPyTuple(ret1, ret2);
 		return ret;
 	}
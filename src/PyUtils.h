@@ -12,7 +12,11 @@
 #include <iostream>
 #include <cstring>
 #include <deque>
+#include <algorithm>
 #include <future>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include <optional>
 #include <variant>
 #include <numeric>
@@ -29,6 +33,11 @@
 
 #include <frameobject.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PY_UTILS_SSE2
+#include <emmintrin.h>
+#endif
+
 #ifdef USE_NUMPY
 #ifdef MAIN_MODULE
 #else
@@ -183,6 +192,27 @@ namespace py
 	using UniqueObj = UniqueCObj<>;
 	using SharedObj = SharedCObj<>;
 
+	/**
+	 * @brief Releases the GIL for the lifetime of the object and reacquires it on destruction.
+	 * No Python API may be touched while an instance is alive.
+	 */
+	class ReleaseGIL
+	{
+		PyThreadState* state = nullptr;
+	public:
+		ReleaseGIL() : state{ PyEval_SaveThread() }
+		{
+		}
+
+		~ReleaseGIL()
+		{
+			PyEval_RestoreThread(state);
+		}
+
+		ReleaseGIL(const ReleaseGIL&) = delete;
+		ReleaseGIL& operator=(const ReleaseGIL&) = delete;
+	};
+
 	template<class Ty>
 	struct StringWithOffset
 	{
@@ -592,60 +622,135 @@ namespace py
 		}
 	};
 
-	template<>
-	struct ValueBuilder<std::u16string>
+	namespace detail
 	{
-		UniqueObj operator()(const std::u16string& v)
+		inline void widenUcs1(const Py_UCS1* src, char16_t* dst, size_t len)
 		{
-			return UniqueObj{ PyUnicode_DecodeUTF16((const char*)v.data(), v.size() * 2, nullptr, nullptr) };
+			size_t i = 0;
+#ifdef PY_UTILS_SSE2
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 16 <= len; i += 16)
+			{
+				const __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi8(v, zero));
+				_mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+			}
+#endif
+			for (; i < len; ++i) dst[i] = src[i];
 		}
 
-		bool _toCpp(PyObject* obj, std::u16string& out)
+		inline size_t countAstral(const Py_UCS4* src, size_t len)
 		{
-			UniqueObj uobj{ PyUnicode_FromObject(obj) };
-			if (!uobj) return false;
-			size_t len = PyUnicode_GET_LENGTH(uobj.get());
+			size_t n = 0;
+			for (size_t i = 0; i < len; ++i) n += src[i] >= 0x10000;
+			return n;
+		}
 
-			switch (PyUnicode_KIND(uobj.get()))
+		/* narrows the longest prefix of BMP code points 8 at a time and returns its length */
+		inline size_t narrowBmpRun(const Py_UCS4* src, char16_t* dst, size_t len)
+		{
+			size_t i = 0;
+#ifdef PY_UTILS_SSE2
+			// SSE2 has only a signed 32->16 pack, so values are biased into the int16 range and back
+			const __m128i bmpMax = _mm_set1_epi32(0xFFFF);
+			const __m128i bias32 = _mm_set1_epi32(0x8000);
+			const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+			for (; i + 8 <= len; i += 8)
 			{
-			case PyUnicode_1BYTE_KIND:
+				const __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+				const __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 4));
+				if (_mm_movemask_epi8(_mm_or_si128(_mm_cmpgt_epi32(a, bmpMax), _mm_cmpgt_epi32(b, bmpMax)))) break;
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi16(_mm_packs_epi32(_mm_sub_epi32(a, bias32), _mm_sub_epi32(b, bias32)), bias16));
+			}
+#endif
+			return i;
+		}
+
+		/**
+		 * @brief Converts a Python str into UTF-16 without an intermediate object.
+		 * 
+		 * The 2-byte kind is a single memcpy, and the other kinds are widened or narrowed with vectorized loops.
+		 * If `offsets` is given, it receives the UTF-16 position of every code point followed by the total length.
+		 */
+		inline bool toUtf16(PyObject* obj, std::u16string& out, std::vector<size_t>* offsets = nullptr)
+		{
+			UniqueObj uobj;
+			if (!PyUnicode_Check(obj))
 			{
-				auto* p = PyUnicode_1BYTE_DATA(uobj.get());
+				uobj = UniqueObj{ PyUnicode_FromObject(obj) };
+				if (!uobj) return false;
+				obj = uobj.get();
+			}
+#if PY_VERSION_HEX < 0x030C0000
+			if (PyUnicode_READY(obj) < 0) return false;
+#endif
+			const size_t len = PyUnicode_GET_LENGTH(obj);
+			switch (PyUnicode_KIND(obj))
+			{
+			case PyUnicode_1BYTE_KIND:
 				out.resize(len);
-				std::copy(p, p + len, &out[0]);
+				widenUcs1(PyUnicode_1BYTE_DATA(obj), &out[0], len);
 				break;
-			}
 			case PyUnicode_2BYTE_KIND:
-			{
-				auto* p = PyUnicode_2BYTE_DATA(uobj.get());
 				out.resize(len);
-				std::copy(p, p + len, &out[0]);
+				if (len) std::memcpy(&out[0], PyUnicode_2BYTE_DATA(obj), len * sizeof(char16_t));
 				break;
-			}
 			case PyUnicode_4BYTE_KIND:
 			{
-				auto* p = PyUnicode_4BYTE_DATA(uobj.get());
-				out.reserve(len);
+				auto* p = PyUnicode_4BYTE_DATA(obj);
+				// the 4-byte kind always has at least one astral code point, so the output is sized once up front
+				out.resize(len + countAstral(p, len));
+				if (offsets) offsets->resize(len + 1);
+				size_t j = 0;
 				for (size_t i = 0; i < len; ++i)
 				{
-					auto c = p[i];
+					if (!offsets)
+					{
+						const size_t run = narrowBmpRun(p + i, &out[j], len - i);
+						i += run;
+						j += run;
+						if (i >= len) break;
+					}
+					const auto c = p[i];
+					if (offsets) (*offsets)[i] = j;
 					if (c < 0x10000)
 					{
-						out.push_back(c);
+						out[j++] = (char16_t)c;
 					}
 					else
 					{
-						out.push_back(0xD800 - (0x10000 >> 10) + (c >> 10));
-						out.push_back(0xDC00 + (c & 0x3FF));
+						out[j++] = (char16_t)(0xD800 - (0x10000 >> 10) + (c >> 10));
+						out[j++] = (char16_t)(0xDC00 + (c & 0x3FF));
 					}
 				}
-				break;
+				if (offsets) (*offsets)[len] = j;
+				return true;
 			}
 			default:
 				return false;
 			}
+
+			if (offsets)
+			{
+				offsets->resize(len + 1);
+				std::iota(offsets->begin(), offsets->end(), 0);
+			}
 			return true;
 		}
+	}
+
+	template<>
+	struct ValueBuilder<std::u16string>
+	{
+		UniqueObj operator()(const std::u16string& v)
+		{
+			return UniqueObj{ PyUnicode_DecodeUTF16((const char*)v.data(), v.size() * 2, nullptr, nullptr) };
+		}
+
+		bool _toCpp(PyObject* obj, std::u16string& out)
+		{
+			return detail::toUtf16(obj, out);
+		}
 	};
 
 	template<>
@@ -653,57 +758,7 @@ namespace py
 	{
 		bool _toCpp(PyObject* obj, StringWithOffset<std::u16string>& out)
 		{
-			UniqueObj uobj{ PyUnicode_FromObject(obj) };
-			if (!uobj) return false;
-			size_t len = PyUnicode_GET_LENGTH(uobj.get());
-
-			switch (PyUnicode_KIND(uobj.get()))
-			{
-			case PyUnicode_1BYTE_KIND:
-			{
-				auto* p = PyUnicode_1BYTE_DATA(uobj.get());
-				out.str.resize(len);
-				std::copy(p, p + len, &out.str[0]);
-				out.offsets.resize(len + 1);
-				std::iota(out.offsets.begin(), out.offsets.end(), 0);
-				break;
-			}
-			case PyUnicode_2BYTE_KIND:
-			{
-				auto* p = PyUnicode_2BYTE_DATA(uobj.get());
-				out.str.resize(len);
-				std::copy(p, p + len, &out.str[0]);
-				out.offsets.resize(len + 1);
-				std::iota(out.offsets.begin(), out.offsets.end(), 0);
-				break;
-			}
-			case PyUnicode_4BYTE_KIND:
-			{
-				auto* p = PyUnicode_4BYTE_DATA(uobj.get());
-				out.str.reserve(len);
-				out.offsets.reserve(len);
-				for (size_t i = 0; i < len; ++i)
-				{
-					auto c = p[i];
-					if (c < 0x10000)
-					{
-						out.offsets.emplace_back(out.str.size());
-						out.str.push_back(c);
-					}
-					else
-					{
-						out.offsets.emplace_back(out.str.size());
-						out.str.push_back(0xD800 - (0x10000 >> 10) + (c >> 10));
-						out.str.push_back(0xDC00 + (c & 0x3FF));
-					}
-				}
-				out.offsets.emplace_back(out.str.size());
-				break;
-			}
-			default:
-				return false;
-			}
-			return true;
+			return detail::toUtf16(obj, out.str, &out.offsets);
 		}
 	};
 
@@ -1663,6 +1718,38 @@ namespace py
 		friend class TypeWrapper<Derived>;
 	};
 
+	/**
+	 * @brief Counts the finished tasks of a `ResultIter`, so that waiting for any of them can sleep instead of polling.
+	 * A task has to notify only after its result has been made ready.
+	 */
+	class CompletionSignal
+	{
+		std::mutex mutex;
+		std::condition_variable cv;
+		size_t count = 0;
+	public:
+		void notify()
+		{
+			{
+				std::lock_guard<std::mutex> lock{ mutex };
+				++count;
+			}
+			cv.notify_all();
+		}
+
+		size_t current()
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			return count;
+		}
+
+		void waitChange(size_t seen)
+		{
+			std::unique_lock<std::mutex> lock{ mutex };
+			cv.wait(lock, [&]() { return count != seen; });
+		}
+	};
+
 	template<class Derived, class RetTy, class Future = std::future<RetTy>>
 	struct ResultIter : public CObject<Derived>
 	{
@@ -1671,7 +1758,22 @@ namespace py
 		UniqueObj inputIter;
 		std::deque<Future> futures;
 		std::deque<SharedObj> inputItems;
+		std::deque<size_t> inputSizes;
+		std::deque<size_t> inputIndices;
+		size_t numFed = 0;
 		bool echo = false;
+		bool ordered = true;
+
+		/*
+		* The prefetch window is bounded by `maxWindow` items and `maxPendingChars` characters of input in flight.
+		* It doubles whenever the consumer has to wait for the oldest result while it is being worked on (a stall)
+		* and shrinks by one whenever every queued result is already finished, never going below `minWindow`.
+		*/
+		size_t minWindow = 1, maxWindow = 1, windowSize = 1;
+		size_t maxPendingChars = 0, pendingChars = 0;
+		size_t stallCount = 0;
+		// notified by the tasks behind `futures`, see `waitAny`
+		std::shared_ptr<CompletionSignal> completion = std::make_shared<CompletionSignal>();
 
 		ResultIter() = default;
 		ResultIter(ResultIter&&) = default;
@@ -1691,10 +1793,28 @@ namespace py
 			{
 				auto f = std::move(futures.front());
 				futures.pop_front();
+				waitReleasingGIL(f);
 				f.get();
 			}
 		}
 
+		void setWindow(size_t _minWindow, size_t _maxWindow, size_t _maxPendingChars = 0)
+		{
+			minWindow = std::max<size_t>(_minWindow, 1);
+			maxWindow = std::max(_maxWindow, minWindow);
+			windowSize = std::min(minWindow * 2, maxWindow);
+			maxPendingChars = _maxPendingChars;
+		}
+
+		void fill()
+		{
+			while (futures.size() < windowSize)
+			{
+				if (maxPendingChars && pendingChars >= maxPendingChars && !futures.empty()) break;
+				if (!feed()) break;
+			}
+		}
+
 		py::UniqueCObj<Derived> iter() const
 		{
 			Py_INCREF(this);
@@ -1703,19 +1823,28 @@ namespace py
 
 		py::UniqueObj iternext()
 		{
-			if (!feed() && futures.empty()) throw py::ExcPropagation{};
-			auto f = std::move(futures.front());
-			futures.pop_front();
+			if (futures.empty() && !feed()) throw py::ExcPropagation{};
+			const size_t i = ordered ? waitFront() : waitAny();
+			// the result is taken out of the queue only after feeding has succeeded, so that an error raised while feeding does not drop it
+			fill();
+			auto f = std::move(futures[i]);
+			futures.erase(futures.begin() + i);
+			pendingChars -= inputSizes[i];
+			inputSizes.erase(inputSizes.begin() + i);
+			const size_t index = inputIndices[i];
+			inputIndices.erase(inputIndices.begin() + i);
+			SharedObj input;
 			if (echo)
 			{
-				auto input = std::move(inputItems.front());
-				inputItems.pop_front();
-				return buildPyTuple(static_cast<Derived*>(this)->buildPy(f.get()), input);
-			}
-			else
-			{
-				return static_cast<Derived*>(this)->buildPy(f.get());
+				input = std::move(inputItems[i]);
+				inputItems.erase(inputItems.begin() + i);
 			}
+
+			waitReleasingGIL(f);
+			UniqueObj ret = echo ? buildPyTuple(static_cast<Derived*>(this)->buildPy(f.get()), input)
+				: static_cast<Derived*>(this)->buildPy(f.get());
+			if (ordered || !ret) return ret;
+			return buildPyTuple(index, std::move(ret));
 		}
 
 		bool feed()
@@ -1726,11 +1855,30 @@ namespace py
 				if (PyErr_Occurred()) throw ExcPropagation{};
 				return false;
 			}
+			const size_t size = PyUnicode_Check(item.get()) ? PyUnicode_GET_LENGTH(item.get()) : 1;
 			if (echo) inputItems.emplace_back(item);
 			futures.emplace_back(static_cast<Derived*>(this)->feedNext(std::move(item)));
+			inputSizes.emplace_back(size);
+			inputIndices.emplace_back(numFed++);
+			pendingChars += size;
 			return true;
 		}
 
+		size_t getWindowSize() const
+		{
+			return windowSize;
+		}
+
+		size_t getStallCount() const
+		{
+			return stallCount;
+		}
+
+		size_t getPendingChars() const
+		{
+			return pendingChars;
+		}
+
 		Future feedNext(py::SharedObj&& next)
 		{
 			return {};
@@ -1740,6 +1888,90 @@ namespace py
 		{
 			return py::buildPyValue(std::move(v));
 		}
+
+		// starts the work which has been fed but held back, before waiting for any result
+		void flush()
+		{
+		}
+
+	private:
+		template<class Fu>
+		static bool isReady(const Fu& f)
+		{
+			return f.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready;
+		}
+
+		// the workers may need the GIL to finish, so it must not be held while blocking on them
+		template<class Ty>
+		static void waitReleasingGIL(std::future<Ty>& f)
+		{
+			if (isReady(f)) return;
+			ReleaseGIL gil;
+			f.wait();
+		}
+
+		// any other kind of future releases the GIL in its own `get()`
+		template<class Fu>
+		static void waitReleasingGIL(Fu& f)
+		{
+		}
+
+		template<class Fu, class = void>
+		struct HasIsSubmitted : std::false_type {};
+
+		template<class Fu>
+		struct HasIsSubmitted<Fu, std::void_t<decltype(std::declval<const Fu&>().isSubmitted())>> : std::true_type {};
+
+		// a future may stand for work held back by `feedNext`, which no worker can be behind on yet
+		template<class Fu>
+		static bool isSubmitted(const Fu& f)
+		{
+			if constexpr (HasIsSubmitted<Fu>::value) return f.isSubmitted();
+			else return true;
+		}
+
+		void onStall()
+		{
+			++stallCount;
+			windowSize = std::min(windowSize * 2, maxWindow);
+		}
+
+		size_t waitFront()
+		{
+			if (!isReady(futures.front()))
+			{
+				if (isSubmitted(futures.front())) onStall();
+			}
+			else if (windowSize > minWindow && isReady(futures.back())) --windowSize;
+			return 0;
+		}
+
+		/*
+		* Returns the position of the first finished future, sleeping without the GIL on `completion` while none is ready,
+		* so that a long input does not hold back results finished after it.
+		*/
+		size_t waitAny()
+		{
+			for (bool stalled = false;; stalled = true)
+			{
+				// read before scanning, so that a task finishing during the scan wakes the wait below
+				const size_t seen = completion->current();
+				for (size_t i = 0; i < futures.size(); ++i)
+				{
+					if (!isReady(futures[i])) continue;
+					if (!stalled && i == 0 && windowSize > minWindow && isReady(futures.back())) --windowSize;
+					return i;
+				}
+				if (!stalled)
+				{
+					if (std::any_of(futures.begin(), futures.end(), [](const Future& f) { return isSubmitted(f); })) onStall();
+					static_cast<Derived*>(this)->flush();
+					continue;
+				}
+				ReleaseGIL gil;
+				completion->waitChange(seen);
+			}
+		}
 	};
 
 	class Module
@@ -258,6 +258,17 @@ def test_user_value():
     assert tokens[0].user_value == {'tag':'SPECIAL'}
     assert sum(1 for t in tokens if t.user_value is not None) == 1
 
+def test_user_value_snapshot():
+    kiwi = Kiwi()
+    kiwi.add_user_word('사용자단어', user_value={'tag':'OLD'})
+    old_tokens = kiwi.tokenize('사용자단어입니다.')
+    kiwi.add_user_word('사용자단어', user_value={'tag':'NEW'})
+    new_tokens = kiwi.tokenize('사용자단어입니다.')
+    assert old_tokens[0].user_value == {'tag':'OLD'}
+    assert old_tokens[0].tag == 'OLD'
+    assert new_tokens[0].user_value == {'tag':'NEW'}
+    assert new_tokens[0].tag == 'NEW'
+
 def test_user_value_issue168():
     kiwi = Kiwi()
     text = """마크다운 코드가 섞인 문자열
@@ -378,6 +389,66 @@ def test_swtokenizer_batch():
         decoded = tokenizer.decode(token_ids)
         assert s == decoded
 
+def test_swtokenizer_encode_batch():
+    tokenizer = sw_tokenizer.SwTokenizer('Kiwi/test/written.tokenizer.json')
+    strs = [
+        "",
+        "한국어에 특화된 토크나이저입니다.", 
+        "감사히 먹겠습니당!",
+        "제임스웹우주천체망원경",
+    ]
+    refs = [tokenizer.encode(s, return_offsets=True) for s in strs]
+    longest = max(len(ids) for ids, _ in refs)
+    pad_id = tokenizer.pad_token_id or 0
+
+    input_ids, attention_mask, offset_mapping = tokenizer.encode_batch(strs)
+    assert input_ids.dtype.name == 'int32' and input_ids.flags['C_CONTIGUOUS']
+    assert input_ids.shape == attention_mask.shape == (len(strs), longest)
+    assert offset_mapping.shape == (len(strs), longest, 2)
+    for (ids, offsets), row_ids, row_mask, row_offsets in zip(refs, input_ids, attention_mask, offset_mapping):
+        assert row_ids[:len(ids)].tolist() == ids.tolist()
+        assert (row_ids[len(ids):] == pad_id).all()
+        assert row_mask.tolist() == [1] * len(ids) + [0] * (longest - len(ids))
+        assert row_offsets[:len(ids)].tolist() == offsets.tolist()
+        assert (row_offsets[len(ids):] == 0).all()
+
+    res = tokenizer.encode_batch(strs, max_length=3, truncation=True)
+    assert res.input_ids.shape == (len(strs), 3)
+    assert res.input_ids[1].tolist() == refs[1][0][:3].tolist()
+
+    res = tokenizer.encode_batch(strs, max_length=longest + 5, padding='max_length')
+    assert res.input_ids.shape == (len(strs), longest + 5)
+
+    for kwargs in [dict(truncation=True), dict(padding=False), dict(padding='max_length')]:
+        try:
+            tokenizer.encode_batch(strs, **kwargs)
+            assert False
+        except ValueError:
+            pass
+
+def test_swtokenizer_decode_batch():
+    tokenizer = sw_tokenizer.SwTokenizer('Kiwi/test/written.tokenizer.json')
+    strs = [
+        "",
+        "한국어에 특화된 토크나이저입니다.", 
+        "감사히 먹겠습니당!",
+        "노래진 손톱을 봤던걸요.",
+        "그만해여~",
+    ]
+    pad_id = tokenizer.pad_token_id or 0
+    input_ids = tokenizer.encode_batch(strs).input_ids
+    assert tokenizer.decode_batch(input_ids, pad_token_id=pad_id) == strs
+    assert tokenizer.decode_batch(input_ids.astype('int64'), pad_token_id=pad_id) == strs
+    assert tokenizer.decode_batch(list(tokenizer.encode(strs))) == strs
+    assert tokenizer.decode_batch([ids.tolist() for ids in tokenizer.encode(strs)]) == strs
+    assert tokenizer.decode_batch([]) == []
+
+    try:
+        tokenizer.decode_batch([[len(tokenizer)]])
+        assert False
+    except ValueError:
+        pass
+
 def test_swtokenizer_morph():
     tokenizer = sw_tokenizer.SwTokenizer('Kiwi/test/written.tokenizer.json')
     
@@ -403,6 +474,42 @@ def test_swtokenizer_morph():
 
     assert offsets.tolist() == [[0, 1], [1, 2], [2, 3], [3, 4], [4, 5], [5, 6], [5, 6], [5, 6], [6, 7], [7, 8], [8, 9]]
 
+def test_swtokenizer_morph_arrays():
+    tokenizer = sw_tokenizer.SwTokenizer('Kiwi/test/written.tokenizer.json')
+    sents = [
+        "한국어에 특화된 토크나이저입니다.",
+        "감사히 먹겠습니당!",
+    ]
+    batch_ids, batch_forms, refs = [], [], []
+    for sent in sents:
+        tokens = tokenizer.kiwi.tokenize(sent, normalize_coda=True, z_coda=True)
+        spaces = [i > 0 and t.start > tokens[i - 1].end for i, t in enumerate(tokens)]
+        refs.append(tokenizer.encode_from_morphs([(t.form, t.tag, s) for t, s in zip(tokens, spaces)], return_offsets=True))
+
+        arrays = tokenizer.kiwi.analyze(sent, normalize_coda=True, z_coda=True, output='arrays')[0][0]
+        batch_ids.append((arrays.id, spaces))
+        batch_forms.append((arrays.form, arrays.form_offsets, arrays.tag, spaces))
+
+    for ids_arrays, form_arrays, (ref_ids, ref_offsets) in zip(batch_ids, batch_forms, refs):
+        assert tokenizer.encode_from_morph_arrays(ids_arrays).tolist() == ref_ids.tolist()
+        token_ids, offsets = tokenizer.encode_from_morph_arrays(form_arrays, return_offsets=True)
+        assert token_ids.tolist() == ref_ids.tolist()
+        assert offsets.tolist() == ref_offsets.tolist()
+        forms, form_offsets, tags, spaces = form_arrays
+        assert tokenizer.encode_from_morph_arrays((forms, form_offsets.tolist(), tags, spaces)).tolist() == ref_ids.tolist()
+
+    for batch in (batch_ids, batch_forms):
+        res = tokenizer.encode_from_morph_arrays_batch(batch, return_offsets=True)
+        assert [(i.tolist(), o.tolist()) for i, o in res] == [(i.tolist(), o.tolist()) for i, o in refs]
+
+    ids, _ = batch_ids[0]
+    for arrays in [(ids, [False]), ([-1], None), ('ab', [0, 1], [1, 2], None)]:
+        try:
+            tokenizer.encode_from_morph_arrays(arrays)
+            assert False
+        except ValueError:
+            pass
+
 def test_swtokenizer_tokenize_encode():
     tokenizer = sw_tokenizer.SwTokenizer('Kiwi/test/written.tokenizer.json')
     sents = [
@@ -526,6 +633,485 @@ def test_analyze_single():
         print(t.form, t.tag, t.start, t.end, t.len, t.id, t.base_form, t.base_id)
         break
 
+def test_analyze_arrays():
+    kiwi = Kiwi()
+    text = "형태소 분석 결과를 배열로 받아봅시다. 😀이모지도 포함해서요"
+    tokens, score = kiwi.analyze(text)[0]
+    arrays, arr_score = kiwi.analyze(text, output='arrays')[0]
+    assert score == arr_score
+    assert len(arrays.id) == len(tokens)
+    for i, t in enumerate(tokens):
+        assert arrays.start[i] == t.start
+        assert arrays.len[i] == t.len
+        assert arrays.sent_position[i] == t.sent_position
+        assert arrays.form[arrays.form_offsets[i]:arrays.form_offsets[i + 1]] == t.form
+        assert arrays.tag_names[arrays.tag[i]] == t.tag.replace('-R', '')
+
+    for (tokens, _), (arrays, _) in zip(kiwi.analyze([text] * 4), kiwi.analyze([text] * 4, output='arrays')):
+        assert list(arrays.id) == [t.id for t in tokens]
+
+def test_prefetch_window():
+    kiwi = Kiwi(num_workers=2)
+    kiwi.prefetch_items = 4
+    kiwi.prefetch_chars = 1000
+    lines = [line.strip() for line in open(curpath + '/test_corpus/constitution.txt', encoding='utf-8')]
+    it = kiwi.analyze(lines)
+    assert 1 <= it.window_size <= 4
+    max_line = max(len(line) for line in lines)
+    results = []
+    for res in it:
+        assert it.window_size <= 4
+        # feeding stops once the limit is reached, so it is exceeded by at most one input
+        assert it.pending_chars < 1000 + max_line
+        results.append(res)
+    assert it.pending_chars == 0
+    assert it.stall_count <= len(lines)
+    assert len(results) == len(lines)
+    for line, res in zip(lines, results):
+        assert kiwi.analyze(line)[0][1] == res[0][1]
+
+def test_prefetch_keeps_result_on_feed_error():
+    kiwi = Kiwi(num_workers=2)
+    first, second = '첫 번째 문장입니다.', '두 번째 문장입니다.'
+    it = kiwi.analyze(iter([first, 1, second]))
+    try:
+        next(it)
+        assert False
+    except ValueError:
+        pass
+    assert next(it)[0][1] == kiwi.analyze(first)[0][1]
+    assert next(it)[0][1] == kiwi.analyze(second)[0][1]
+
+def test_unordered_results():
+    kiwi = Kiwi(num_workers=2)
+    lines = [line.strip() for line in open(curpath + '/test_corpus/constitution.txt', encoding='utf-8')]
+    lines = ['\n'.join(lines)] + lines
+    expected = list(kiwi.tokenize(lines))
+    unordered = list(kiwi.tokenize(lines, ordered=False))
+    assert sorted(idx for idx, _ in unordered) == list(range(len(lines)))
+    for idx, tokens in unordered:
+        assert [t.form_tag for t in tokens] == [t.form_tag for t in expected[idx]]
+
+    for idx, res in kiwi.analyze(lines, ordered=False):
+        assert res[0][1] == kiwi.analyze(lines[idx])[0][1]
+
+    for idx, sents in kiwi.split_into_sents(lines, ordered=False):
+        assert [s.text for s in sents] == [s.text for s in kiwi.split_into_sents(lines[idx])]
+
+def test_batch_without_thread_pool():
+    kiwi = Kiwi(num_workers=1)
+    lines = [line.strip() for line in open(curpath + '/test_corpus/constitution.txt', encoding='utf-8')][:50]
+    expected = [[t.form_tag for t in kiwi.tokenize(line)] for line in lines]
+    assert [[t.form_tag for t in tokens] for tokens in kiwi.tokenize(lines)] == expected
+    for idx, tokens in kiwi.tokenize(lines, ordered=False):
+        assert [t.form_tag for t in tokens] == expected[idx]
+
+def test_micro_batch():
+    kiwi = Kiwi(num_workers=2)
+    lines = [line.strip() for line in open(curpath + '/../benchmark/sentence_split/testset/tweets.txt', encoding='utf-8')][:200]
+    kiwi.micro_batch_chars = 0
+    expected = [[t.form_tag for t in tokens] for tokens in kiwi.tokenize(lines)]
+    kiwi.micro_batch_chars = 4096
+    assert [[t.form_tag for t in tokens] for tokens in kiwi.tokenize(lines)] == expected
+    for idx, tokens in kiwi.tokenize(lines, ordered=False):
+        assert [t.form_tag for t in tokens] == expected[idx]
+
+def test_micro_batch_stall_count():
+    # without a thread pool a micro-batch is analyzed only once its first result is waited for, which is not a stall
+    kiwi = Kiwi(num_workers=1)
+    kiwi.micro_batch_chars = 4096
+    lines = [line.strip() for line in open(curpath + '/../benchmark/sentence_split/testset/tweets.txt', encoding='utf-8')][:200]
+    it = kiwi.analyze(lines)
+    assert sum(1 for _ in it) == len(lines)
+    assert it.stall_count == 0
+
+def test_analyze_async():
+    import asyncio
+    kiwi = Kiwi(num_workers=2)
+    lines = [line.strip() for line in open(curpath + '/test_corpus/constitution.txt', encoding='utf-8')][:50]
+
+    async def _run():
+        tokens = await asyncio.gather(*(kiwi.tokenize_async(line) for line in lines))
+        sents = await kiwi.tokenize_async(' '.join(lines[:5]), split_sents=True)
+        res = await kiwi.analyze_async(lines[0], top_n=2)
+        return tokens, sents, res
+
+    tokens, sents, res = asyncio.run(_run())
+    for line, toks in zip(lines, tokens):
+        assert [t.form_tag for t in toks] == [t.form_tag for t in kiwi.tokenize(line)]
+    assert len(sents) == len(kiwi.tokenize(' '.join(lines[:5]), split_sents=True))
+    assert res[0][1] == kiwi.analyze(lines[0], top_n=2)[0][1]
+
+def test_model_dir():
+    import tempfile
+    kiwi = Kiwi()
+    kiwi.add_user_word('저장단어', 'NNP', user_value={'tag':'SNAP'})
+    kiwi.space_tolerance = 1
+    text = '저장단어가 저장된 뒤에도 그대로 분석되어야 합니다.'
+    expected = [t.form_tag for t in kiwi.tokenize(text)]
+    with tempfile.TemporaryDirectory() as path:
+        kiwi.save_model_dir(path)
+        loaded = Kiwi.load_model_dir(path)
+        assert [t.form_tag for t in loaded.tokenize(text)] == expected
+        assert loaded.space_tolerance == 1
+
+def test_model_dir_re_words():
+    import tempfile
+    kiwi = Kiwi()
+    kiwi.add_re_word(r'[0-9]+냥쭝', 'NNG', {'tag':'UNIT'})
+    text = '10냥쭝을 바쳤다.'
+    expected = [(t.form, t.tag) for t in kiwi.tokenize(text)]
+    with tempfile.TemporaryDirectory() as path:
+        kiwi.save_model_dir(path)
+        loaded = Kiwi.load_model_dir(path)
+        assert [(t.form, t.tag) for t in loaded.tokenize(text)] == expected
+        assert expected[0] == ('10냥쭝', 'UNIT')
+
+    kiwi.add_re_word(r'[a-z]+', lambda m: [])
+    with tempfile.TemporaryDirectory() as path:
+        try:
+            kiwi.save_model_dir(path)
+            assert False
+        except ValueError:
+            pass
+        import os
+        assert not os.listdir(path)
+
+def test_prepare_and_fork():
+    import multiprocessing as mp
+    if 'fork' not in mp.get_all_start_methods(): return
+
+    kiwi = Kiwi(num_workers=2)
+    kiwi.prepare()
+    texts = ['fork 이후에도 분석이 가능해야 합니다.'] * 32
+    expected = [[t.form_tag for t in r] for r in kiwi.tokenize(texts)]
+
+    def _child(queue):
+        queue.put([[t.form_tag for t in r] for r in kiwi.tokenize(texts)])
+
+    ctx = mp.get_context('fork')
+    queue = ctx.Queue()
+    proc = ctx.Process(target=_child, args=(queue,))
+    proc.start()
+    assert queue.get(timeout=60) == expected
+    proc.join(timeout=60)
+    assert proc.exitcode == 0
+
+def test_overlay_words():
+    kiwi = Kiwi()
+    kiwi.tokenize('미리 구축해둡니다')
+    assert kiwi.add_overlay_words(['갤럭시S24', ('큐브폰', 'NNG')]) == 2
+    assert kiwi.add_overlay_words([('큐브폰', 'NNP')]) == 0
+    assert kiwi.overlay_size == 2
+    tokens = kiwi.tokenize('갤럭시S24와 큐브폰을 비교했다')
+    assert tokens[0].form_tag == ('갤럭시S24', 'NNP')
+    assert ('큐브폰', 'NNP') in [t.form_tag for t in tokens]
+
+    texts = ['큐브폰을 샀다'] * 8
+    it = kiwi.tokenize(iter(texts))
+    kiwi.clear_overlay()
+    assert kiwi.overlay_size == 0
+    assert all(r[0].form_tag == ('큐브폰', 'NNP') for r in it)
+
+def test_overlay_word_boundary():
+    kiwi = Kiwi()
+    assert kiwi.add_overlay_words([('큐브', 'NNP'), ('S2', 'SL')]) == 2
+    assert ('큐브', 'NNP') in [t.form_tag for t in kiwi.tokenize('큐브를 샀다')]
+    assert ('큐브', 'NNP') not in [t.form_tag for t in kiwi.tokenize('루빅스큐브를 샀다')]
+    assert 'S2' not in [t.form for t in kiwi.tokenize('갤럭시 S24를 샀다')]
+    assert ('S2', 'SL') in [t.form_tag for t in kiwi.tokenize('S2를 샀다')]
+
+def test_background_rebuild():
+    import time
+    import gc
+    kiwi = Kiwi()
+    kiwi.tokenize('먼저 모델을 구축합니다')
+    generation = kiwi.generation_stats['generation']
+    texts = ['재구축테스트단어를 분석합니다'] * 8
+    it = kiwi.tokenize(iter(texts))
+    kiwi.add_user_word('재구축테스트단어', 'NNP')
+    kiwi.rebuild(background=True)
+    while kiwi.generation_stats['rebuilding']:
+        kiwi.tokenize('구축 중에도 분석은 계속됩니다')
+        time.sleep(0.01)
+
+    stats = kiwi.generation_stats
+    assert stats['generation'] == generation + 1
+    assert stats['last_swap_latency'] >= 0
+    assert kiwi.tokenize('재구축테스트단어를')[0].form == '재구축테스트단어'
+
+    old_results = list(it)
+    assert len(old_results) == len(texts)
+    del it, old_results
+    gc.collect()
+    assert kiwi.generation_stats['alive_generations'] == 1
+
+def test_background_rebuild_on_release():
+    kiwi = Kiwi()
+    kiwi.tokenize('먼저 모델을 구축합니다')
+    kiwi.add_user_word('해제테스트단어', 'NNP')
+    kiwi.rebuild(background=True)
+    # the build thread is joined, not left running, when the object goes away
+    del kiwi
+
+def test_settings_during_analysis():
+    kiwi = Kiwi(num_workers=2)
+    texts = ['설정을 바꾸는 동안에도 분석은 이어져야 합니다.'] * 64
+    it = kiwi.tokenize(iter(texts))
+    next(it)
+    kiwi.space_tolerance = 1
+    kiwi.cutoff_threshold = 6
+    assert kiwi.space_tolerance == 1
+    assert kiwi.cutoff_threshold == 6
+    assert len(list(it)) == len(texts) - 1
+
+def test_add_user_words_bulk():
+    kiwi = Kiwi()
+    ids, inserted = kiwi.add_user_words_bulk(['벌크단어가', '벌크단어나', '벌크단어가'], ['NNP', 'NNG', 'NNP'], [0., 1., 0.])
+    assert list(inserted) == [True, True, False]
+    assert ids[0] == ids[2]
+    assert kiwi.tokenize('벌크단어나')[0].form_tag == ('벌크단어나', 'NNG')
+
+    ids, inserted = kiwi.add_user_words_bulk(['벌크단어다', '벌크단어라'], 'NNP')
+    assert list(inserted) == [True, True]
+
+    try:
+        kiwi.add_user_words_bulk(['벌크단어마'], ['NNP', 'NNG'])
+        assert False
+    except ValueError:
+        pass
+
+def test_native_re_words():
+    from kiwipiepy import _re_native
+
+    for pat in [r'\{[^}]+\}', r'https?://\S+', r'(?i)sku-\d+', r'[\U0001F600-\U0001F64F]+', r'\d+$']:
+        assert _re_native.translate(re.compile(pat)) is not None, pat
+    for pat in [r'(?<=\{)[^}]+', r'\bword\b', re.compile(r'^a', re.MULTILINE), r'(?i:a)b']:
+        assert _re_native.translate(re.compile(pat) if isinstance(pat, str) else pat) is None, pat
+    assert _re_native.translate(re.compile(r'SKU-\d+')).prefix == 'SKU-'
+
+    kiwi = Kiwi()
+    text = '주문 SKU-1234 상품은 https://example.com/a 에서 {평만경} 확인 😀😀'
+    kiwi.add_re_word(r'(?i)sku-\d+', 'NNP', {'tag':'SKU'})
+    kiwi.add_re_word(r'https?://\S+', 'SL')
+    kiwi.add_re_word(r'[\U0001F600-\U0001F64F]+', 'SW')
+    # matched in Python, and takes precedence over the overlapping native pattern below
+    kiwi.add_re_word(r'\{([^}]+)\}', lambda m:PretokenizedToken(m.group(1), 'NNP', 1, len(m.group(0)) - 1))
+    kiwi.add_re_word(r'\{평', 'NNG')
+    assert kiwi._re_words_dirty
+
+    for tokens in [kiwi.tokenize(text), next(kiwi.tokenize([text]))]:
+        assert len(kiwi._py_pretokenized_pats) == 1
+        by_form = {t.form:t for t in tokens}
+        assert by_form['SKU-1234'].tag == 'SKU'
+        assert by_form['SKU-1234'].user_value == {'tag':'SKU'}
+        assert by_form['https://example.com/a'].tag == 'SL'
+        assert by_form['😀😀'].tag == 'SW'
+        assert by_form['😀😀'].span == (text.index('😀'), len(text))
+        assert by_form['평만경'].tag == 'NNP'
+        assert '{평' not in by_form
+
+    kiwi.clear_re_words()
+    tokens = kiwi.tokenize(text)
+    assert not any(t.form == 'SKU-1234' for t in tokens)
+
+def test_native_re_words_match_python():
+    text = '주문번호 A-12, B-345와 x9 및 sku-77을 확인 바랍니다. 010-1234-5678'
+    patterns = [(r'[A-Z]-\d+', 'NNP'), (r'\d*x\d', 'SL'), (r'(?i)sku-\d+', 'NNP'), (r'\d{3}-\d{4}-\d{4}', 'SN')]
+    native, python = Kiwi(), Kiwi()
+    for pat, tag in patterns:
+        native.add_re_word(pat, tag)
+        python.add_re_word(pat, lambda m, tag=tag: tag)
+    expected = [t.form_tag for t in python.tokenize(text)]
+    assert [t.form_tag for t in native.tokenize(text)] == expected
+    assert not native._py_pretokenized_pats
+
+    # `space` does not use the patterns of `add_re_word`
+    assert native.space('A-12를 확인 바랍니다') == Kiwi().space('A-12를 확인 바랍니다')
+
+    # a match is cut instead of recursing over the whole run
+    native.add_re_word(r'[a-z]+', 'SL')
+    tokens = native.tokenize('a' * 20000)
+    assert tokens[0].start == 0
+
+def test_split_into_sents_output():
+    kiwi = Kiwi()
+    text = "회사의 정보 서비스를 책임지고 있는 로웬버그John Loewenberg는 <서비스 산업에 있어 종이는 혈관내의 콜레스트롤과 같다. 나쁜 종이는 동맥을 막는 내부의 물질이다.> 라고 말한다. 😀 이모지 뒤의 문장"
+    sents = kiwi.split_into_sents(text, return_tokens=True)
+    tokens = kiwi.tokenize(text)
+    assert [(t.form, t.tag, t.span) for s in sents for t in s.tokens] == [(t.form, t.tag, t.span) for t in tokens]
+    for s in sents:
+        assert s.text == text[s.start:s.end]
+        assert s.start == s.tokens[0].start and s.end == s.tokens[-1].end
+    assert [s.text for s in sents[0].subs] == ['서비스 산업에 있어 종이는 혈관내의 콜레스트롤과 같다.', '나쁜 종이는 동맥을 막는 내부의 물질이다.']
+    assert all(sub.subs is None and sub.tokens for sub in sents[0].subs)
+    assert sents[-1].text == '이모지 뒤의 문장'
+
+    plain = kiwi.split_into_sents(text, return_sub_sents=False)
+    assert all(s.tokens is None and s.subs is None for s in plain)
+    assert [s.text for s in plain] == [s.text for s in sents]
+
+    spans = kiwi.split_into_sents(text, output='spans')
+    assert spans.shape == (len(sents), 2)
+    assert spans.tolist() == [[s.start, s.end] for s in sents]
+
+    spans, arrays = kiwi.split_into_sents(text, output='arrays')
+    assert spans.tolist() == [[s.start, s.end] for s in sents]
+    assert arrays.start.tolist() == [t.start for t in tokens]
+
+    for s in kiwi.split_into_sents([text, text], output='spans'):
+        assert s.tolist() == spans.tolist()
+    assert kiwi.split_into_sents('', output='spans').shape == (0, 2)
+
+    stopwords = Stopwords()
+    filtered = kiwi.split_into_sents(text, return_tokens=True, stopwords=stopwords)
+    assert [t.span for s in filtered for t in s.tokens] == [t.span for t in stopwords.filter(tokens)]
+
+def test_token_outlives_result():
+    kiwi = Kiwi()
+    kiwi.add_user_word('사용자단어', user_value={'tag':'USER_TAG'})
+    token = kiwi.tokenize('사용자단어를 나중에 읽어봅시다')[0]
+    import gc
+    gc.collect()
+    assert token.form == '사용자단어'
+    assert token.tag == 'USER_TAG'
+    assert token.user_value == {'tag':'USER_TAG'}
+    assert token.raw_form == token.form
+    assert token.tagged_form == '사용자단어/USER_TAG'
+
+def _write_hs_corpus(path, kiwi, lines):
+    # one `surface\tform\ttag\tform\ttag...` line per word, and an empty line after every sentence
+    with open(path, 'w', encoding='utf-8') as f:
+        for line in lines:
+            words = {}
+            for t in kiwi.tokenize(line):
+                words.setdefault(t.word_position, []).append(t)
+            for ws in words.values():
+                f.write('\t'.join([line[ws[0].start:ws[-1].end]] + [x for t in ws for x in (t.form, t.tag)]) + '\n')
+            f.write('\n')
+
+def _batch_to_list(batch):
+    return [a.tolist() if hasattr(a, 'tolist') else a for a in batch]
+
+def test_hsdataset_prefetch():
+    kiwi = Kiwi()
+    lines = [l.strip() for l in open(curpath + '/test_corpus/constitution.txt', encoding='utf-8') if l.strip()][:80]
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, 'corpus.txt')
+        _write_hs_corpus(path, kiwi, lines)
+        make = lambda: kiwi.make_hsdataset([path], batch_size=4, window_size=4, seed=7)
+
+        ref = [_batch_to_list(b) for b in make()]
+        assert len(ref) > 4
+
+        dataset = make()
+        kept = list(dataset.prefetch(num_buffers=2))
+        # every batch is kept, so none of their buffers may have been refilled
+        assert [_batch_to_list(b) for b in kept] == ref
+
+        dataset = make()
+        exported = []
+        for i, batch in enumerate(dataset.prefetch(num_buffers=1)):
+            # only a buffer exported from the batch is kept, which must still protect it
+            exported.append((memoryview(batch[1]), batch[1].tolist()))
+            del batch
+        assert len(exported) == len(ref)
+        assert all(m.tolist() == l for m, l in exported)
+        del exported
+
+        dataset = make()
+        released = [_batch_to_list(b) for b in dataset.prefetch(num_buffers=2)]
+        assert released == ref
+
+        dataset = make()
+        old = dataset.prefetch()
+        next(old)
+        new = iter(dataset)
+        try:
+            next(old)
+            assert False
+        except StopIteration:
+            pass
+        assert next(new) is not None
+
+def test_hsdataset_num_batches():
+    kiwi = Kiwi()
+    lines = [l.strip() for l in open(curpath + '/test_corpus/constitution.txt', encoding='utf-8') if l.strip()][:80]
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, 'corpus.txt')
+        _write_hs_corpus(path, kiwi, lines)
+        dataset = kiwi.make_hsdataset([path], batch_size=4, window_size=4, seed=7)
+        total = sum(1 for _ in dataset)
+
+        for num_batches in (total // 2, total * 2 + 1):
+            dataset.set_num_batches(num_batches)
+            assert len(dataset) == num_batches
+            assert sum(1 for _ in dataset) == num_batches
+            assert sum(1 for _ in dataset.prefetch()) == num_batches
+
+        dataset.set_num_batches(None)
+        assert sum(1 for _ in dataset) == total
+
+def test_hsdata_shard_grouping():
+    from kiwipiepy._wrap import _group_by_size
+    assert _group_by_size([3, 4, 2, 10, 1], 7) == [[0, 1], [2], [3], [4]]
+    assert _group_by_size([3, 4, 2, 10, 1], 100) == [[0, 1, 2, 3, 4]]
+    assert _group_by_size([3, 4, 2], None) == [[0], [1], [2]]
+    assert _group_by_size([], 7) == []
+
+def test_hsdata_manifest():
+    from kiwipiepy._wrap import StreamingHSDataset
+    with tempfile.TemporaryDirectory() as tmp:
+        shards = [os.path.join(tmp, 'corpus.hsdata.{:05d}'.format(i)) for i in range(3)]
+        manifest = os.path.join(tmp, 'corpus.hsdata')
+        StreamingHSDataset._write_manifest(manifest, shards)
+        assert StreamingHSDataset._is_manifest(manifest)
+        assert StreamingHSDataset._read_manifest(manifest) == shards
+        assert StreamingHSDataset._read_manifest_vocab(manifest) is None
+
+        args = dict(batch_size=4, window_size=8, token_filter=None, morpheme_def_path=None, morpheme_def_min_cnt=0, separate_default_morpheme=False)
+        vocab = dict(vocab_size=2, knlm_vocab_size=3, ngram_node_size=5, vocab=[('가', 'NNG'), ('나', 'NP')], settings=StreamingHSDataset._vocab_settings(args))
+        StreamingHSDataset._write_manifest(manifest, shards, vocab)
+        assert StreamingHSDataset._read_manifest(manifest) == shards
+        dataset = StreamingHSDataset(None, shards, 4, 0, args, StreamingHSDataset._read_manifest_vocab(manifest))
+        # the properties come from the manifest, so no shard has to be read
+        assert dataset.vocab_size == 2
+        assert dataset.get_vocab_info(1) == ('나', 'NP')
+        assert dataset.batch_size == 4 and dataset.window_size == 8
+        dataset = StreamingHSDataset(None, shards, 4, 0, dict(args, separate_default_morpheme=True), StreamingHSDataset._read_manifest_vocab(manifest))
+        assert dataset._meta is None
+
+        other = os.path.join(tmp, 'other.json')
+        with open(other, 'w', encoding='utf-8') as f:
+            f.write('{"shards": []}')
+        assert not StreamingHSDataset._is_manifest(other)
+        try:
+            StreamingHSDataset._read_manifest(other)
+            assert False
+        except ValueError:
+            pass
+
+def test_hsdata_shard_paths():
+    import warnings
+    from kiwipiepy._wrap import _shard_paths
+    with tempfile.TemporaryDirectory() as tmp:
+        paths = []
+        for i, size in enumerate([50, 10, 30, 20, 40]):
+            paths.append(os.path.join(tmp, 'f{}'.format(i)))
+            with open(paths[-1], 'wb') as f:
+                f.write(b'0' * size)
+
+        shards = _shard_paths(paths, 2)
+        assert sorted(p for s in shards for p in s) == sorted(paths)
+        assert [[paths.index(p) for p in s] for s in shards] == [[0, 1, 3], [2, 4]]
+        assert _shard_paths(paths, 2) == shards
+
+        with warnings.catch_warnings(record=True) as w:
+            warnings.simplefilter('always')
+            shards = _shard_paths(paths[:2], 3)
+        assert len(w) == 1
+        assert shards == [[paths[0]], [paths[1]], [paths[0]]]
+
 def test_extract_words():
     kiwi = Kiwi()
     ret = kiwi.extract_words(FileReader(curpath + '/test_corpus/constitution.txt'), min_cnt=2)
@@ -592,6 +1178,15 @@ def test_tokenize():
     for tokens in tokens_by_sent:
         print(tokens)
 
+def test_tokenize_multithreaded():
+    from concurrent.futures import ThreadPoolExecutor
+    kiwi = Kiwi()
+    texts = [line.strip() for line in open(curpath + '/../benchmark/sentence_split/testset/tweets.txt', encoding='utf-8') if line.strip()]
+    expected = [[t.form_tag for t in kiwi.tokenize(text)] for text in texts]
+    with ThreadPoolExecutor(4) as pool:
+        results = list(pool.map(lambda text:[t.form_tag for t in kiwi.tokenize(text)], texts))
+    assert results == expected
+
 def test_tokenize_with_stopwords():
     kiwi = Kiwi()
     stopwords = Stopwords()
@@ -713,6 +1308,16 @@ def test_space_issue_189():
     assert kiwi.space('담아 1팩 무료') == '담아 1팩 무료'
     assert kiwi.space('골라 2팩 무료') == '골라 2팩 무료'
 
+def test_space_batch_reset_whitespace():
+    kiwi = Kiwi()
+    texts = [
+        "<Kiwipiepy>는 형 태 소 분 석 기 이 에 요~ 0.11.0 버 전 이 나 왔 어 요 .",
+        "3 시 30 분 45 초",
+        "",
+    ]
+    assert list(kiwi.space(texts, reset_whitespace=True)) == [kiwi.space(t, reset_whitespace=True) for t in texts]
+    assert list(kiwi.space(iter(texts))) == [kiwi.space(t) for t in texts]
+
 def test_glue():
     chunks = """KorQuAD 2.0은 총 100,000+ 쌍으로 구성된 한국어 질의응답 데이터셋이다. 기존 질의응답 표준 데이
 터인 KorQuAD 1.0과의 차이점은 크게 세가지가 있는데 첫 번째는 주어지는 지문이 한두 문단이 아닌 위
@@ -727,10 +1332,45 @@ Multilingual을 활용하여 실험한 결과 F1 스코어 46.0%의 성능을 
     ret, space_insertions = kiwi.glue(chunks, return_space_insertions=True)
     assert space_insertions == [False, False, True, False, True, True, True]
 
+def test_glue_whole_chunks():
+    chunks = """KorQuAD 2.0은 총 100,000+ 쌍으로 구성된 한국어 질의응답 데이터셋이다. 기존 질의응답 표준 데이
+터인 KorQuAD 1.0과의 차이점은 크게 세가지가 있는데 첫 번째는 주어지는 지문이 한두 문단이 아닌 위
+키백과 한 페이지 전체라는 점이다. 두 번째로 지문에 표와 리스트도 포함되어 있기 때문에 HTML tag로
+구조화된 문서에 대한 이해가 필요하다. 마지막으로 답변이 단어 혹은 구의 단위뿐 아니라 문단, 표, 리
+스트 전체를 포괄하는 긴 영역이 될 수 있다. Baseline 모델로 구글이 오픈소스로 공개한 BERT
+Multilingual을 활용하여 실험한 결과 F1 스코어 46.0%의 성능을 확인하였다. 이는 사람의 F1 점수
+85.7%에 비해 매우 낮은 점수로, 본 데이터가 도전적인 과제임을 알 수 있다. 본 데이터의 공개를 통해
+평문에 국한되어 있던 질의응답의 대상을 다양한 길이와 형식을 가진 real world task로 확장하고자 한다""".split('\n')
+
+    kiwi = Kiwi()
+    # the boundaries scored over both whole chunks, as `glue` did before `window` was added
+    expected = []
+    for prev, s in zip(chunks, chunks[1:]):
+        _, score_with_space = kiwi.analyze(prev + ' ' + s)[0]
+        _, score_without_space = kiwi.analyze(prev + s)[0]
+        expected.append(score_with_space >= score_without_space or re.search(r'[0-9A-Za-z]$', prev) is not None)
+    
+    ret, space_insertions = kiwi.glue(chunks, return_space_insertions=True)
+    assert space_insertions == expected
+    assert ret == ''.join(c + (' ' if i else '') for c, i in zip(chunks, expected + [False]))
+    assert kiwi.glue(chunks, window=0) == ret
+
 def test_glue_empty():
     kiwi = Kiwi()
     kiwi.glue([])
 
+def test_space_insertions():
+    kiwi = Kiwi()
+    chunks = ["그러나  알고보니 그 봉", "지 안에 있던 것은 바로", "레몬이었던 것이다.", "KorQuAD", "2.0은 데이터셋이다."]
+    insertions = kiwi.space_insertions(chunks)
+    assert insertions.dtype == bool
+    assert insertions.tolist() == [False, True, True, True]
+    assert kiwi.space_insertions(chunks, window=0).tolist() == insertions.tolist()
+    assert kiwi.glue(chunks, return_space_insertions=True)[1] == insertions.tolist()
+    assert kiwi.glue(chunks, insert_new_lines=[False, True, False, False]) == "그러나  알고보니 그 봉지 안에 있던 것은 바로\n레몬이었던 것이다. KorQuAD 2.0은 데이터셋이다."
+    assert len(kiwi.space_insertions(["하나"])) == 0
+    assert len(kiwi.space_insertions([])) == 0
+
 def test_join():
     kiwi = Kiwi()
     tokens = kiwi.tokenize("이렇게 형태소로 분해된 문장을 다시 합칠 수 있을까요?")
@@ -814,6 +1454,52 @@ def test_sbg():
     kiwi = Kiwi(model_type='sbg')
     print(kiwi.tokenize('이 번호로 전화를 이따가 꼭 반드시 걸어.'))
 
+def test_knlm_batch():
+    import numpy as np
+    from kiwipiepy.knlm import KNLangModel
+
+    train = [[(i * 7 + j * 3) % 16 + 4 for j in range(20 + i % 5)] for i in range(50)]
+    model = KNLangModel.from_arrays(train, ngram_size=3, min_cf=1, bos_token_id=1, eos_token_id=2, unk_token_id=3, num_workers=2)
+    seqs = [[4, 5, 6, 7, 8], [9, 10], [11, 12, 13, 14, 15, 16, 17], [4], [7, 10, 13]]
+    ref_next = [model.next_tokens(s, top_n=2) for s in seqs]
+    ref_eval = [model.evaluate(s) for s in seqs]
+
+    lengths = np.array([len(s) for s in seqs], dtype=np.int64)
+    padded = np.zeros((len(seqs), lengths.max()), dtype=np.uint32)
+    for i, s in enumerate(seqs):
+        padded[i, :len(s)] = s
+    # a leading token outside of every sequence makes position 0 of the flat outputs padding
+    flat = np.array([19] + [t for s in seqs for t in s], dtype=np.uint32)
+    offsets = np.concatenate([[1], 1 + np.cumsum(lengths)])
+
+    def check_2d(idx, ll, ev):
+        assert idx.shape == (len(seqs), lengths.max(), 2) and ev.shape == padded.shape
+        for i, s in enumerate(seqs):
+            n = len(s)
+            assert idx[i, :n].tolist() == ref_next[i][0].tolist()
+            assert ll[i, :n].tolist() == ref_next[i][1].tolist()
+            assert ev[i, :n].tolist() == ref_eval[i].tolist()
+            assert not idx[i, n:].any() and not ll[i, n:].any() and not ev[i, n:].any()
+
+    def check_flat(idx, ll, ev):
+        assert idx.shape == (len(flat), 2) and ev.shape == flat.shape
+        assert not idx[0].any() and not ll[0].any() and ev[0] == 0
+        for i, s in enumerate(seqs):
+            b, e = offsets[i], offsets[i + 1]
+            assert idx[b:e].tolist() == ref_next[i][0].tolist()
+            assert ll[b:e].tolist() == ref_next[i][1].tolist()
+            assert ev[b:e].tolist() == ref_eval[i].tolist()
+
+    for deferred in (False, True):
+        idx, ll = model.next_tokens_batch(padded, lengths=lengths, top_n=2, deferred=deferred)
+        check_2d(idx, ll, model.evaluate_batch(padded, lengths=lengths, deferred=deferred)[:])
+
+        idx, ll = model.next_tokens_batch(seqs, top_n=2, deferred=deferred)
+        check_2d(idx, ll, model.evaluate_batch(seqs, deferred=deferred)[:])
+
+        idx, ll = model.next_tokens_batch(flat, offsets=offsets, top_n=2, deferred=deferred)
+        check_flat(idx, ll, model.evaluate_batch(flat, offsets=offsets, deferred=deferred)[:])
+
 def test_issue_92():
     if sys.maxsize <= 2**32:
         print("[skipped this test in 32bit OS.]", file=sys.stderr)